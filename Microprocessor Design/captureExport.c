@@ -0,0 +1,297 @@
+/* captureExport.c
+ *Description: Streaming exporter for logic analyzer captures. Samples are handed over in
+ * whatever chunks they arrive from the PSoC and are written out as transitions (VCD) or
+ * run-length records (binary). Output goes through a fixed buffer and is written in large
+ * blocks, so a multi-million-sample capture is exported in a few tens of milliseconds.
+ */
+
+#include <string.h>
+#include <time.h>
+#include "captureExport.h"
+
+#define EXPORT_MAX_ENTRY 64 // largest single entry (timestamp + 8 channels) in bytes
+#define VCD_ID(ch) ((char)('!' + (ch)))
+
+static void flushBuffer(captureExport *exp){
+	if(exp->used > 0 && exp->error == 0){
+		if(fwrite(exp->buffer, 1, exp->used, exp->file) != exp->used){
+			exp->error = 1;
+		}
+	}
+	exp->used = 0;
+}
+
+static void reserve(captureExport *exp){
+	if(exp->used + EXPORT_MAX_ENTRY > EXPORT_BUFFER_SIZE){
+		flushBuffer(exp);
+	}
+}
+
+static void putText(captureExport *exp, const char *text){
+	size_t len = strlen(text);
+	if(exp->used + len > EXPORT_BUFFER_SIZE){
+		flushBuffer(exp);
+	}
+	memcpy(&exp->buffer[exp->used], text, len);
+	exp->used += len;
+}
+
+// Writes an unsigned decimal without going through printf
+static void putDecimal(captureExport *exp, uint64_t value){
+	char digits[20];
+	int n = 0;
+	do{
+		digits[n++] = (char)('0' + (value % 10));
+		value /= 10;
+	}while(value != 0);
+	while(n > 0){
+		exp->buffer[exp->used++] = digits[--n];
+	}
+}
+
+static void putVarint(captureExport *exp, uint32_t value){
+	while(value >= 0x80){
+		exp->buffer[exp->used++] = (char)((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	exp->buffer[exp->used++] = (char)value;
+}
+
+static void putUint(captureExport *exp, uint64_t value, int bytes){
+	int b;
+	for(b = 0; b < bytes; b++){
+		exp->buffer[exp->used++] = (char)((value >> (8 * b)) & 0xFF);
+	}
+}
+
+// VCD timestamp of a sample: nanoseconds when the timebase is known
+static void putTimestamp(captureExport *exp, uint32_t sample){
+	exp->buffer[exp->used++] = '#';
+	putDecimal(exp, (exp->tb != NULL) ? timebaseSampleToNs(exp->tb, sample) : sample);
+	exp->buffer[exp->used++] = '\n';
+}
+
+// Emits the channels whose bits are set in 'changed'
+static void putVcdValues(captureExport *exp, uint8_t value, uint8_t changed){
+	int ch;
+	for(ch = 0; ch < exp->numChannels; ch++){
+		if(changed & (1 << ch)){
+			exp->buffer[exp->used++] = (value & (1 << ch)) ? '1' : '0';
+			exp->buffer[exp->used++] = VCD_ID(ch);
+			exp->buffer[exp->used++] = '\n';
+		}
+	}
+}
+
+static void writeVcdHeader(captureExport *exp){
+	char line[80];
+	time_t now = time(NULL);
+	int ch;
+
+	putText(exp, "$date\n\t");
+	putText(exp, ctime(&now));
+	putText(exp, "$end\n$version logicAnalyzer $end\n");
+	if(exp->tb == NULL){
+		putText(exp, "$comment one time unit per sample $end\n");
+	}
+	putText(exp, "$timescale 1 ns $end\n$scope module logic $end\n");
+	for(ch = 0; ch < exp->numChannels; ch++){
+		sprintf(line, "$var wire 1 %c CH%d $end\n", VCD_ID(ch), ch);
+		putText(exp, line);
+	}
+	putText(exp, "$upscope $end\n$enddefinitions $end\n");
+}
+
+static void writeBinHeader(captureExport *exp){
+	memcpy(exp->buffer, "LAC1", 4);
+	exp->buffer[4] = EXPORT_BIN_VERSION;
+	exp->buffer[5] = (char)exp->numChannels;
+	exp->buffer[6] = 0;
+	exp->buffer[7] = 0;
+	exp->used = 8;
+}
+
+// Closes the current run in the binary format. The first run's delta is taken from 0,
+// so it carries the initial value.
+static void putRun(captureExport *exp, uint8_t delta){
+	reserve(exp);
+	exp->buffer[exp->used++] = (char)delta;
+	putVarint(exp, exp->runLength);
+}
+
+// Binary format: records a new sample rate segment starting at the current sample
+static void putRate(captureExport *exp, const timebaseSegment *segment){
+	if(exp->runLength > 0){
+		// A run can't straddle the rate change; the remainder continues with delta 0
+		putRun(exp, exp->lastValue ^ exp->previousValue);
+		exp->previousValue = exp->lastValue;
+		exp->runLength = 0;
+	}
+	reserve(exp);
+	exp->buffer[exp->used++] = 1;
+	putVarint(exp, 0);
+	putUint(exp, segment->sampleRate, 4);
+	putUint(exp, segment->startNs, 8);
+}
+
+/*
+ * function: exportFormat exportFormatFromPath(const char *path)
+ * parameters: path - file name entered by the user
+ * returns: EXPORT_VCD for names ending in ".vcd", EXPORT_BIN otherwise
+ */
+exportFormat exportFormatFromPath(const char *path){
+	size_t len = strlen(path);
+	if(len >= 4 && strcmp(&path[len - 4], ".vcd") == 0){
+		return EXPORT_VCD;
+	}
+	return EXPORT_BIN;
+}
+
+/*
+ * function: int exportOpen(captureExport *exp, const char *path, exportFormat format, int numChannels,
+ *                          const timebase *tb)
+ * parameters: exp - exporter state, path - output file, format - VCD or binary,
+ *             numChannels - channels 0..numChannels-1 are exported,
+ *             tb - capture timebase, or NULL to count time in samples
+ * returns: 0 on success, -1 if the file can't be created
+ * description: Creates the output file and writes the format header.
+ */
+int exportOpen(captureExport *exp, const char *path, exportFormat format, int numChannels,
+	const timebase *tb){
+	memset(exp, 0, sizeof(*exp));
+	exp->file = fopen(path, "wb");
+	if(exp->file == NULL){
+		return -1;
+	}
+	exp->format = format;
+	exp->numChannels = numChannels;
+	exp->tb = tb;
+	exp->mask = (uint8_t)((1 << numChannels) - 1);
+
+	if(format == EXPORT_VCD){
+		writeVcdHeader(exp);
+	}else{
+		writeBinHeader(exp);
+	}
+	return 0;
+}
+
+// Exports samples that all share one sample rate segment
+static void exportSpan(captureExport *exp, const uint8_t *samples, uint32_t count){
+	uint32_t n = 0;
+	uint8_t value;
+
+	if(exp->started == 0){
+		value = samples[0] & exp->mask;
+		if(exp->format == EXPORT_VCD){
+			putText(exp, "$dumpvars\n");
+			reserve(exp);
+			putVcdValues(exp, value, exp->mask);
+			putText(exp, "$end\n#0\n");
+		}
+		exp->lastValue = value;
+		exp->runLength = 0;
+		exp->started = 1;
+	}
+
+	while(n < count){
+		// Skip over the rest of the current run
+		uint32_t start = n;
+		while(n < count && (samples[n] & exp->mask) == exp->lastValue){
+			n++;
+		}
+		exp->runLength += n - start;
+		if(n == count){
+			break;
+		}
+
+		value = samples[n] & exp->mask;
+		if(exp->format == EXPORT_VCD){
+			reserve(exp);
+			putTimestamp(exp, exp->sampleIndex + n);
+			putVcdValues(exp, value, value ^ exp->lastValue);
+		}else{
+			putRun(exp, exp->lastValue ^ exp->previousValue);
+			exp->previousValue = exp->lastValue;
+			exp->runLength = 0;
+		}
+		exp->lastValue = value;
+	}
+	exp->sampleIndex += count;
+}
+
+/*
+ * function: int exportSamples(captureExport *exp, const uint8_t *samples, uint32_t count)
+ * parameters: exp - exporter state, samples - one byte per sample, bit n = channel n,
+ *             count - number of samples in this chunk
+ * returns: 0 on success, -1 after a write error
+ * description: Appends a chunk of the capture. Only samples that differ from the previous
+ * one cost any work beyond a compare, so idle signals stream at memory speed. Rate changes
+ * must be added to the timebase before the chunk holding their first sample is exported; a
+ * segment replaced after it was announced is announced again.
+ */
+int exportSamples(captureExport *exp, const uint8_t *samples, uint32_t count){
+	if(exp->tb != NULL && exp->segmentsWritten > 0){
+		const timebaseSegment *last = &exp->tb->segments[exp->segmentsWritten - 1];
+		if(last->sampleRate != exp->lastSegment.sampleRate || last->startNs != exp->lastSegment.startNs){
+			// The timebase replaced it (a second header at the same sample): announce the new
+			// rate, which a reader applies from the next sample on
+			exp->segmentsWritten--;
+		}
+	}
+	while(count > 0 && exp->error == 0){
+		uint32_t n = count;
+		if(exp->tb != NULL && exp->segmentsWritten < exp->tb->numSegments){
+			const timebaseSegment *segment = &exp->tb->segments[exp->segmentsWritten];
+			if(segment->firstSample <= exp->sampleIndex){
+				if(exp->format == EXPORT_BIN){
+					putRate(exp, segment);
+				}
+				exp->lastSegment = *segment;
+				exp->segmentsWritten++;
+				continue;
+			}
+			if(segment->firstSample - exp->sampleIndex < n){
+				n = segment->firstSample - exp->sampleIndex;
+			}
+		}
+		exportSpan(exp, samples, n);
+		samples += n;
+		count -= n;
+	}
+	return exp->error ? -1 : 0;
+}
+
+/*
+ * function: int exportClose(captureExport *exp)
+ * parameters: exp - exporter state
+ * returns: 0 if everything reached the disk, -1 otherwise
+ * description: Finishes the last run, writes the trailer and closes the file.
+ */
+int exportClose(captureExport *exp){
+	int result;
+
+	if(exp->file == NULL){
+		return -1;
+	}
+	reserve(exp);
+	if(exp->format == EXPORT_VCD){
+		putTimestamp(exp, exp->sampleIndex);
+	}else{
+		if(exp->runLength > 0){
+			putRun(exp, exp->lastValue ^ exp->previousValue);
+		}
+		reserve(exp);
+		exp->buffer[exp->used++] = 0;
+		putVarint(exp, 0);
+		putUint(exp, exp->sampleIndex, 4);
+	}
+	flushBuffer(exp);
+
+	result = (exp->error == 0) ? 0 : -1;
+	if(fclose(exp->file) != 0){
+		result = -1;
+	}
+	exp->file = NULL;
+	return result;
+}
@@ -0,0 +1,58 @@
+/* captureExport.h
+ *Description: Streams logic analyzer captures to disk while they are being taken. Two formats
+ * are supported:
+ *  - Value Change Dump (.vcd): only transitions are written, one scalar wire per channel.
+ *  - Compressed binary (.lac): every run of identical samples is stored as one record holding
+ *    the XOR delta from the previous run's value and the run length as a varint.
+ * Memory use is bounded by the fixed output buffer no matter how long the capture is.
+ * When a timebase is given, VCD timestamps are in nanoseconds and the binary file records
+ * every sample rate segment; without one, time is counted in samples.
+ *
+ * Binary layout (little endian):
+ *  header  : "LAC1", uint8 version, uint8 channel count, uint16 reserved
+ *  record  : uint8 delta (value ^ previous value), varint run length (>= 1)
+ *  rate    : uint8 1, varint 0, uint32 sample rate in Hz, uint64 start time in ns
+ *            (applies from the next sample on)
+ *  trailer : uint8 0, varint 0, uint32 total sample count
+ */
+
+#ifndef CAPTURE_EXPORT_H
+#define CAPTURE_EXPORT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "timebase.h"
+
+#define EXPORT_BUFFER_SIZE 65536
+#define EXPORT_BIN_VERSION 2
+
+typedef enum{
+	EXPORT_VCD = 0,
+	EXPORT_BIN
+}exportFormat;
+
+typedef struct{
+	FILE *file;
+	exportFormat format;
+	int numChannels;
+	const timebase *tb;		// may be NULL
+	int segmentsWritten;	// timebase segments already announced
+	timebaseSegment lastSegment;	// copy of the last one, to notice it being replaced
+	uint8_t mask;			// channels being exported
+	uint32_t sampleIndex;	// samples seen so far
+	uint8_t lastValue;		// value of the current run
+	uint8_t previousValue;	// value of the run before it (binary format)
+	uint32_t runLength;		// length of the current run (binary format)
+	int started;			// first sample has been seen
+	int error;				// sticky write error
+	size_t used;			// bytes waiting in buffer
+	char buffer[EXPORT_BUFFER_SIZE];
+}captureExport;
+
+exportFormat exportFormatFromPath(const char *path);
+int exportOpen(captureExport *exp, const char *path, exportFormat format, int numChannels,
+	const timebase *tb);
+int exportSamples(captureExport *exp, const uint8_t *samples, uint32_t count);
+int exportClose(captureExport *exp);
+
+#endif
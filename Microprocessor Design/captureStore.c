@@ -0,0 +1,203 @@
+/* captureStore.c
+ *Description: Run-length encoded capture store. Appending extends the last run when the value
+ * is unchanged, so encoding happens on the fly as chunks arrive from the PSoC. Random access
+ * goes through the sparse block index (binary search) and then walks at most STORE_BLOCK_RUNS
+ * entries. Trigger search and the display walk runs directly and never expand the capture.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "captureStore.h"
+
+#define STORE_INITIAL_RUNS 4096
+
+static int growRuns(captureStore *store){
+	uint32_t capacity = store->capacity * 2;
+	uint16_t *runs = realloc(store->runs, capacity * sizeof(uint16_t));
+	if(runs == NULL){
+		return -1;
+	}
+	store->runs = runs;
+	store->capacity = capacity;
+	return 0;
+}
+
+static int growBlocks(captureStore *store){
+	uint32_t capacity = store->blockCapacity * 2;
+	uint32_t *blockStart = realloc(store->blockStart, capacity * sizeof(uint32_t));
+	if(blockStart == NULL){
+		return -1;
+	}
+	store->blockStart = blockStart;
+	store->blockCapacity = capacity;
+	return 0;
+}
+
+// Starts a new entry holding one sample of 'value'
+static int newRun(captureStore *store, uint8_t value){
+	if(store->numRuns == store->capacity && growRuns(store) != 0){
+		return -1;
+	}
+	if((store->numRuns % STORE_BLOCK_RUNS) == 0){
+		if(store->numBlocks == store->blockCapacity && growBlocks(store) != 0){
+			return -1;
+		}
+		store->blockStart[store->numBlocks++] = store->sampleCount;
+	}
+	store->runs[store->numRuns++] = (uint16_t)(value << 8);
+	return 0;
+}
+
+/*
+ * function: int storeInit(captureStore *store, int numChannels)
+ * parameters: store - store to set up, numChannels - channels 0..numChannels-1 are kept
+ * returns: 0 on success, -1 if memory couldn't be allocated
+ */
+int storeInit(captureStore *store, int numChannels){
+	memset(store, 0, sizeof(*store));
+	store->mask = (uint8_t)((1 << numChannels) - 1);
+	store->capacity = STORE_INITIAL_RUNS;
+	store->blockCapacity = STORE_INITIAL_RUNS / STORE_BLOCK_RUNS;
+	store->runs = malloc(store->capacity * sizeof(uint16_t));
+	store->blockStart = malloc(store->blockCapacity * sizeof(uint32_t));
+	if(store->runs == NULL || store->blockStart == NULL){
+		storeFree(store);
+		return -1;
+	}
+	return 0;
+}
+
+void storeFree(captureStore *store){
+	free(store->runs);
+	free(store->blockStart);
+	store->runs = NULL;
+	store->blockStart = NULL;
+	store->numRuns = 0;
+	store->numBlocks = 0;
+	store->sampleCount = 0;
+}
+
+/*
+ * function: int storeAppend(captureStore *store, const uint8_t *samples, uint32_t count)
+ * parameters: store - capture store, samples - one byte per sample, count - samples in chunk
+ * returns: 0 on success, -1 if memory ran out (samples up to that point are kept)
+ * description: Run-length encodes a chunk onto the end of the capture.
+ */
+int storeAppend(captureStore *store, const uint8_t *samples, uint32_t count){
+	uint32_t n;
+	for(n = 0; n < count; n++){
+		uint8_t value = samples[n] & store->mask;
+		uint16_t *last = (store->numRuns > 0) ? &store->runs[store->numRuns - 1] : NULL;
+
+		if(last != NULL && STORE_RUN_VALUE(*last) == value && STORE_RUN_LENGTH(*last) < STORE_MAX_RUN){
+			(*last)++;
+		}else if(newRun(store, value) != 0){
+			return -1;
+		}
+		store->sampleCount++;
+	}
+	return 0;
+}
+
+/*
+ * function: void storeSeek(storeCursor *cursor, const captureStore *store, uint32_t index)
+ * parameters: cursor - reader to position, store - capture store, index - sample index
+ * returns: void
+ * description: Finds the entry holding 'index' using the block index. Indexes past the end
+ * are clamped to the last sample.
+ */
+void storeSeek(storeCursor *cursor, const captureStore *store, uint32_t index){
+	uint32_t low = 0;
+	uint32_t high = store->numBlocks;
+
+	cursor->store = store;
+	cursor->run = 0;
+	cursor->runStart = 0;
+	if(store->numRuns == 0){
+		return;
+	}
+	if(index >= store->sampleCount){
+		index = store->sampleCount - 1;
+	}
+	// Last block starting at or before index
+	while(high - low > 1){
+		uint32_t mid = (low + high) / 2;
+		if(store->blockStart[mid] <= index){
+			low = mid;
+		}else{
+			high = mid;
+		}
+	}
+	cursor->run = low * STORE_BLOCK_RUNS;
+	cursor->runStart = store->blockStart[low];
+	while(index >= cursor->runStart + STORE_RUN_LENGTH(store->runs[cursor->run])){
+		cursor->runStart += STORE_RUN_LENGTH(store->runs[cursor->run]);
+		cursor->run++;
+	}
+}
+
+/*
+ * function: uint8_t storeCursorAt(storeCursor *cursor, uint32_t index)
+ * parameters: cursor - reader, index - sample index
+ * returns: the sample at 'index'
+ * description: Walks forward from the cursor's position, which is cheap when indexes are
+ * visited in increasing order (as when drawing the screen). Going backwards re-seeks.
+ */
+uint8_t storeCursorAt(storeCursor *cursor, uint32_t index){
+	const captureStore *store = cursor->store;
+
+	if(store->numRuns == 0){
+		return 0;
+	}
+	if(index < cursor->runStart || index >= store->sampleCount){
+		storeSeek(cursor, store, index);
+	}else{
+		while(index >= cursor->runStart + STORE_RUN_LENGTH(store->runs[cursor->run])){
+			cursor->runStart += STORE_RUN_LENGTH(store->runs[cursor->run]);
+			cursor->run++;
+		}
+	}
+	return STORE_RUN_VALUE(store->runs[cursor->run]);
+}
+
+uint8_t storeGet(const captureStore *store, uint32_t index){
+	storeCursor cursor;
+	storeSeek(&cursor, store, index);
+	return (store->numRuns > 0) ? STORE_RUN_VALUE(store->runs[cursor.run]) : 0;
+}
+
+/*
+ * function: uint32_t storeFindTrigger(const captureStore *store, uint32_t from, uint8_t condMask,
+ *                                     uint8_t condValue, int negative)
+ * parameters: store - capture store, from - search starts after this sample,
+ *             condMask/condValue - the trigger condition is (sample & condMask) == condValue,
+ *             negative - 0 for a false to true change, 1 for true to false
+ * returns: index of the first sample after the condition changed, or STORE_NOT_FOUND
+ * description: The condition can only change where a run starts, so the search steps over
+ * runs rather than samples.
+ */
+uint32_t storeFindTrigger(const captureStore *store, uint32_t from, uint8_t condMask,
+	uint8_t condValue, int negative){
+	storeCursor cursor;
+	uint32_t run;
+	uint32_t runStart;
+	int previous;
+
+	if(from >= store->sampleCount){
+		return STORE_NOT_FOUND;
+	}
+	storeSeek(&cursor, store, from);
+	run = cursor.run;
+	runStart = cursor.runStart;
+	previous = (STORE_RUN_VALUE(store->runs[run]) & condMask) == condValue;
+
+	for(runStart += STORE_RUN_LENGTH(store->runs[run]), run++; run < store->numRuns;
+		runStart += STORE_RUN_LENGTH(store->runs[run]), run++){
+		int current = (STORE_RUN_VALUE(store->runs[run]) & condMask) == condValue;
+		if(current != previous && current != negative){
+			return runStart;
+		}
+		previous = current;
+	}
+	return STORE_NOT_FOUND;
+}
@@ -0,0 +1,52 @@
+/* captureStore.h
+ *Description: In-memory capture store for the logic analyzer. Samples are run-length encoded
+ * as they are appended, so idle channels cost almost nothing and the memory depth is limited
+ * by how busy the signals are rather than by the number of samples. Each run is a 16-bit
+ * entry (value in the high byte, length-1 in the low byte); the first sample index of every
+ * STORE_BLOCK_RUNS entries is kept in a sparse index for random access.
+ *
+ * Worst case (every sample different) is 2 bytes per sample. A mostly idle 8-channel capture
+ * of 100 million samples fits in well under 1 MB.
+ */
+
+#ifndef CAPTURE_STORE_H
+#define CAPTURE_STORE_H
+
+#include <stdint.h>
+
+#define STORE_MAX_RUN		256			// samples per entry
+#define STORE_BLOCK_RUNS	256			// entries per index block
+#define STORE_NOT_FOUND		0xFFFFFFFFu
+#define STORE_RUN_VALUE(r)	((uint8_t)((r) >> 8))
+#define STORE_RUN_LENGTH(r)	((uint32_t)((r) & 0xFF) + 1)
+
+typedef struct{
+	uint16_t *runs;			// run-length entries
+	uint32_t numRuns;
+	uint32_t capacity;
+	uint32_t *blockStart;	// first sample index of each block of STORE_BLOCK_RUNS entries
+	uint32_t numBlocks;
+	uint32_t blockCapacity;
+	uint32_t sampleCount;	// total samples stored
+	uint8_t mask;			// channels being stored
+}captureStore;
+
+// Sequential reader over the compressed form
+typedef struct{
+	const captureStore *store;
+	uint32_t run;			// current entry
+	uint32_t runStart;		// sample index of the current entry
+}storeCursor;
+
+int storeInit(captureStore *store, int numChannels);
+void storeFree(captureStore *store);
+int storeAppend(captureStore *store, const uint8_t *samples, uint32_t count);
+uint8_t storeGet(const captureStore *store, uint32_t index);
+
+void storeSeek(storeCursor *cursor, const captureStore *store, uint32_t index);
+uint8_t storeCursorAt(storeCursor *cursor, uint32_t index);
+
+uint32_t storeFindTrigger(const captureStore *store, uint32_t from, uint8_t condMask,
+	uint8_t condValue, int negative);
+
+#endif
@@ -0,0 +1,288 @@
+/* edgeIndex.c
+ *Description: Builds the per-channel edge arrays by walking the runs of a captureStore (edges
+ * can only fall on run boundaries) and answers edge and pulse-width queries from them. The
+ * build is split by channel and by segment of the capture so it runs on every core.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "edgeIndex.h"
+
+#define EDGE_SEGMENT_BLOCKS 64 // store index blocks per build task
+
+// Fills the leaves with pulse widths and builds the min/max levels above them
+static int buildWidthTree(channelEdges *edges){
+	uint32_t pulses = (edges->numEdges > 1) ? edges->numEdges - 1 : 0;
+	uint32_t k;
+
+	edges->leaves = 1;
+	while(edges->leaves < pulses){
+		edges->leaves <<= 1;
+	}
+	edges->minWidth = malloc(2 * edges->leaves * sizeof(uint32_t));
+	edges->maxWidth = malloc(2 * edges->leaves * sizeof(uint32_t));
+	if(edges->minWidth == NULL || edges->maxWidth == NULL){
+		free(edges->minWidth);
+		free(edges->maxWidth);
+		edges->minWidth = NULL;
+		edges->maxWidth = NULL;
+		return -1;
+	}
+	for(k = 0; k < edges->leaves; k++){
+		if(k < pulses){
+			uint32_t width = edges->edges[k + 1] - edges->edges[k];
+			edges->minWidth[edges->leaves + k] = width;
+			edges->maxWidth[edges->leaves + k] = width;
+		}else{
+			// Padding never matches either kind of query
+			edges->minWidth[edges->leaves + k] = UINT32_MAX;
+			edges->maxWidth[edges->leaves + k] = 0;
+		}
+	}
+	for(k = edges->leaves - 1; k > 0; k--){
+		uint32_t minL = edges->minWidth[2 * k], minR = edges->minWidth[2 * k + 1];
+		uint32_t maxL = edges->maxWidth[2 * k], maxR = edges->maxWidth[2 * k + 1];
+		edges->minWidth[k] = (minL < minR) ? minL : minR;
+		edges->maxWidth[k] = (maxL > maxR) ? maxL : maxR;
+	}
+	return 0;
+}
+
+// Segment of the capture handled by one task: a range of runs for one channel
+typedef struct{
+	channelEdges *edges;
+	const captureStore *store;
+	int ch;
+	uint32_t firstRun;
+	uint32_t lastRun;		// one past the end
+	uint32_t runStart;		// sample index of firstRun
+	uint32_t count;			// edges in the segment (pass 1)
+	uint32_t offset;		// where they go in edges->edges (pass 2)
+}edgeJob;
+
+// Walks the runs of one segment, counting edges, or storing them if the array exists
+static void scanSegment(void *arg){
+	edgeJob *job = arg;
+	const captureStore *store = job->store;
+	uint8_t bit = (uint8_t)(1 << job->ch);
+	uint8_t previous = STORE_RUN_VALUE(store->runs[(job->firstRun > 0) ? job->firstRun - 1 : 0]);
+	uint32_t runStart = job->runStart;
+	uint32_t *out = (job->edges->edges != NULL) ? &job->edges->edges[job->offset] : NULL;
+	uint32_t count = 0;
+	uint32_t run;
+
+	for(run = job->firstRun; run < job->lastRun; run++){
+		uint8_t value = STORE_RUN_VALUE(store->runs[run]);
+		if((value ^ previous) & bit){
+			if(out != NULL){
+				out[count] = runStart;
+			}
+			count++;
+		}
+		previous = value;
+		runStart += STORE_RUN_LENGTH(store->runs[run]);
+	}
+	job->count = count;
+}
+
+static void buildTreeTask(void *arg){
+	channelEdges *edges = arg;
+	if(buildWidthTree(edges) != 0){
+		free(edges->edges);
+		edges->edges = NULL;
+		edges->numEdges = 0;
+	}
+}
+
+// Runs the task on the pool, or right away when there is no pool
+static void submit(taskPool *pool, taskFunction function, void *arg){
+	if(pool != NULL){
+		taskPoolSubmit(pool, function, arg);
+	}else{
+		function(arg);
+	}
+}
+
+/*
+ * function: int edgeIndexBuild(edgeIndex *index, const captureStore *store, int numChannels,
+ *                              taskPool *pool)
+ * parameters: index - index to fill, store - capture, numChannels - channels in use,
+ *             pool - threads to build on (NULL builds on the calling thread)
+ * returns: 0 on success, -1 if memory ran out (index is then left empty)
+ * description: The capture is cut into segments of EDGE_SEGMENT_BLOCKS index blocks. Every
+ * (channel, segment) pair is a task: the first pass counts edges, the counts give each segment
+ * its place in the channel's array, and the second pass fills it in. The width trees are then
+ * built one task per channel.
+ */
+int edgeIndexBuild(edgeIndex *index, const captureStore *store, int numChannels, taskPool *pool){
+	uint32_t numSegments = (store->numBlocks + EDGE_SEGMENT_BLOCKS - 1) / EDGE_SEGMENT_BLOCKS;
+	edgeJob *jobs = NULL;
+	uint32_t seg;
+	int ch;
+	int result = 0;
+
+	memset(index, 0, sizeof(*index));
+	index->numChannels = numChannels;
+	if(numSegments > 0){
+		jobs = malloc(numChannels * numSegments * sizeof(edgeJob));
+		if(jobs == NULL){
+			return -1;
+		}
+	}
+
+	// Pass 1: count
+	for(ch = 0; ch < numChannels; ch++){
+		for(seg = 0; seg < numSegments; seg++){
+			edgeJob *job = &jobs[ch * numSegments + seg];
+			uint32_t lastRun = (seg + 1) * EDGE_SEGMENT_BLOCKS * STORE_BLOCK_RUNS;
+			job->edges = &index->channel[ch];
+			job->store = store;
+			job->ch = ch;
+			job->firstRun = seg * EDGE_SEGMENT_BLOCKS * STORE_BLOCK_RUNS;
+			job->lastRun = (lastRun < store->numRuns) ? lastRun : store->numRuns;
+			job->runStart = store->blockStart[seg * EDGE_SEGMENT_BLOCKS];
+			submit(pool, scanSegment, job);
+		}
+	}
+	if(pool != NULL){
+		taskPoolWait(pool);
+	}
+
+	// Place each segment and allocate exactly
+	for(ch = 0; ch < numChannels; ch++){
+		channelEdges *edges = &index->channel[ch];
+		for(seg = 0; seg < numSegments; seg++){
+			jobs[ch * numSegments + seg].offset = edges->numEdges;
+			edges->numEdges += jobs[ch * numSegments + seg].count;
+		}
+		edges->edges = malloc((edges->numEdges > 0 ? edges->numEdges : 1) * sizeof(uint32_t));
+		if(edges->edges == NULL){
+			result = -1;
+		}
+	}
+
+	// Pass 2: fill
+	if(result == 0){
+		for(seg = 0; seg < numChannels * numSegments; seg++){
+			submit(pool, scanSegment, &jobs[seg]);
+		}
+		if(pool != NULL){
+			taskPoolWait(pool);
+		}
+		for(ch = 0; ch < numChannels; ch++){
+			submit(pool, buildTreeTask, &index->channel[ch]);
+		}
+		if(pool != NULL){
+			taskPoolWait(pool);
+		}
+		for(ch = 0; ch < numChannels; ch++){
+			if(index->channel[ch].edges == NULL){
+				result = -1;
+			}
+		}
+	}
+	free(jobs);
+	if(result != 0){
+		edgeIndexFree(index);
+	}
+	return result;
+}
+
+void edgeIndexFree(edgeIndex *index){
+	int ch;
+	for(ch = 0; ch < EDGE_MAX_CHANNELS; ch++){
+		free(index->channel[ch].edges);
+		free(index->channel[ch].minWidth);
+		free(index->channel[ch].maxWidth);
+	}
+	memset(index, 0, sizeof(*index));
+}
+
+// Number of edges at or before 'sample'
+static uint32_t edgesUpTo(const channelEdges *edges, uint32_t sample){
+	uint32_t low = 0;
+	uint32_t high = edges->numEdges;
+	while(low < high){
+		uint32_t mid = (low + high) / 2;
+		if(edges->edges[mid] <= sample){
+			low = mid + 1;
+		}else{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+/*
+ * function: uint32_t edgeNext(const edgeIndex *index, int ch, uint32_t from)
+ * returns: sample index of the first edge on ch after 'from', or EDGE_NOT_FOUND
+ */
+uint32_t edgeNext(const edgeIndex *index, int ch, uint32_t from){
+	const channelEdges *edges = &index->channel[ch];
+	uint32_t k = edgesUpTo(edges, from);
+	return (k < edges->numEdges) ? edges->edges[k] : EDGE_NOT_FOUND;
+}
+
+/*
+ * function: uint32_t edgePrevious(const edgeIndex *index, int ch, uint32_t from)
+ * returns: sample index of the last edge on ch before 'from', or EDGE_NOT_FOUND
+ */
+uint32_t edgePrevious(const edgeIndex *index, int ch, uint32_t from){
+	const channelEdges *edges = &index->channel[ch];
+	uint32_t k;
+	if(from == 0){
+		return EDGE_NOT_FOUND;
+	}
+	k = edgesUpTo(edges, from - 1);
+	return (k > 0) ? edges->edges[k - 1] : EDGE_NOT_FOUND;
+}
+
+// Lowest leaf >= first under 'node' whose width passes the filter, or EDGE_NOT_FOUND
+static uint32_t firstMatch(const channelEdges *edges, uint32_t node, uint32_t low, uint32_t high,
+	uint32_t first, uint32_t width, int longer){
+	uint32_t mid, found;
+
+	if(high <= first){
+		return EDGE_NOT_FOUND;
+	}
+	if(longer ? (edges->maxWidth[node] <= width) : (edges->minWidth[node] >= width)){
+		return EDGE_NOT_FOUND;
+	}
+	if(high - low == 1){
+		return low;
+	}
+	mid = (low + high) / 2;
+	found = firstMatch(edges, 2 * node, low, mid, first, width, longer);
+	if(found == EDGE_NOT_FOUND){
+		found = firstMatch(edges, 2 * node + 1, mid, high, first, width, longer);
+	}
+	return found;
+}
+
+/*
+ * function: uint32_t pulseFind(const edgeIndex *index, int ch, uint32_t from, uint32_t width,
+ *                              int longer, uint32_t *foundWidth)
+ * parameters: index - edge index, ch - channel, from - search starts after this sample,
+ *             width - threshold in samples, longer - 0 finds pulses shorter than width,
+ *             1 finds pulses longer than width, foundWidth - width of the match (may be NULL)
+ * returns: sample index where the matching pulse starts, or EDGE_NOT_FOUND
+ * description: A pulse is the time between two consecutive edges on the channel, of either
+ * level. Subtrees whose min (or max) width rules out a match are skipped whole.
+ */
+uint32_t pulseFind(const edgeIndex *index, int ch, uint32_t from, uint32_t width, int longer,
+	uint32_t *foundWidth){
+	const channelEdges *edges = &index->channel[ch];
+	uint32_t k;
+
+	if(edges->numEdges < 2){
+		return EDGE_NOT_FOUND;
+	}
+	k = firstMatch(edges, 1, 0, edges->leaves, edgesUpTo(edges, from), width, longer);
+	if(k == EDGE_NOT_FOUND){
+		return EDGE_NOT_FOUND;
+	}
+	if(foundWidth != NULL){
+		*foundWidth = edges->edges[k + 1] - edges->edges[k];
+	}
+	return edges->edges[k];
+}
@@ -0,0 +1,40 @@
+/* edgeIndex.h
+ *Description: Per-channel edge index for logic analyzer captures. For each channel the sample
+ * index of every transition is kept in a sorted array, so next/previous edge is a binary
+ * search. The widths of the pulses between consecutive edges are summarized in a min/max
+ * segment tree, so "next pulse shorter/longer than N samples" skips every part of the capture
+ * that can't contain a match. All queries are O(log edges).
+ */
+
+#ifndef EDGE_INDEX_H
+#define EDGE_INDEX_H
+
+#include <stdint.h>
+#include "captureStore.h"
+#include "taskPool.h"
+
+#define EDGE_MAX_CHANNELS 8
+#define EDGE_NOT_FOUND STORE_NOT_FOUND
+
+typedef struct{
+	uint32_t *edges;		// sample index of each transition, ascending
+	uint32_t numEdges;
+	uint32_t leaves;		// power of two >= number of pulses
+	uint32_t *minWidth;		// segment trees over pulse k = edges[k]..edges[k+1]
+	uint32_t *maxWidth;
+}channelEdges;
+
+typedef struct{
+	channelEdges channel[EDGE_MAX_CHANNELS];
+	int numChannels;
+}edgeIndex;
+
+int edgeIndexBuild(edgeIndex *index, const captureStore *store, int numChannels, taskPool *pool);
+void edgeIndexFree(edgeIndex *index);
+
+uint32_t edgeNext(const edgeIndex *index, int ch, uint32_t from);
+uint32_t edgePrevious(const edgeIndex *index, int ch, uint32_t from);
+uint32_t pulseFind(const edgeIndex *index, int ch, uint32_t from, uint32_t width, int longer,
+	uint32_t *foundWidth);
+
+#endif
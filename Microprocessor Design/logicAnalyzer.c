@@ -8,12 +8,27 @@
  * active when the trigger condition changes from false to true, and negative direction specifies
  * that the trigger should become active when the condition changes from true to false. A
  * memory depth can be entered, so that the size of the window can be set. The sampling
- * frequency can be taken in which maxes out at the max clock speed. The x-scale can be set
+ * frequency can be taken in which maxes out at the max clock speed; it is rounded to a rate the
+ * PSoC sample clock can divide down to. Each capture (and each change of rate) starts with a
+ * header from the PSoC giving the actual rate and a timestamp (see timebase.h), so the x-axis
+ * and every measurement are shown in real time, relative to the trigger. The x-scale can be set
  * as 1, 10, 100, 500, 1000, 2000, 5000 or 10000, and 'run' is entered to begin the logic analyzer.
+ * Samples are held run-length encoded (see captureStore.h), so memory depth can go up to
+ * MAX_SAMPLE_COUNT samples as long as the signals are mostly idle. The display is centered on
+ * the first trigger in the capture.
+ * Once running, searches can be typed into the terminal (see handleCommand()) to jump the
+ * display to the next/previous edge on a channel or to the next pulse shorter or longer than a
+ * given number of samples.
+ * Building the edge index and preparing each frame are spread over all cores with a task
+ * pool (see taskPool.h): each frame is cut into pixel segments, and each segment is sampled
+ * from the store and turned into every channel's waveform in one task, joined before drawing.
+ * Optionally, the capture can be streamed to a file as it is taken, either as a Value Change Dump
+ * (.vcd) or in the compressed binary format described in captureExport.h (any other name).
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <unistd.h>
 #include "VG/openvg.h"
 #include "VG/vgu.h"
@@ -25,10 +40,18 @@
 #include <termios.h>
 #include <wiringPi.h>
 #include <errno.h>
+#include "captureExport.h"
+#include "captureStore.h"
+#include "edgeIndex.h"
+#include "taskPool.h"
+#include "timebase.h"
 
 #define BAUDRATE B115200 // UART speed
 #define SCALE xscale
 #define WAVEH (height/10)
+#define MAX_SAMPLE_COUNT 400000000
+#define CAPTURE_CHUNK 4096 // samples handed to the store and exporter at a time
+#define RENDER_SEGMENTS 8 // pixel ranges prepared in parallel each frame
 
 typedef enum{
 	POS = 0,
@@ -38,6 +61,170 @@ typedef enum{
 int i,j;
 uint8_t data[2] = {0};
 uint8_t read_bytes = 0;
+static captureExport exporter;
+static captureStore store;
+static edgeIndex edges;
+static taskPool pool;
+static timebase tb;
+static uint32_t origin; // sample shown as time 0 (the trigger)
+
+// One piece of the work needed to prepare a frame
+typedef struct{
+	int first;				// pixel range
+	int last;
+	int numChannels;
+	float **waves;			// y coordinates for Polyline(), one row per channel
+	uint32_t center;		// sample under the middle of the screen
+	float x;				// pixels per sample
+	int width;
+	int height;
+	uint8_t *display;
+}renderJob;
+
+/*
+ * function: void renderSegment(void *arg)
+ * parameters: arg - renderJob giving the pixel range
+ * returns: void
+ * description: Fills display[] for a range of pixels from the compressed store, then converts
+ * that range of every channel into y coordinates for Polyline(). Each segment uses its own
+ * cursor so segments can run at the same time. A frame is a few thousand pixels, so one task
+ * per segment keeps the pool's overhead well under the work.
+ */
+static void renderSegment(void *arg){
+	renderJob *job = arg;
+	storeCursor cursor;
+	int64_t first = (int64_t)job->center + (int64_t)floorf((job->first - job->width/2) / job->x);
+	int height = job->height;
+	int i;
+	int ch;
+
+	// Start at the segment's first sample (storeSeek clamps the end), the cursor only moves forward
+	storeSeek(&cursor, &store, (first <= 0) ? 0 : (first >= store.sampleCount) ? store.sampleCount : (uint32_t)first);
+	for(i = job->first; i < job->last; i++){
+		int64_t sample = (int64_t)job->center + (int64_t)floorf((i - job->width/2) / job->x);
+		if(sample >= 0 && sample < store.sampleCount){
+			job->display[i] = storeCursorAt(&cursor, (uint32_t)sample);
+		}else{
+			job->display[i] = 0;
+		}
+	}
+	for(ch = 0; ch < job->numChannels; ch++){
+		float *wave = job->waves[ch];
+		for(i = job->first; i < job->last; i++){
+			wave[i] = (((job->display[i] >> ch) & 1) * WAVEH) + (height * ch)/8;
+		}
+	}
+}
+
+/*
+ * function: int parseTrigger(const char *text, int numChannels, uint8_t *mask, uint8_t *value)
+ * parameters: text - one character per channel, highest channel first ('0', '1' or 'x')
+ *             numChannels - channels in use, mask/value - trigger condition output
+ * returns: 0 if the condition is valid, -1 otherwise
+ * description: A condition shorter than the channel count applies to the lowest channels.
+ */
+static int parseTrigger(const char *text, int numChannels, uint8_t *mask, uint8_t *value){
+	int len = strcspn(text, "\n");
+	int n;
+	if(len < 1 || len > numChannels){
+		return -1;
+	}
+	*mask = 0;
+	*value = 0;
+	for(n = 0; n < len; n++){
+		int ch = len - 1 - n;
+		if(text[n] == '1'){
+			*mask |= 1 << ch;
+			*value |= 1 << ch;
+		}else if(text[n] == '0'){
+			*mask |= 1 << ch;
+		}else if(text[n] != 'x'){
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * function: int readCommand(char *line, int size)
+ * parameters: line - buffer that collects a typed line across calls, size - buffer size
+ * returns: 1 when a complete line is in 'line', 0 otherwise
+ * description: Non-blocking read from stdin so the display keeps refreshing while typing.
+ */
+static int readCommand(char *line, int size){
+	static int used = 0;
+	char c;
+	while(read(STDIN_FILENO, &c, 1) == 1){
+		if(c == '\n'){
+			line[used] = '\0';
+			used = 0;
+			return 1;
+		}
+		if(used < size - 1){
+			line[used++] = c;
+		}
+	}
+	return 0;
+}
+
+// Time of a sample relative to the trigger
+static int64_t sampleTime(uint32_t sample){
+	return (int64_t)timebaseSampleToNs(&tb, sample) - (int64_t)timebaseSampleToNs(&tb, origin);
+}
+
+/*
+ * function: uint32_t handleCommand(const char *line, int numChannels, uint32_t center, char *result)
+ * parameters: line - command typed by the user, numChannels - channels in use,
+ *             center - sample at the middle of the display, result - message for the screen
+ * returns: the new center sample
+ * description: Commands are
+ *   n <ch>          next edge on channel ch
+ *   p <ch>          previous edge on channel ch
+ *   s <ch> <width>  next pulse shorter than width (a time such as 10us, 2.5ms)
+ *   l <ch> <width>  next pulse longer than width
+ * The width is turned into samples at the rate in effect at the current position.
+ */
+static uint32_t handleCommand(const char *line, int numChannels, uint32_t center, char *result){
+	char cmd;
+	int ch;
+	int used = 0;
+	uint64_t widthNs;
+	uint32_t width;
+	uint32_t found = EDGE_NOT_FOUND;
+	uint32_t foundWidth = 0;
+	char when[TIME_TEXT_SIZE];
+	char howLong[TIME_TEXT_SIZE];
+	int fields = sscanf(line, " %c %d %n", &cmd, &ch, &used);
+
+	if(fields < 2 || ch < 0 || ch >= numChannels){
+		sprintf(result, "Bad command: %.40s", line);
+		return center;
+	}
+	if(cmd == 'n'){
+		found = edgeNext(&edges, ch, center);
+	}else if(cmd == 'p'){
+		found = edgePrevious(&edges, ch, center);
+	}else if((cmd == 's' || cmd == 'l') && parseTime(&line[used], &widthNs) == 0){
+		width = (uint32_t)((widthNs * timebaseRateAt(&tb, center) + 999999999ull) / 1000000000ull);
+		found = pulseFind(&edges, ch, center, width, cmd == 'l', &foundWidth);
+	}else{
+		sprintf(result, "Bad command: %.40s", line);
+		return center;
+	}
+
+	if(found == EDGE_NOT_FOUND){
+		sprintf(result, "%.40s: not found", line);
+		return center;
+	}
+	formatTime(sampleTime(found), when);
+	if(cmd == 's' || cmd == 'l'){
+		formatTime(sampleTime(found + foundWidth) - sampleTime(found), howLong);
+		sprintf(result, "%.40s: at %s, %s wide", line, when, howLong);
+	}else{
+		sprintf(result, "%.40s: at %s", line, when);
+	}
+	return found;
+}
 
 int main() {
 	
@@ -94,8 +281,15 @@ int main() {
 	
 	//Prompt for the trigger condition
 	char trigger_cond[50];
-	int trigger;
-	printf("Enter a trigger condition: \n");
+	uint8_t trigger_mask, trigger_value;
+	printf("Enter a trigger condition (0/1/x per channel, channel 0 last): ");
+	while(1){
+		fgets(trigger_cond, 50, stdin);
+		if(parseTrigger(trigger_cond, numChannels, &trigger_mask, &trigger_value) == 0){
+			break;
+		}
+		printf("Enter a trigger condition (0/1/x per channel, channel 0 last): ");
+	}
 	
 	//Prompt for trigger direction
 	char trigger_dir[20];
@@ -120,7 +314,7 @@ int main() {
 	while(1){
 		fgets(mem_depth, 20, stdin);
 		sample_count = atof(mem_depth);
-		if ((sample_count>200) && (sample_count<=5000)) {
+		if ((sample_count>200) && (sample_count<=MAX_SAMPLE_COUNT)) {
 			break;
 		}
 		printf("Enter a sample count: ");
@@ -128,16 +322,18 @@ int main() {
 	
 	// Prompt for frequency
 	char freq[20];
-	int frequency;
-	printf("Enter a sampling frequency (1-max): ");
+	uint32_t frequency;
+	printf("Enter a sampling frequency in Hz (k/M suffix, max 24M): ");
 	while(1){
 		fgets(freq,20,stdin);
-		frequency = atof(freq);
-		if(frequency>=1 && frequency<10){
+		if(parseFrequency(freq, &frequency) == 0 && frequency <= PSOC_SAMPLE_CLOCK){
 			break;
 		}
-		printf("Enter a sampling frequency (1-max): ");
+		printf("Enter a sampling frequency in Hz (k/M suffix, max 24M): ");
 	}
+	frequency = achievableRate(frequency);
+	sprintf(freq, "%u Hz", frequency);
+	printf("Sampling at %s\n", freq);
 	
 	//Prompt for xscale
 	char hscale[20];
@@ -152,6 +348,24 @@ int main() {
 		printf("Set the xscale(10, 100, 500, 1000, 2000, 5000, 10000): ");
 	}
 
+	//Prompt for export file
+	char export_file[100];
+	int exporting = 0;
+	printf("Enter an export file (.vcd or .lac, blank for none): ");
+	while(1){
+		fgets(export_file, 100, stdin);
+		export_file[strcspn(export_file, "\n")] = '\0';
+		if(export_file[0] == '\0'){
+			strcpy(export_file, "none");
+			break;
+		}
+		if(exportOpen(&exporter, export_file, exportFormatFromPath(export_file), numChannels, &tb) == 0){
+			exporting = 1;
+			break;
+		}
+		perror(export_file);
+		printf("Enter an export file (.vcd or .lac, blank for none): ");
+	}
 	
 	//Prompt to begin program
 	char start[20];
@@ -168,11 +382,12 @@ int main() {
 	int width, height;
 	init(&width, &height);
 	
-	int x =
-	 (width*500)/(xscale*105);
+	float x = (float)(width*500)/(xscale*105); // pixels per sample
 	uint8_t display[width];
-	uint8_t samples[sample_count*2];
-	uint8_t bits[sample_count * x];
+	uint8_t chunk[CAPTURE_CHUNK];
+	renderJob segmentJobs[RENDER_SEGMENTS];
+	uint32_t trigger;
+	uint32_t center;
 	float move[width];
 	float CH0[width];
 	float CH1[width];
@@ -185,19 +400,84 @@ int main() {
 
 	
 	
-	for(i = 0; i < sample_count; i++){
-		samples[i] = i;
+	if(storeInit(&store, numChannels) != 0){
+		perror("Capture store");
+		return -1;
+	}
+	// Capture in chunks, encoding into the store and streaming to the export file as they come in.
+	// The PSoC opens the capture with a header (captureHeaderDecode()) carrying its actual rate;
+	// until the UART link above is enabled, the header is the one it would send for this rate.
+	captureHeader header;
+	header.sampleRate = frequency;
+	header.timestamp = 0;
+	timebaseInit(&tb);
+	timebaseAddHeader(&tb, 0, &header);
+	uint32_t captured = 0;
+	while(captured < (uint32_t)sample_count){
+		uint32_t n = (uint32_t)sample_count - captured;
+		if(n > CAPTURE_CHUNK){
+			n = CAPTURE_CHUNK;
+		}
+		for(i = 0; i < (int)n; i++){
+			chunk[i] = captured + i;
+		}
+		if(exporting){
+			exportSamples(&exporter, chunk, n);
+		}
+		if(storeAppend(&store, chunk, n) != 0){
+			printf("Out of memory after %u samples\n", store.sampleCount);
+			break;
+		}
+		captured += n;
 	}
-	for(i = 0; i < sample_count; i++){
-		for(j = 0; j < x; j++){
-			bits[(i * x) + j] = samples[i];
+	if(exporting){
+		if(exportClose(&exporter) != 0){
+			perror(export_file);
 		}
+		exporting = 0;
+	}
+
+	// Center the display on the trigger, or the middle of the capture if it never fired
+	trigger = storeFindTrigger(&store, 0, trigger_mask, trigger_value, trig_direction == NEG);
+	center = (trigger != STORE_NOT_FOUND) ? trigger : store.sampleCount / 2;
+	origin = (trigger != STORE_NOT_FOUND) ? trigger : 0;
+
+	if(taskPoolInit(&pool, 0) != 0){
+		perror("Task pool");
+		return -1;
+	}
+	if(edgeIndexBuild(&edges, &store, numChannels, &pool) != 0){
+		perror("Edge index");
+		return -1;
+	}
+	// Searches are typed while the display runs
+	char command[60];
+	char search_result[100] = "";
+	char time_label[TIME_TEXT_SIZE];
+	fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+	printf("Search with n/p <ch>, s/l <ch> <width>\n");
+
+	float *waves[8] = {CH0, CH1, CH2, CH3, CH4, CH5, CH6, CH7};
+	for(i = 0; i < RENDER_SEGMENTS; i++){
+		segmentJobs[i].first = (width * i) / RENDER_SEGMENTS;
+		segmentJobs[i].last = (width * (i + 1)) / RENDER_SEGMENTS;
+		segmentJobs[i].numChannels = numChannels;
+		segmentJobs[i].waves = waves;
+		segmentJobs[i].x = x;
+		segmentJobs[i].width = width;
+		segmentJobs[i].height = height;
+		segmentJobs[i].display = display;
 	}
 	for(i = 0; i < width; i++){
 		move[i] = i;
 	}
 	
 	while (1) {
+		if(readCommand(command, sizeof(command))){
+			center = handleCommand(command, numChannels, center, search_result);
+			printf("%s\n", search_result);
+		}
+
 		Start(width, height);
 		Background(0,0,0);
 		
@@ -231,20 +511,23 @@ int main() {
 			Line((int)xPos, 0, (int)xPos, height);
 			xPos +=tenth;
 		}
-		
-		for (i = 0; i < width; i++) {
-			display[i] = bits[(((sample_count*x)/2) - (width/2)) + i];
+		// Label each grid line with its time from the trigger
+		Fill(200, 200, 200, 1);
+		for(i = 0, xPos = 0; i<10; i++){
+			int64_t sample = (int64_t)center + (int64_t)floorf((xPos - width/2) / x);
+			if(sample >= 0 && sample < store.sampleCount){
+				formatTime(sampleTime((uint32_t)sample), time_label);
+				Text((int)xPos + 4, height*7/8 - 15, time_label, SerifTypeface, 10);
+			}
+			xPos += tenth;
 		}
-		for(i = 0; i < width; i++){
-			CH0[i] = (display[i] & 0b00000001) * WAVEH;
-			CH1[i] = (((display[i] & 0b00000010)>>1) * WAVEH) + height/8;
-			CH2[i] = (((display[i] & 0b00000100)>>2) * WAVEH) + height/4;
-			CH3[i] = (((display[i] & 0b00001000)>>3) * WAVEH) + height*3/8;
-			CH4[i] = (((display[i] & 0b00010000)>>4) * WAVEH) + height/2;
-			CH5[i] = (((display[i] & 0b00100000)>>5) * WAVEH) + height*5/8;
-			CH6[i] = (((display[i] & 0b01000000)>>6) * WAVEH) + height*6/8;
-			CH7[i] = (((display[i] & 0b10000000)>>7) * WAVEH) + height*7/8;
+		
+		// Sample the runs under each pixel straight from the compressed store
+		for(i = 0; i < RENDER_SEGMENTS; i++){
+			segmentJobs[i].center = center;
+			taskPoolSubmit(&pool, renderSegment, &segmentJobs[i]);
 		}
+		taskPoolWait(&pool);
 		
 	
 		StrokeWidth(1);
@@ -298,6 +581,10 @@ int main() {
 		TextMid((width-(width*9/10))+200,height-(height/30)-100, freq, SerifTypeface, 15);
 		TextMid(width-(width*9/10),height-(height/30)-125, "X scale: ", SerifTypeface, 15);
 		TextMid((width-(width*9/10))+200,height-(height/30)-125, hscale, SerifTypeface, 15);
+		TextMid(width-(width*9/10),height-(height/30)-150, "Export file: ", SerifTypeface, 15);
+		TextMid((width-(width*9/10))+200,height-(height/30)-150, export_file, SerifTypeface, 15);
+		TextMid(width-(width*9/10),height-(height/30)-175, "Search: ", SerifTypeface, 15);
+		Text((width-(width*9/10))+150,height-(height/30)-175, search_result, SerifTypeface, 15);
 		
 		TextMid(width-(width/20), (height-height/50), "Channel 7", SerifTypeface, 15);
 		TextMid(width-(width/20), (height-height/50) - (height/8), "Channel 6", SerifTypeface, 15);
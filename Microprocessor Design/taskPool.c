@@ -0,0 +1,232 @@
+/* taskPool.c
+ *Description: Work-stealing thread pool. Deques are guarded by their own mutex, which is plenty
+ * for the coarse tasks used here (a frame segment or a block of runs each). Tasks may submit more
+ * tasks; taskPoolWait() returns once every submitted task, including those, has finished.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include "taskPool.h"
+
+static __thread int workerId = -1; // queue owned by the current thread, -1 outside the pool
+
+static int pushTask(taskDeque *queue, task t){
+	int result = -1;
+	pthread_mutex_lock(&queue->lock);
+	if(queue->tail - queue->head < TASK_QUEUE_SIZE){
+		queue->tasks[queue->tail % TASK_QUEUE_SIZE] = t;
+		queue->tail++;
+		result = 0;
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return result;
+}
+
+// Owner side: newest task first, it is the one most likely still in cache
+static int popTask(taskDeque *queue, task *t){
+	int result = -1;
+	pthread_mutex_lock(&queue->lock);
+	if(queue->tail != queue->head){
+		queue->tail--;
+		*t = queue->tasks[queue->tail % TASK_QUEUE_SIZE];
+		result = 0;
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return result;
+}
+
+// Thief side: oldest task first, usually the biggest piece of remaining work
+static int stealTask(taskDeque *queue, task *t){
+	int result = -1;
+	pthread_mutex_lock(&queue->lock);
+	if(queue->tail != queue->head){
+		*t = queue->tasks[queue->head % TASK_QUEUE_SIZE];
+		queue->head++;
+		result = 0;
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return result;
+}
+
+static int findTask(taskPool *pool, int self, task *t){
+	int k;
+	int found = (popTask(&pool->queues[self], t) == 0);
+	for(k = 1; !found && k <= pool->numWorkers; k++){
+		found = (stealTask(&pool->queues[(self + k) % (pool->numWorkers + 1)], t) == 0);
+	}
+	if(found){
+		pthread_mutex_lock(&pool->lock);
+		pool->queued--;
+		pthread_mutex_unlock(&pool->lock);
+	}
+	return found;
+}
+
+static void runTask(taskPool *pool, task t){
+	t.function(t.arg);
+	pthread_mutex_lock(&pool->lock);
+	pool->pending--;
+	if(pool->pending == 0){
+		pthread_cond_broadcast(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+typedef struct{
+	taskPool *pool;
+	int id;
+}workerStart;
+
+static workerStart starts[TASK_MAX_WORKERS];
+
+static void *worker(void *arg){
+	workerStart *start = arg;
+	taskPool *pool = start->pool;
+	task t;
+
+	workerId = start->id;
+	// numWorkers is only final once taskPoolInit knows how many threads it got
+	pthread_mutex_lock(&pool->lock);
+	while(pool->started == 0){
+		pthread_cond_wait(&pool->wake, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	while(1){
+		if(findTask(pool, workerId, &t)){
+			runTask(pool, t);
+			continue;
+		}
+		pthread_mutex_lock(&pool->lock);
+		while(pool->stop == 0 && pool->queued == 0){
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		}
+		if(pool->stop){
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+	return NULL;
+}
+
+/*
+ * function: int taskPoolInit(taskPool *pool, int numWorkers)
+ * parameters: pool - pool to start, numWorkers - worker threads, 0 for one per online core
+ * returns: 0 on success, -1 if no thread could be started
+ * description: Only one pool may exist at a time.
+ */
+int taskPoolInit(taskPool *pool, int numWorkers){
+	int n;
+
+	memset(pool, 0, sizeof(*pool));
+	if(numWorkers <= 0){
+		numWorkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if(numWorkers < 1){
+		numWorkers = 1;
+	}
+	if(numWorkers > TASK_MAX_WORKERS){
+		numWorkers = TASK_MAX_WORKERS;
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	for(n = 0; n <= TASK_MAX_WORKERS; n++){
+		pthread_mutex_init(&pool->queues[n].lock, NULL);
+	}
+
+	for(n = 0; n < numWorkers; n++){
+		starts[n].pool = pool;
+		starts[n].id = n;
+		if(pthread_create(&pool->threads[n], NULL, worker, &starts[n]) != 0){
+			break;
+		}
+	}
+	if(n == 0){
+		return -1;
+	}
+	// Fewer threads than asked for just makes a smaller pool; let the workers go
+	pthread_mutex_lock(&pool->lock);
+	pool->numWorkers = n;
+	pool->started = 1;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+	return 0;
+}
+
+/*
+ * function: void taskPoolSubmit(taskPool *pool, taskFunction function, void *arg)
+ * parameters: pool - task pool, function/arg - work to run
+ * returns: void
+ * description: Queues the task on the caller's own deque (workers) or the shared outside
+ * deque (any other thread) and wakes an idle worker.
+ */
+void taskPoolSubmit(taskPool *pool, taskFunction function, void *arg){
+	task t;
+	int self = (workerId >= 0) ? workerId : pool->numWorkers;
+
+	t.function = function;
+	t.arg = arg;
+	pthread_mutex_lock(&pool->lock);
+	pool->pending++;
+	pool->queued++;
+	pthread_mutex_unlock(&pool->lock);
+
+	if(pushTask(&pool->queues[self], t) != 0){
+		pthread_mutex_lock(&pool->lock);
+		pool->queued--;
+		pthread_mutex_unlock(&pool->lock);
+		runTask(pool, t);
+		return;
+	}
+	pthread_mutex_lock(&pool->lock);
+	pthread_cond_signal(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * function: void taskPoolWait(taskPool *pool)
+ * parameters: pool - task pool
+ * returns: void
+ * description: Joins all outstanding work. Call from the thread that submitted it (not from
+ * inside a task). The caller steals and runs tasks instead of just sleeping.
+ */
+void taskPoolWait(taskPool *pool){
+	int self = (workerId >= 0) ? workerId : pool->numWorkers;
+	task t;
+
+	while(1){
+		if(findTask(pool, self, &t)){
+			runTask(pool, t);
+			continue;
+		}
+		pthread_mutex_lock(&pool->lock);
+		if(pool->pending == 0){
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		if(pool->queued == 0){
+			pthread_cond_wait(&pool->done, &pool->lock);
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+void taskPoolDestroy(taskPool *pool){
+	int n;
+
+	taskPoolWait(pool);
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+	for(n = 0; n < pool->numWorkers; n++){
+		pthread_join(pool->threads[n], NULL);
+	}
+	for(n = 0; n <= TASK_MAX_WORKERS; n++){
+		pthread_mutex_destroy(&pool->queues[n].lock);
+	}
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->wake);
+	pthread_cond_destroy(&pool->done);
+}
@@ -0,0 +1,48 @@
+/* taskPool.h
+ *Description: Small work-stealing thread pool for the logic analyzer. Each worker owns a deque
+ * of tasks: it pushes and pops at the tail, and idle workers steal from the head of the others,
+ * so uneven channels (a busy clock next to an idle enable line) still keep every core busy.
+ * taskPoolWait() is the join point; the calling thread runs tasks too while it waits.
+ */
+
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <pthread.h>
+
+#define TASK_MAX_WORKERS	8
+#define TASK_QUEUE_SIZE		256		// per worker; a full queue runs the task inline
+
+typedef void (*taskFunction)(void *arg);
+
+typedef struct{
+	taskFunction function;
+	void *arg;
+}task;
+
+typedef struct{
+	pthread_mutex_t lock;
+	unsigned int head;		// thieves take from here
+	unsigned int tail;		// owner pushes and pops here
+	task tasks[TASK_QUEUE_SIZE];
+}taskDeque;
+
+typedef struct{
+	int numWorkers;
+	pthread_t threads[TASK_MAX_WORKERS];
+	taskDeque queues[TASK_MAX_WORKERS + 1];	// last queue is fed by non-worker threads
+	pthread_mutex_t lock;
+	pthread_cond_t wake;		// new work or shutdown
+	pthread_cond_t done;		// pending reached zero
+	int pending;				// submitted but not finished
+	int queued;					// submitted but not yet taken from a deque
+	int stop;
+	int started;				// numWorkers is final, workers may start looking for tasks
+}taskPool;
+
+int taskPoolInit(taskPool *pool, int numWorkers);
+void taskPoolSubmit(taskPool *pool, taskFunction function, void *arg);
+void taskPoolWait(taskPool *pool);
+void taskPoolDestroy(taskPool *pool);
+
+#endif
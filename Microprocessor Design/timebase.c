@@ -0,0 +1,209 @@
+/* timebase.c
+ *Description: Capture header decoding, sample/time conversion across rate segments, and the
+ * text helpers used for time and frequency entry and display.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timebase.h"
+
+#define NS_PER_SECOND 1000000000ull
+
+static uint32_t readUint32(const uint8_t *bytes){
+	return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) |
+		((uint32_t)bytes[3] << 24);
+}
+
+/*
+ * function: int captureHeaderDecode(const uint8_t *bytes, captureHeader *header)
+ * parameters: bytes - CAPTURE_HEADER_SIZE bytes from the UART, header - decoded header
+ * returns: 0 if the bytes hold a valid header, -1 otherwise
+ */
+int captureHeaderDecode(const uint8_t *bytes, captureHeader *header){
+	if(bytes[0] != CAPTURE_HEADER_SYNC0 || bytes[1] != CAPTURE_HEADER_SYNC1){
+		return -1;
+	}
+	header->sampleRate = readUint32(&bytes[2]);
+	header->timestamp = readUint32(&bytes[6]);
+	return (header->sampleRate > 0) ? 0 : -1;
+}
+
+/*
+ * function: uint32_t achievableRate(uint32_t requested)
+ * parameters: requested - sample rate asked for, in Hz
+ * returns: the closest rate the PSoC sample clock divider can produce
+ */
+uint32_t achievableRate(uint32_t requested){
+	uint32_t divider;
+	if(requested == 0){
+		requested = 1;
+	}
+	divider = (PSOC_SAMPLE_CLOCK + requested / 2) / requested;
+	if(divider < 1){
+		divider = 1;
+	}
+	return PSOC_SAMPLE_CLOCK / divider;
+}
+
+void timebaseInit(timebase *tb){
+	memset(tb, 0, sizeof(*tb));
+}
+
+/*
+ * function: int timebaseAddHeader(timebase *tb, uint32_t firstSample, const captureHeader *header)
+ * parameters: tb - timebase, firstSample - index of the first sample taken under this header,
+ *             header - header received from the PSoC
+ * returns: 0 on success, -1 if the timebase has no room for another rate change
+ * description: Starts a new segment. Its start time comes from the PSoC timestamp, so any gap
+ * while the sample clock was being reprogrammed shows up as real time.
+ */
+int timebaseAddHeader(timebase *tb, uint32_t firstSample, const captureHeader *header){
+	timebaseSegment *segment;
+	uint64_t us;
+
+	if(tb->numSegments > 0 && header->timestamp < tb->lastTimestamp){
+		tb->timestampBase += 1ull << 32; // microsecond counter wrapped
+	}
+	tb->lastTimestamp = header->timestamp;
+	us = tb->timestampBase + header->timestamp;
+
+	if(tb->numSegments > 0 && tb->segments[tb->numSegments - 1].firstSample == firstSample){
+		tb->numSegments--; // no samples were taken at the previous rate, exporters announce it again
+	}else if(tb->numSegments == TIMEBASE_MAX_SEGMENTS){
+		return -1;
+	}
+	if(tb->numSegments == 0){
+		tb->firstUs = us; // the first segment, or the one replacing it, starts at time 0
+	}
+	segment = &tb->segments[tb->numSegments++];
+	segment->firstSample = firstSample;
+	segment->sampleRate = header->sampleRate;
+	segment->startNs = (us - tb->firstUs) * 1000;
+	return 0;
+}
+
+static const timebaseSegment *segmentFor(const timebase *tb, uint32_t sample){
+	int n = tb->numSegments - 1;
+	while(n > 0 && tb->segments[n].firstSample > sample){
+		n--;
+	}
+	return &tb->segments[n];
+}
+
+uint32_t timebaseRateAt(const timebase *tb, uint32_t sample){
+	return (tb->numSegments > 0) ? segmentFor(tb, sample)->sampleRate : 0;
+}
+
+/*
+ * function: uint64_t timebaseSampleToNs(const timebase *tb, uint32_t sample)
+ * parameters: tb - timebase, sample - sample index
+ * returns: time of the sample in nanoseconds from the start of the capture
+ */
+uint64_t timebaseSampleToNs(const timebase *tb, uint32_t sample){
+	const timebaseSegment *segment;
+	if(tb->numSegments == 0){
+		return sample;
+	}
+	segment = segmentFor(tb, sample);
+	return segment->startNs +
+		((uint64_t)(sample - segment->firstSample) * NS_PER_SECOND) / segment->sampleRate;
+}
+
+/*
+ * function: uint32_t timebaseNsToSample(const timebase *tb, uint64_t ns)
+ * parameters: tb - timebase, ns - time from the start of the capture
+ * returns: the sample taken at or just before that time
+ */
+uint32_t timebaseNsToSample(const timebase *tb, uint64_t ns){
+	const timebaseSegment *segment;
+	uint64_t offset;
+	int n = tb->numSegments - 1;
+
+	if(tb->numSegments == 0){
+		return (uint32_t)ns;
+	}
+	while(n > 0 && tb->segments[n].startNs > ns){
+		n--;
+	}
+	segment = &tb->segments[n];
+	offset = (ns > segment->startNs) ? ns - segment->startNs : 0;
+	// Split so that offset * rate can't overflow on long captures
+	return segment->firstSample + (uint32_t)((offset / NS_PER_SECOND) * segment->sampleRate +
+		((offset % NS_PER_SECOND) * segment->sampleRate) / NS_PER_SECOND);
+}
+
+/*
+ * function: void formatTime(int64_t ns, char *text)
+ * parameters: ns - time in nanoseconds, text - at least TIME_TEXT_SIZE characters
+ * returns: void
+ * description: Prints the time with a unit that keeps the number readable, e.g. "12.5 us".
+ */
+void formatTime(int64_t ns, char *text){
+	int64_t magnitude = (ns < 0) ? -ns : ns;
+	if(magnitude < 1000){
+		sprintf(text, "%lld ns", (long long)ns);
+	}else if(magnitude < 1000000){
+		sprintf(text, "%.4g us", ns / 1e3);
+	}else if(magnitude < 1000000000){
+		sprintf(text, "%.4g ms", ns / 1e6);
+	}else{
+		sprintf(text, "%.4g s", ns / 1e9);
+	}
+}
+
+/*
+ * function: int parseTime(const char *text, uint64_t *ns)
+ * parameters: text - a number followed by ns, us, ms or s (us if no unit), ns - result
+ * returns: 0 on success, -1 if the text isn't a time
+ */
+int parseTime(const char *text, uint64_t *ns){
+	char *unit;
+	double value = strtod(text, &unit);
+	double scale = 1e3;
+
+	if(unit == text || value < 0){
+		return -1;
+	}
+	while(*unit == ' '){
+		unit++;
+	}
+	if(strncmp(unit, "ns", 2) == 0){
+		scale = 1;
+	}else if(strncmp(unit, "ms", 2) == 0){
+		scale = 1e6;
+	}else if(unit[0] == 's'){
+		scale = 1e9;
+	}else if(strncmp(unit, "us", 2) != 0 && unit[0] != '\0' && unit[0] != '\n'){
+		return -1;
+	}
+	*ns = (uint64_t)(value * scale + 0.5);
+	return 0;
+}
+
+/*
+ * function: int parseFrequency(const char *text, uint32_t *hz)
+ * parameters: text - a number optionally followed by k or M, hz - result
+ * returns: 0 on success, -1 if the text isn't a frequency
+ */
+int parseFrequency(const char *text, uint32_t *hz){
+	char *unit;
+	double value = strtod(text, &unit);
+
+	if(unit == text){
+		return -1;
+	}
+	while(*unit == ' '){
+		unit++;
+	}
+	if(*unit == 'k' || *unit == 'K'){
+		value *= 1e3;
+	}else if(*unit == 'M'){
+		value *= 1e6;
+	}
+	if(value < 1 || value > 4e9){
+		return -1;
+	}
+	*hz = (uint32_t)(value + 0.5);
+	return 0;
+}
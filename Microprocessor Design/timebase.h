@@ -0,0 +1,56 @@
+/* timebase.h
+ *Description: Sample timebase for logic analyzer captures. The PSoC starts every capture, and
+ * every change of sample rate, with a capture header giving the rate its sample clock actually
+ * runs at and a timestamp from its free-running microsecond counter. Each header opens a new
+ * segment of the timebase, so the rate can change mid-capture without restarting, and any
+ * sample index can be turned into real time (and back).
+ *
+ * Header on the wire (little endian, CAPTURE_HEADER_SIZE bytes):
+ *  0xA5 0x5A, uint32 sample rate in Hz, uint32 timestamp in microseconds
+ */
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <stdint.h>
+
+#define CAPTURE_HEADER_SIZE		10
+#define CAPTURE_HEADER_SYNC0	0xA5
+#define CAPTURE_HEADER_SYNC1	0x5A
+#define TIMEBASE_MAX_SEGMENTS	64
+#define PSOC_SAMPLE_CLOCK		24000000	// Hz, sample rates are this divided by an integer
+#define TIME_TEXT_SIZE			24
+
+typedef struct{
+	uint32_t sampleRate;	// Hz
+	uint32_t timestamp;		// PSoC microsecond counter at the first sample
+}captureHeader;
+
+typedef struct{
+	uint32_t firstSample;	// first sample taken at this rate
+	uint32_t sampleRate;	// Hz
+	uint64_t startNs;		// time of firstSample from the start of the capture
+}timebaseSegment;
+
+typedef struct{
+	timebaseSegment segments[TIMEBASE_MAX_SEGMENTS];
+	int numSegments;
+	uint32_t lastTimestamp;	// for counter wrap detection
+	uint64_t timestampBase;	// microseconds added for each counter wrap
+	uint64_t firstUs;		// unwrapped timestamp of the first header
+}timebase;
+
+int captureHeaderDecode(const uint8_t *bytes, captureHeader *header);
+uint32_t achievableRate(uint32_t requested);
+
+void timebaseInit(timebase *tb);
+int timebaseAddHeader(timebase *tb, uint32_t firstSample, const captureHeader *header);
+uint32_t timebaseRateAt(const timebase *tb, uint32_t sample);
+uint64_t timebaseSampleToNs(const timebase *tb, uint32_t sample);
+uint32_t timebaseNsToSample(const timebase *tb, uint64_t ns);
+
+void formatTime(int64_t ns, char *text);
+int parseTime(const char *text, uint64_t *ns);
+int parseFrequency(const char *text, uint32_t *hz);
+
+#endif
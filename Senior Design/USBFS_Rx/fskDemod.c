@@ -0,0 +1,172 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * FSK Demodulator
+ * Function: Goertzel filters at each of the tones, in fixed point for
+ * the Cortex-M3 (no FPU). The coefficients are the only floating point and
+ * are worked out once at startup.
+ * =============================================================================
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include "fskDemod.h"
+
+#define COEFF_Q     14
+
+/*
+ * function: static int32 goertzelCoeff(uint32 freq, uint32 sampleRate)
+ * returns: 2cos(2 pi freq / sampleRate) in Q14
+ */
+static int32 goertzelCoeff(uint32 freq, uint32 sampleRate){
+    double coeff = 2.0 * cos(2.0 * M_PI * (double)freq / (double)sampleRate);
+    return (int32)lround(coeff * (1 << COEFF_Q));
+}
+
+/*
+ * function: static int64_t goertzelPower(int32 coeff, const int16 *samples, uint16 count)
+ * returns: squared magnitude of the block at the coefficient's frequency.
+ * A full-scale tone filling the block gives about (amplitude * count / 2)^2.
+ */
+static int64_t goertzelPower(int32 coeff, const int16 *samples, uint16 count){
+    int64_t s1 = 0;
+    int64_t s2 = 0;
+    uint16 n;
+
+    for(n = 0; n < count; n++){
+        int64_t s0 = samples[n] + ((coeff * s1) >> COEFF_Q) - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    return s1 * s1 + s2 * s2 - ((coeff * s1 * s2) >> COEFF_Q);
+}
+
+void fskDemodInit(fskDemod *demod, uint32 sampleRate){
+    uint8 tone;
+
+    for(tone = 0; tone < MFSK_TONES; tone++){
+        demod->coeff[tone] = goertzelCoeff(mfskFreq[tone], sampleRate);
+    }
+}
+
+/*
+ * function: void fskDemodBlock(const fskDemod *demod, const int16 *samples,
+ *                              uint16 count, fskResult *result)
+ * parameters: demod - from fskDemodInit, samples - ADC block, count - its length,
+ *             result - soft value and tone level of the block
+ * returns: void
+ * description: The tone powers are compared with the block's AC energy E.
+ * A pure tone puts count * E / 2 into its Goertzel bin, so dividing by that
+ * makes the result independent of hydrophone gain:
+ *     soft  = 127 * (mark - space) / (count * E / 2)
+ *     level = 255 * (mark + space) / (count * E / 2)
+ *     share = 255 * tone / (count * E / 2)
+ * where mark and space are the top and bottom half of the tones.
+ */
+void fskDemodBlock(const fskDemod *demod, const int16 *samples, uint16 count,
+    fskResult *result){
+    int64_t sum = 0;
+    int64_t energy = 0;
+    int64_t mark = 0;
+    int64_t space = 0;
+    int64_t full, soft, level, power, share;
+    uint16 n;
+    uint8 tone;
+
+    result->soft = 0;
+    result->level = 0;
+    for(tone = 0; tone < MFSK_TONES; tone++){
+        result->share[tone] = 0;
+    }
+    if(count == 0){
+        return;
+    }
+    for(n = 0; n < count; n++){
+        sum += samples[n];
+        energy += (int64_t)samples[n] * samples[n];
+    }
+    energy -= (sum * sum) / count; // ignore the ADC's DC offset
+    full = (energy * count) / 2;
+    if(full <= 0){
+        return;
+    }
+
+    for(tone = 0; tone < MFSK_TONES; tone++){
+        power = goertzelPower(demod->coeff[tone], samples, count);
+        share = (FSK_SHARE_MAX * power) / full;
+        result->share[tone] = (uint8)((share > FSK_SHARE_MAX) ? FSK_SHARE_MAX : share);
+        if(tone >= MFSK_TONES / 2){
+            mark += power;
+        }else{
+            space += power;
+        }
+    }
+    soft = (FSK_SOFT_MAX * (mark - space)) / full;
+    level = (FSK_SHARE_MAX * (mark + space)) / full;
+    if(soft > FSK_SOFT_MAX){
+        soft = FSK_SOFT_MAX;
+    }else if(soft < -FSK_SOFT_MAX){
+        soft = -FSK_SOFT_MAX;
+    }
+    result->soft = (int8)soft;
+    result->level = (uint8)((level > FSK_SHARE_MAX) ? FSK_SHARE_MAX : level);
+}
+
+// Start summing a new symbol
+void fskSymbolReset(fskSymbol *symbol){
+    uint8 tone;
+
+    for(tone = 0; tone < MFSK_TONES; tone++){
+        symbol->share[tone] = 0;
+    }
+    symbol->blocks = 0;
+}
+
+void fskSymbolAdd(fskSymbol *symbol, const fskResult *block){
+    uint8 tone;
+
+    for(tone = 0; tone < MFSK_TONES; tone++){
+        symbol->share[tone] += block->share[tone];
+    }
+    symbol->blocks++;
+}
+
+/*
+ * function: void fskSymbolBits(const fskSymbol *symbol, int8 *soft)
+ * parameters: symbol - tone shares summed over one symbol
+ *             soft - filled with MFSK_BITS soft values, first bit first
+ * returns: void
+ * description: A bit's soft value is the strongest tone that would make it
+ * a 1 less the strongest that would make it a 0, scaled so a clean symbol
+ * gives FSK_SOFT_MAX like a clean 2-tone bit:
+ *     soft = 127 * (one - zero) / (255 * blocks)
+ */
+void fskSymbolBits(const fskSymbol *symbol, int8 *soft){
+    int32 one, zero, value;
+    uint8 bit, tone;
+
+    for(bit = 0; bit < MFSK_BITS; bit++){
+        uint8 mask = (uint8)(1u << (MFSK_BITS - 1 - bit));
+
+        one = 0;
+        zero = 0;
+        for(tone = 0; tone < MFSK_TONES; tone++){
+            if((mfskSymbol(tone) & mask) != 0u){
+                one = (symbol->share[tone] > one) ? symbol->share[tone] : one;
+            }else{
+                zero = (symbol->share[tone] > zero) ? symbol->share[tone] : zero;
+            }
+        }
+        value = 0;
+        if(symbol->blocks != 0){
+            value = (FSK_SOFT_MAX * (one - zero)) / (FSK_SHARE_MAX * symbol->blocks);
+        }
+        if(value > FSK_SOFT_MAX){
+            value = FSK_SOFT_MAX;
+        }else if(value < -FSK_SOFT_MAX){
+            value = -FSK_SOFT_MAX;
+        }
+        soft[bit] = (int8)value;
+    }
+}
+
+/* [] END OF FILE */
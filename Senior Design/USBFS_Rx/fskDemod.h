@@ -0,0 +1,48 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * FSK Demodulator
+ * Function: Decides between the transmitter's tones (mfsk.h) from blocks of
+ * hydrophone ADC samples. Each block goes through a Goertzel filter at each
+ * tone and gives a soft value: how much more of the block's energy is in
+ * the top half of the tones (mark, a 1) than in the bottom half (space, a
+ * 0). Blocks of noise give values near 0, so summing soft values over a bit
+ * weights the clean parts of the bit most. In 2-tone mode that is all there
+ * is; with more tones, each tone's share of the energy is also summed over
+ * the symbol and gives a soft value for each of the symbol's bits.
+ * =============================================================================
+*/
+
+#ifndef FSK_DEMOD_H
+#define FSK_DEMOD_H
+
+#include "project.h"
+#include "mfsk.h"
+
+#define FSK_SOFT_MAX        127     // soft value of a clean mark block
+#define FSK_SHARE_MAX       255     // share of a tone that has all the energy
+
+typedef struct{
+    int32 coeff[MFSK_TONES];    // 2cos(2 pi f / fs), Q14
+}fskDemod;
+
+typedef struct{
+    int8 soft;                  // -FSK_SOFT_MAX (space) to FSK_SOFT_MAX (mark)
+    uint8 level;                // share of the block's energy in the tones, 255 = all
+    uint8 share[MFSK_TONES];    // and in each tone
+}fskResult;
+
+typedef struct{
+    int32 share[MFSK_TONES];    // tone shares summed over the symbol's blocks
+    uint16 blocks;
+}fskSymbol;
+
+void fskDemodInit(fskDemod *demod, uint32 sampleRate);
+void fskDemodBlock(const fskDemod *demod, const int16 *samples, uint16 count,
+    fskResult *result);
+void fskSymbolReset(fskSymbol *symbol);
+void fskSymbolAdd(fskSymbol *symbol, const fskResult *block);
+void fskSymbolBits(const fskSymbol *symbol, int8 *soft);
+
+#endif /* FSK_DEMOD_H */
+
+/* [] END OF FILE */
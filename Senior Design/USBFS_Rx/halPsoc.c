@@ -0,0 +1,267 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Receiver HAL (PSoC 5LP)
+ * Function: Implements ../common/hal.h on top of the USBFS_Rx components.
+ * Only the calls the receiver makes are implemented.
+ * =============================================================================
+*/
+
+#include "project.h"
+#include "hal.h"
+#include "dwtCycle.h"
+
+/* ADC_DMA moves each ADC_SAR_Hydro result into adcRing, wrapping forever */
+#define ADC_DMA_BYTES_PER_BURST     2u
+#define ADC_DMA_REQUEST_PER_BURST   1u
+#define ADC_MID_SCALE               2048    /* 12-bit single ended */
+
+static int16 adcRing[HAL_ADC_RING_SIZE];
+static uint8 adcTd = CY_DMA_INVALID_TD;
+
+// Starts the ADC and a DMA channel whose only TD loops back on itself
+static void adcStart(void){
+    uint8 channel;
+
+    ADC_SAR_Hydro_Start();
+    if(adcTd == CY_DMA_INVALID_TD){
+        channel = ADC_DMA_DmaInitialize(ADC_DMA_BYTES_PER_BURST, ADC_DMA_REQUEST_PER_BURST,
+            HI16(CYDEV_PERIPH_BASE), HI16(CYDEV_SRAM_BASE));
+        adcTd = CyDmaTdAllocate();
+        CyDmaTdSetConfiguration(adcTd, sizeof(adcRing), adcTd, TD_INC_DST_ADR);
+        CyDmaTdSetAddress(adcTd, LO16((uint32)ADC_SAR_Hydro_SAR_WRK0_PTR), LO16((uint32)adcRing));
+        CyDmaChSetInitialTd(channel, adcTd);
+        CyDmaChEnable(channel, 1u);
+    }
+    ADC_SAR_Hydro_StartConvert();
+}
+
+void HAL_IntEnable(void){
+    CyGlobalIntEnable;
+}
+
+void HAL_IsrStart(halIrq irq, halIsr handler){
+    switch(irq){
+        case HAL_IRQ_BIT_TIMER:
+            Data_ISR_StartEx(handler);
+            break;
+        case HAL_IRQ_UART_WAKE:
+            RxWakeUp_StartEx(handler);
+            break;
+        case HAL_IRQ_SLEEP:
+            Sleep_ISR_StartEx(handler);
+            break;
+        case HAL_IRQ_WDT_CHECK:
+            watchDogCheck_StartEx(handler);
+            break;
+        default:
+            break;
+    }
+}
+
+void HAL_IsrSetPending(halIrq irq){
+    if(irq == HAL_IRQ_BIT_TIMER){
+        Data_ISR_SetPending();
+    }
+}
+
+void HAL_IsrClearPending(halIrq irq){
+    if(irq == HAL_IRQ_UART_WAKE){
+        RxWakeUp_ClearPending();
+    }
+}
+
+void HAL_TimerStart(halTimer timer){
+    if(timer == HAL_TIMER_BIT){
+        Bit_Timer_Start();
+    }else if(timer == HAL_TIMER_WDT_CHECK){
+        checkWatchDogTimer_Start();
+    }
+}
+
+void HAL_TimerSleep(halTimer timer){
+    if(timer == HAL_TIMER_BIT){
+        Bit_Timer_Sleep();
+    }else if(timer == HAL_TIMER_WDT_CHECK){
+        checkWatchDogTimer_Sleep();
+    }
+}
+
+void HAL_TimerWakeup(halTimer timer){
+    if(timer == HAL_TIMER_BIT){
+        Bit_Timer_Wakeup();
+    }else if(timer == HAL_TIMER_WDT_CHECK){
+        checkWatchDogTimer_Wakeup();
+    }
+}
+
+void HAL_DelayMs(uint32 ms){
+    CyDelay(ms);
+}
+
+// The main loop only polls flags set by the ISRs
+void HAL_Idle(void){
+}
+
+void HAL_WdtStart(void){
+    CyWdtStart(CYWDT_16_TICKS, CYWDT_LPMODE_DISABLED); // 32-48 ms
+}
+
+void HAL_WdtClear(void){
+    CyWdtClear();
+}
+
+void HAL_SleepTimerStart(void){
+    SleepTimer_Start();
+}
+
+void HAL_SleepTimerStop(void){
+    SleepTimer_Stop();
+}
+
+void HAL_SleepTimerClear(void){
+    SleepTimer_GetStatus();
+}
+
+/*  The SleepTimer takes powers of two from 2 ms (SleepTimer__CTW_2_MS, 0)
+*   to 4096 ms (SleepTimer__CTW_4096_MS, 11), the nearest one below ms
+*/
+void HAL_SleepTimerSetInterval(uint16 ms){
+    uint8 interval = SleepTimer__CTW_2_MS;
+
+    while((interval < SleepTimer__CTW_4096_MS) && ((4u << interval) <= ms)){
+        interval++;
+    }
+    SleepTimer_SetInterval(interval);
+}
+
+void HAL_SaveClocks(void){
+    CyPmSaveClocks();
+}
+
+void HAL_RestoreClocks(void){
+    CyPmRestoreClocks();
+}
+
+/*  Sleep time is set by the SleepTimer, the hardware block's 
+*   setting or HAL_SleepTimerSetInterval(),
+*   PM_SLEEP_TIME_NONE is a relic of PSoC3
+*/
+void HAL_Sleep(void){
+    CyPmSleep(PM_SLEEP_TIME_NONE, PM_SLEEP_SRC_CTW);
+}
+
+void HAL_PinWrite(halPin pin, uint8 value){
+    switch(pin){
+        case HAL_PIN_POWER:
+            Power_Toggle_Write(value);
+            break;
+        case HAL_PIN_COUNT_OUT:
+            Count_Out_Write(value);
+            break;
+        case HAL_PIN_SLEEP_TOGGLE:
+            sleepToggle_Write(value);
+            break;
+        default:
+            break;
+    }
+}
+
+void HAL_FrontEndStart(void){
+    PWM_Recon_Start();
+    Shift_Reg_Start();
+    Out_Comp_Start();
+    adcStart();
+}
+
+void HAL_FrontEndSleep(void){
+    PWM_Recon_Sleep();
+    Shift_Reg_Sleep();
+    Out_Comp_Sleep();
+    ADC_SAR_Hydro_Sleep();
+}
+
+void HAL_FrontEndWakeup(void){
+    PWM_Recon_Wakeup();
+    Shift_Reg_Wakeup();
+    Out_Comp_Wakeup();
+    ADC_SAR_Hydro_Wakeup();
+}
+
+uint8 HAL_CompRead(void){
+    return Out_Comp_GetCompare();
+}
+
+/*
+ * function: uint16 HAL_AdcRead(int16 *samples, uint16 count)
+ * parameters: samples - destination, count - samples wanted
+ * returns: samples copied (count, at most HAL_ADC_RING_SIZE)
+ * description: The TD's remaining byte count gives where DMA writes next,
+ * the newest samples end just before it.
+ */
+uint16 HAL_AdcRead(int16 *samples, uint16 count){
+    uint16 remaining;
+    uint8 nextTd;
+    uint8 config;
+    uint16 index;
+    uint16 n;
+
+    if(count > HAL_ADC_RING_SIZE){
+        count = HAL_ADC_RING_SIZE;
+    }
+    CyDmaTdGetConfiguration(adcTd, &remaining, &nextTd, &config);
+    index = (uint16)((sizeof(adcRing) - remaining) / sizeof(adcRing[0]));
+    index = (uint16)((index + HAL_ADC_RING_SIZE - count) % HAL_ADC_RING_SIZE);
+    for(n = 0; n < count; n++){
+        samples[n] = adcRing[index] - ADC_MID_SCALE;
+        index = (uint16)((index + 1u) % HAL_ADC_RING_SIZE);
+    }
+    return count;
+}
+
+void HAL_UartStart(void){
+    UART_Start();
+}
+
+// Lets the telemetry still in the FIFO go out first
+void HAL_UartSleep(void){
+    while(UART_GetTxBufferSize() != 0u){
+    }
+    while((UART_ReadTxStatus() & UART_TX_STS_COMPLETE) == 0u){
+    }
+    UART_Sleep();
+}
+
+void HAL_UartWakeup(void){
+    UART_Wakeup();
+}
+
+// Waits for room in the FIFO, telemetry frames are longer than it
+void HAL_UartPutChar(uint8 byte){
+    UART_PutChar(byte);
+}
+
+void HAL_LcdStart(void){
+    LCD_Char_Start();
+}
+
+void HAL_LcdSleep(void){
+    LCD_Char_Sleep();
+}
+
+void HAL_LcdWakeup(void){
+    LCD_Char_Wakeup();
+}
+
+void HAL_LcdClear(void){
+    LCD_Char_ClearDisplay();
+}
+
+void HAL_LcdPosition(uint8 row, uint8 column){
+    LCD_Char_Position(row, column);
+}
+
+void HAL_LcdPrintString(const char8 *text){
+    LCD_Char_PrintString(text);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,65 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Link Quality
+ * Function: Averages the per-copy margin of the frames at one rate and steps
+ * the suggestion one rung up or down the ladder from it.
+ * =============================================================================
+*/
+
+#include "linkQuality.h"
+#include "linkRate.h"
+
+/*  One copy is trusted alone from a margin of 192 (softCombiner.c). Going
+*   one rung faster about halves the margin, so a rate is only left for the
+*   next faster one with twice that and some to spare, and only after
+*   QUALITY_FRAMES frames said so. Below half of it most messages need all
+*   their copies, or fail, and the next slower rung is suggested at once.
+*/
+#define RATE_UP_MARGIN      480
+#define RATE_DOWN_MARGIN    96
+#define QUALITY_FRAMES      2
+#define QUALITY_WEIGHT      4   // a new frame counts 1/4 in the average
+
+void linkQualityReset(linkQuality *quality){
+    quality->rate = 0;
+    quality->frames = 0;
+    quality->margin = 0;
+    quality->suggested = 0;
+}
+
+/*
+ * function: uint8 linkQualityFrame(linkQuality *quality, uint8 rate, uint8 checked, int16 margin)
+ * parameters: quality - state
+ *             rate - the frame's rate field
+ *             checked - its CRC matched
+ *             margin - its decode margin, per copy combined into it
+ * returns: the rate to suggest
+ * description: A frame that failed its CRC counts as no margin. Frames at
+ * another rate than the last start the average over.
+ */
+uint8 linkQualityFrame(linkQuality *quality, uint8 rate, uint8 checked, int16 margin){
+    if(checked == 0){
+        margin = 0;
+    }
+    if((quality->frames == 0) || (rate != quality->rate)){
+        quality->rate = rate;
+        quality->frames = 0;
+        quality->margin = margin;
+    }else{
+        quality->margin += (margin - quality->margin) / QUALITY_WEIGHT;
+    }
+    if(quality->frames < QUALITY_FRAMES){
+        quality->frames++;
+    }
+
+    quality->suggested = rate;
+    if((quality->margin < RATE_DOWN_MARGIN) && (rate > 0)){
+        quality->suggested = rate - 1;
+    }else if((quality->frames >= QUALITY_FRAMES) && (quality->margin >= RATE_UP_MARGIN) &&
+        (rate + 1 < LINK_RATES)){
+        quality->suggested = rate + 1;
+    }
+    return quality->suggested;
+}
+
+/* [] END OF FILE */
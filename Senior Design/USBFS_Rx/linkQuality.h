@@ -0,0 +1,29 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Link Quality
+ * Function: Judges how well frames come in at the rate they were sent at
+ * (linkRate.h) and suggests the rate the transmitter should use next. The
+ * measure is the soft decoder's margin per copy: how far the weakest byte's
+ * best codeword leads the next. It shrinks with the signal to noise ratio,
+ * and halving the symbol time halves the energy behind every bit.
+ * =============================================================================
+*/
+
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+
+#include "project.h"
+
+typedef struct{
+    uint8 rate;         // rate of the frames judged
+    uint8 frames;       // frames judged at that rate
+    int16 margin;       // per-copy margin, averaged over the last frames
+    uint8 suggested;    // rate to ask the transmitter for
+}linkQuality;
+
+void linkQualityReset(linkQuality *quality);
+uint8 linkQualityFrame(linkQuality *quality, uint8 rate, uint8 checked, int16 margin);
+
+#endif /* LINK_QUALITY_H */
+
+/* [] END OF FILE */
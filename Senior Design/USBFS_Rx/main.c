@@ -4,37 +4,61 @@
  * Edited by: Stephanie Salazar
  * Revision: 5/29/18
  * Function: This project takes in a signal from an outside source
- * and reads the data within the signal. This code waits for a pre-fix
- * of 0xFF and then reads the next 4 bits as the data and confirms
- * the message with a post-fix of 0x01. The data is displayed on an LCD display.
+ * and reads the data within the signal. This code waits for the Barker
+ * sync word and the rate field, then reads the FEC coded packet (length
+ * byte, crab report, CRC) at that rate and confirms the message with a
+ * post-fix of 0x01. The report is displayed on an LCD display, along with
+ * the rate the transmitter should use next. A record of every copy and
+ * result goes out the UART once a host attaches to it (telemetry.h).
  * =============================================================================
 */
 
 #include "project.h"
 #include <stdio.h>
-#include "LCD_Char.h"
+#include "hal.h"
+#include "fskDemod.h"
+#include "symbolTiming.h"
+#include "syncDetect.h"
+#include "eventQueue.h"
+#include "fec.h"
+#include "packet.h"
+#include "softCombiner.h"
+#include "linkRate.h"
+#include "linkQuality.h"
+#include "telemetry.h"
+#include "profile.h"
 
 #define SLEEP_ON
-#define ARRAY_SIZE          12
+#define DEMOD_GOERTZEL      // Goertzel on the ADC, comment out for the comparator
+#define ARRAY_SIZE          21 // one 20-character LCD line
 #define COUNT               100
+#define TICK_MS             5   // Bit_Timer period
 #define PREFIX_ACCURACY     90
+#define SYNC_THRESHOLD      75  // correlation (percent) that counts as the sync word
 #define DATA_ACCURACY       70
 #define DATA_LENGTH         7
-#define PREFIX              0xFF
 #define POSTFIX             0x01
-#define SUCCESS             0x1
-#define FAILURE             0x0
 #define TRUE                0x1
 #define FALSE               0x0
 #define ON                  0x1
 #define OFF                 0x0
 #define FiveSecs            5000
-#define TRANSMISSIONS_3     2
+#define TRANSMISSIONS       3   // most copies of a message to combine
 #define Delay               4
-#define DATA_STORED         3
 #define OVERTIME            8105  
+#define COPY_SYNC_TICKS     1800 // Bit_Timer ticks from a post-fix to the next copy's sync word
+                                 // (15 symbols), a new message's comes 21 or more after
 #define INVALID             -1
 #define BYTE                8
+#define DEMOD_BLOCK         (HAL_ADC_SAMPLE_RATE / 200u) // ADC samples in a 5 ms tick
+#define DEMOD_DETECT_LEVEL  16  // tone level (of 255) that wakes the receiver
+#define LISTEN_INTERVAL_MS  32  // sleep between listens, a power of two from 2 to 4096
+#define LISTEN_LOOKS        3   // looks at the front end per listen
+#define LISTEN_LOOK_MS      TICK_MS // apart, one Bit_Timer tick and a DEMOD_BLOCK of samples
+#define LOOK_QUIET          0   // signalLook(): nothing there, back to sleep
+#define LOOK_MORE           1   // take another look
+#define LOOK_HEARD          2   // a transmission seems to be starting
+#define LISTEN_QUIET_LEVEL  (DEMOD_DETECT_LEVEL / 2) // a first look below this is silence
 
 
 #define BIT_0_MASK 0x01
@@ -46,23 +70,57 @@
 #define BIT_6_MASK 0x40
 #define BIT_7_MASK 0x80
 
+// What Bit_Timer asks the main loop to show
+enum displayEvent{
+    EVENT_SYNC,     // sync word found
+    EVENT_DATA,     // value = crabs so far (INVALID: bad CRC), flag = bits corrected
+    EVENT_POSTFIX,  // flag = TRUE for a good post-fix
+    EVENT_TRAP,     // value = trap ID of the result that follows
+    EVENT_RESULT,   // value = crabs (INVALID: no good packet), flag = copies combined
+    EVENT_MINUTES,  // value = the result's minutes since its trap started
+    EVENT_BATTERY,  // value = the result's trap battery, 0.1 V
+    EVENT_RATE,     // value = rate to suggest, flag = rate the result came at
+};
+
+// What profile.h times, PROFILE_ON builds only
+enum profileSlot{
+    PROFILE_BIT_TIMER,
+    PROFILE_WDT_CHECK,
+    PROFILE_WAKEUP,
+    PROFILE_HOST_WAKE,
+    PROFILE_EVENTS,     // main loop: showing what the ISRs queued
+    PROFILE_TELEMETRY,  // main loop: sending the telemetry
+    PROFILE_SLOT_COUNT
+};
+
 /*Function Prototypes*/
 void Display(void);
-int CheckParity(int);
-void SendData(void);
+void showEvent(const event *shown);
+void sendTelemetry(void);
+void logRecord(uint8 type);
+#ifdef PROFILE_ON
+void sendProfile(void);
+void profileFrame(const char8 *line);
+#endif
 void startModules(void);
 void sleepModules(void);
 void wakeUpModules(void);
+void listenWakeup(void);
+void listenSleep(void);
 void LCD_Display(void); 
 void accuracy_Check(int count, int accuracy); 
 void dataReset(void); 
-void dataTransmission(void); 
-uint8 majorityVote(void);
+void dataTransmission(int16 finalData, uint8 copies); 
+void reportResult(void);
+void bitReceived(void);
+uint8 signalLook(void);
+void listenLook(void);
 
 // Interrupt for switching bits 5 ms
 CY_ISR_PROTO(Bit_Timer);
 CY_ISR_PROTO(watchDogCheck);
 CY_ISR_PROTO(wakeUp_ISR);
+CY_ISR_PROTO(hostWake);
 
 // Global Variables
 static uint16 levelCounter = 0; // Timer counter to debounce bit
@@ -71,76 +129,183 @@ static uint16 oneCount = 0; // 1 count used in timer counter debounce
 static uint8 currentBit = 0; // x/10 bit decision for 500 ms bit
 static uint8 dataCount = 0; // which bit of data we are looking at
 static uint16 data = 0; // byte bits of data
-static uint16 crabs = 0; // byte of data transferred from data variable
+static int16 crabs = 0; // crabs in the packet, INVALID if it failed its CRC
 static uint8 dataFlag = 0; // Flag to start looking for data
 static uint8 postfixFlag = 0; // Flag to start looking for post-fix
-static uint8 paritySuccess = 0; // Flag for whether transmitted parity matches data
-static uint8 threeTransmissions = 0; // checks for 3 transmission before reinstatiating sleep timer
+static uint8 postfixDone = FALSE; // all post-fix bits are in
+static uint8 transmissions = 0; // messages received before reinstating sleep timer
 static uint8 sleepFlag = FALSE; 
+static volatile uint8 listenFlag = FALSE; // listenLook heard a signal
+static volatile uint8 quietFlag = FALSE; // listenLook heard nothing, only the front end was up
+static volatile uint8 listening = FALSE; // Bit_Timer only times the looks, wakeUp_ISR set it
+static volatile uint8 lookFlag = FALSE; // Bit_Timer asks the main loop for a look
+static uint8 looks = 0; // taken in this listen
+#ifdef DEMOD_GOERTZEL
+static uint16 lookLevel = 0; // tone level of the looks, added up
+static int16 lookSoft = 0; // and their soft values
+#endif
+static volatile uint8 heartbeatFlag = FALSE; // watchDogCheck cleared the watchdog
+static volatile uint8 awake = TRUE; // every module is up, not just the front end
+static volatile uint8 hostFlag = FALSE; // hostWake saw activity on the UART
+static uint8 hostAttached = FALSE; // a host gets the telemetry, main loop only
+
+// Demodulator state
+#ifdef DEMOD_GOERTZEL
+static fskDemod demod;
+static int16 adcBlock[DEMOD_BLOCK];
+static fskSymbol symbolTones; // tone shares of the symbol so far
+#elif MFSK_ORDER > 2
+#error "more than 2 tones needs DEMOD_GOERTZEL"
+#endif
+static symbolTiming timing; // where each bit starts and ends
+static int8 bitSoft = 0; // soft value of the last bit, -FSK_SOFT_MAX to FSK_SOFT_MAX
+static syncDetect sync; // sliding correlator looking for the sync word
+static int8 codeSoft[FEC_CODED_BITS]; // soft values of the coded bits of one byte
+static uint8 frameIndex = 0; // which byte of the frame is coming in
+static uint8 frameBytes = PACKET_FRAME_BYTES(0); // bytes in this copy's frame
+static packet message; // payload of the combined frame, once it checks out
+static crabReport report; // and the crab report in it
+static softCombiner combiner; // the coded data of every copy so far, added up
+static uint8 confident = FALSE; // the copies so far decode with confidence
+static uint8 resultFlag = FALSE; // done listening, report the combined result
+static int overTimeCount = 0; // Bit_Timer ticks since the transmitter was last heard
+static uint16 syncTicks = 0; // Bit_Timer ticks since the last sync word
+static uint16 copyTicks = 0; // from a copy's sync word to the end of its post-fix
+static uint8 reported = FALSE; // reported before the last copy, the rest are ignored
+static uint8 rateCount = 0; // rate field symbols in so far
+static int16 rateSoft[LINK_RATE_BITS]; // soft values of the rate field, both copies added
+static uint8 frameRate = 0; // rate the frame is coming at
+static linkQuality quality; // how well frames come in, for the rate suggestion
+static telemetryLog telemetry; // what the receiver made of the last copies and results
+static uint32 uptimeMs = 0; // since start, counted by the sleep and bit timers
+
+// Trap the next EVENT_RESULT is from, main loop only
+static uint8 shownTrap = 0;
 
 // LCD String Variables
 static char OutputString[ARRAY_SIZE];
 static char display[ARRAY_SIZE];
 
-// Store Received Data
-static int8 allData[DATA_STORED];
-static int8 parityResult[DATA_STORED];
-static int8 postFixResult[DATA_STORED];
-
 // FLAGS for turning on messages on LCD screen
 static uint8 lcdFlagEncode = FALSE; // Turns on pre-fix message
 static uint8 lcdFlagData = FALSE; // Displays data 
 static uint8 lcdFlagPostfix = FALSE; // good or bad postfix
 //static uint8 decodeWrong = FALSE;
 
+// LCD output waits here for the main loop, the ISRs only sample and decode
+static eventQueue displayEvents;
+
+#ifdef PROFILE_ON
+static const char8 *const profileNames[PROFILE_SLOT_COUNT] = {
+    "Bit_Timer", "watchDogCheck", "wakeUp_ISR", "hostWake", "events", "telemetry"
+};
+#endif
+
 
 int main(void)
 {
-    CyGlobalIntEnable; 
+    HAL_IntEnable(); 
+    #ifdef PROFILE_ON
+    profileInit(profileNames, PROFILE_SLOT_COUNT);
+    #endif
     startModules();
     
     /* Module is turned on- will display again if watchdog timer is enabled */
     sprintf(display, "Starting Module!");
     LCD_Display();
-    CyDelay(500);
+    HAL_DelayMs(500);
    
     // Start watch dog timer to check for blocks in code
-    CyWdtStart(CYWDT_16_TICKS, CYWDT_LPMODE_DISABLED); // 32-48 ms
+    HAL_WdtStart(); // 32-48 ms
 
     // Displays Loading Message before receiving pre-fix=
     sprintf(display, "counting crabs...");
     LCD_Display();
     
-    /*  Sleep Timer will trigger an interrup upon wakeup from sleep (8ms)
+    /*  Sleep Timer will trigger an interrup upon wakeup from sleep 
+    *   (every LISTEN_INTERVAL_MS)
     *   System must be put to sleep right after sleep timer start
     *   Put all modules to sleep using void sleepModules(void) before!!!
-    *   Put system to sleep using CyPmSleep(PM_SLEEP_TIME_NONE, PM_SLEEP_SRC_CTW); 
-    *   PSoC Sleep command. To adjust sleep time, change in the hardware
-    *   block. No sleep time parameters taken in PSoC5LP.
-    *   PM_SLEEP_TIME_NONE is a relic of PSoC3
+    *   Put system to sleep using HAL_Sleep() (CyPmSleep on the PSoC).
     */
     
     #ifdef SLEEP_ON
-    SleepTimer_Start(); 
+    HAL_SleepTimerSetInterval(LISTEN_INTERVAL_MS);
+    HAL_SleepTimerStart(); 
     sleepModules();
-    CyPmSleep(PM_SLEEP_TIME_NONE, PM_SLEEP_SRC_CTW);
+    awake = FALSE;
+    HAL_Sleep();
     #endif 
    
     
     for(;;)
     {
+        event shown;
+        
+        // Nothing to do until an ISR sets a flag
+        if(lookFlag == FALSE){
+            HAL_Idle();
+        }
+        
+        // The front end is up, look for a transmission starting
+        if(lookFlag == TRUE){
+            lookFlag = FALSE;
+            listenLook();
+        }
+        
+        // Output the ISRs asked for, in the order they asked
+        if(listenFlag == TRUE){
+            listenFlag = FALSE;
+            HAL_LcdClear(); 
+            sprintf(display, "counting crabs...");
+            LCD_Display(); 
+        }
+        PROFILE_ENTER(PROFILE_EVENTS);
+        while(eventQueueGet(&displayEvents, &shown) != FALSE){
+            showEvent(&shown);
+        }
+        PROFILE_EXIT(PROFILE_EVENTS);
+        // A host on the UART gets the telemetry, what is in the ring first
+        if(hostFlag == TRUE){
+            hostFlag = FALSE;
+            hostAttached = TRUE;
+        }
+        if(hostAttached == TRUE){
+            PROFILE_ENTER(PROFILE_TELEMETRY);
+            sendTelemetry();
+            PROFILE_EXIT(PROFILE_TELEMETRY);
+            #ifdef PROFILE_ON
+            sendProfile();
+            #endif
+        }
+        if(heartbeatFlag == TRUE){
+            heartbeatFlag = FALSE;
+            HAL_PinWrite(HAL_PIN_SLEEP_TOGGLE, TRUE);
+            HAL_DelayMs(Delay); 
+            HAL_PinWrite(HAL_PIN_SLEEP_TOGGLE, FALSE);
+        }
            
         /*  sleepFlag starts as FALSE set 
-        *   Set to TRUE if wakeup ISR DOES NOT detects data
-        *   Puts the module back to sleep
+        *   Set to TRUE once the message is reported or the transmitter
+        *   went quiet, puts the module back to sleep once the LCD is 
+        *   done with what Bit_Timer queued
         */
         #ifdef SLEEP_ON
-        if(sleepFlag == TRUE){
+        if((sleepFlag == TRUE) && (eventQueuePending(&displayEvents) == FALSE)){
     
             sleepFlag = FALSE;
-            SleepTimer_Start(); 
+            HAL_SleepTimerStart(); 
             sleepModules(); 
-            CyPmSleep(PM_SLEEP_TIME_NONE, PM_SLEEP_SRC_CTW);
+            awake = FALSE;
+            HAL_Sleep();
+            
+        /*  Set if the listen heard nothing, only the front end 
+        *   was up and the sleep timer still runs
+        */
+        }else if(quietFlag == TRUE){
+            
+            quietFlag = FALSE;
+            HAL_Sleep();
             
         }
         #endif
@@ -154,20 +319,38 @@ int main(void)
 // * parameters: void
 // * returns: void
 // * description: Bit length is 500 ms. Bit_Timer checks every 5 ms for
-// * a one or zero. After 100 checks, it decides the bit and looks for
-// * the prefix 0xff. If seen, record data. 
+// * a one or zero. After about 100 checks (timing recovery stretches or
+// * shrinks the bit to follow the transmitter), it decides the bit and
+// * correlates the last 13 bits with the sync word. If seen, record data. 
 // *********************************************************************
 // */
 CY_ISR(Bit_Timer){
     
-   
-    static int overTimeCount = 0;  
-    
+    // A listen, the main loop takes the look
+    if(listening == TRUE){
+        lookFlag = TRUE;
+        return;
+    }
+    PROFILE_ENTER(PROFILE_BIT_TIMER);
     levelCounter++; //counting how many times Bit_Timer ISR set to track bits
     overTimeCount++; 
+    if(syncTicks < 0xFFFFu){
+        syncTicks++;
+    }
+    uptimeMs += TICK_MS;
     
     // Check whether bit is currently 1 or 0
-    if(Out_Comp_GetCompare() != 0){
+    int8 tickSoft;
+#ifdef DEMOD_GOERTZEL
+    fskResult tick;
+    HAL_AdcRead(adcBlock, DEMOD_BLOCK);
+    fskDemodBlock(&demod, adcBlock, DEMOD_BLOCK, &tick);
+    fskSymbolAdd(&symbolTones, &tick);
+    tickSoft = tick.soft;
+#else
+    tickSoft = (HAL_CompRead() != 0) ? FSK_SOFT_MAX : -FSK_SOFT_MAX;
+#endif
+    if(tickSoft > 0){
         oneCount++;
         
     }else{
@@ -176,12 +359,20 @@ CY_ISR(Bit_Timer){
     
     // Debouncing
     /*
-    *   Once levelCounter has reached a full bit length (100)
+    *   Once timing recovery says the bit is over (about COUNT ticks)
     *   Depending if checking for pre-fix or payload 
     *   Will check accuracy of data debouncing 
     *   If >= defined accuracy will record data 
     */
-    if(levelCounter == COUNT){
+    if(symbolTimingTick(&timing, tickSoft) != FALSE){
+        int8 symbolSoft[MFSK_BITS];
+        uint8 bits = 1;
+        uint8 bit;
+        
+        symbolSoft[0] = (int8)timing.symbolSoft; // Soft value of the whole bit
+        
+        // Bits vary in length, scale the count to out of COUNT
+        oneCount = (uint16)((oneCount * COUNT) / levelCounter);
         if((dataFlag == FALSE) && (postfixFlag == FALSE)){ //looking for prefix
             
             accuracy_Check(oneCount, PREFIX_ACCURACY); 
@@ -190,88 +381,199 @@ CY_ISR(Bit_Timer){
             
             accuracy_Check(oneCount, DATA_ACCURACY);
         }
-        
-        dataCount++; // Incremented after every bit
+        oneCount = 0;
+        zeroCount = 0;
         levelCounter = 0; // Reset timer bit debouncer  
         
-        /*  Create data mask
-        *   Store new data (currentBit) in 0'th position 
-        */
-        data = data << 1; // Shift data over to store next bit
-        data = data | currentBit;
-        
-        
-        // Check if data is prefix(oxFF) but we are not looking for data or decode
-        if(((data & PREFIX) == PREFIX) && (dataFlag == FALSE) && (postfixFlag == FALSE)){ 
-            dataCount = 0;
-            data = 0;
-            dataFlag = TRUE; //Start looking for data
-            lcdFlagEncode = TRUE; //Display pre-fix on lcd
-        
-        //Check data by checking next 8 bits and parity (9 bits) after the encoding
-        }else if((dataFlag == TRUE) && (dataCount > DATA_LENGTH+1)){
-            crabs = data;
-            data = 0; //Restart data for decode
-            dataCount = 0; 
-            lcdFlagEncode = FALSE; //Turn off pre-fix message
-            lcdFlagData = TRUE; //Display data
-            postfixFlag = TRUE;
+#ifdef DEMOD_GOERTZEL
+        // Inside the frame each symbol carries MFSK_BITS bits
+        if((dataFlag == TRUE) && (postfixFlag == FALSE) && (rateCount >= LINK_RATE_FIELD_SYMBOLS)){
+            fskSymbolBits(&symbolTones, symbolSoft);
+            bits = MFSK_BITS;
         }
-        
-        // Check for 8 bits of post-fix
-        if(postfixFlag == TRUE && (dataCount > DATA_LENGTH)){
-            // Correct postfix is 0x01
-            if(data == POSTFIX){
-                lcdFlagPostfix = TRUE; // lcd flag for "good" post-fix
-            }else{
-                lcdFlagPostfix = FALSE; // lcd flag for "bad" post-fix
+        fskSymbolReset(&symbolTones);
+#endif
+        for(bit = 0; bit < bits; bit++){
+            // The frame can end part way through a symbol, the rest is padding
+            if((bit > 0) && (postfixFlag == TRUE)){
+                break;
             }
-            postFixResult[threeTransmissions] = lcdFlagPostfix; 
-            //dataFlag = FALSE; //Don't want to check for data anymore
-            
-            threeTransmissions++;
-           
-        }      
-            
-        
-    } // end of if(levelCounter == COUNT)
+            bitSoft = symbolSoft[bit];
+            if(bits > 1){
+                currentBit = (bitSoft > 0) ? 0x01 : 0x00;
+            }
+            bitReceived();
+        }
+    } // end of if(symbolTimingTick())
     
      Display(); //Displays incoming data depending on prefix/data/postfix flags
     
-    //If 3 messages recieved or data not recieved for too long
-    //then, put module back to sleep and
+    //If the message is decoded or data not recieved for too long
+    //then, report it, put module back to sleep and
     //wait for new messages 
-    if(threeTransmissions > TRANSMISSIONS_3 || overTimeCount > OVERTIME  ){
-        threeTransmissions = 0;
+    //Copies after an early report are the same message, stay up
+    //(ignoring them) until a copy's time passes with no sync word
+    if(reported == TRUE){
+        if(overTimeCount > copyTicks + COPY_SYNC_TICKS){
+            reported = FALSE;
+            overTimeCount = 0;
+            #ifdef SLEEP_ON
+            sleepFlag = TRUE; 
+            #endif
+        }
+    }else if(resultFlag == TRUE || overTimeCount > OVERTIME  ){
+        if(combiner.copies > 0){
+            reportResult();
+        }else{
+            logRecord(TELEMETRY_TIMEOUT); // woke up for nothing, or lost the copy
+        }
+        // More copies of this message are coming, sleeping now would wake up to them
+        reported = (resultFlag == TRUE) && (transmissions < TRANSMISSIONS);
+        resultFlag = FALSE;
+        transmissions = 0;
         overTimeCount = 0;
         #ifdef SLEEP_ON
-        sleepFlag = TRUE; 
+        sleepFlag = (reported == FALSE) ? TRUE : FALSE; 
         #endif
         
         dataReset(); 
 
     }
     
-
+    PROFILE_EXIT(PROFILE_BIT_TIMER);
     
 } /* END OF CY_ISR(HighF_LevelCount) */
 
+///*********************************************************************
+// * function: void bitReceived(void)
+// * parameters: void
+// * returns: void
+// * description: Takes the bit in bitSoft and currentBit: correlates it
+// * with the sync word, or keeps it for the frame decoder, or adds it to
+// * the post-fix. Bit_Timer only.
+// *********************************************************************
+// */
+void bitReceived(void)
+{
+    dataCount++; // Incremented after every bit
+    
+    /*  Create data mask
+    *   Store new data (currentBit) in 0'th position 
+    */
+    data = data << 1; // Shift data over to store next bit
+    data = data | currentBit;
+    
+    
+    // Check for the sync word if we are not looking for data or decode
+    if((dataFlag == FALSE) && (postfixFlag == FALSE) && (syncDetectBit(&sync, bitSoft) != FALSE)){ 
+        syncDetectReset(&sync);
+        syncTicks = 0;
+        if(reported == TRUE){
+            overTimeCount = 0; // a copy of the reported message, only wait it out
+            return;
+        }
+        // Copies of another message must not be added to this one's
+        if((combiner.copies > 0) && (overTimeCount > COPY_SYNC_TICKS)){
+            reportResult();
+            transmissions = 0;
+            dataReset();
+        }
+        overTimeCount = 0; // still hearing the transmitter
+        dataCount = 0;
+        data = 0;
+        rateCount = 0;
+        rateSoft[0] = 0;
+        rateSoft[1] = 0;
+        dataFlag = TRUE; //Start looking for data
+        lcdFlagEncode = TRUE; //Display pre-fix on lcd
+    
+    //The rate field says how fast the frame after it comes
+    }else if((dataFlag == TRUE) && (rateCount < LINK_RATE_FIELD_SYMBOLS)){
+        rateSoft[rateCount % LINK_RATE_BITS] += bitSoft;
+        rateCount++;
+        dataCount = 0;
+        data = 0;
+        if(rateCount >= LINK_RATE_FIELD_SYMBOLS){
+            frameRate = ((rateSoft[0] > 0) ? 0x02 : 0x00) | ((rateSoft[1] > 0) ? 0x01 : 0x00);
+            if(frameRate >= LINK_RATES){
+                frameRate = LINK_RATES - 1u;
+            }
+            symbolTimingSetNominal(&timing, COUNT / LINK_RATE_DIVISOR(frameRate));
+        }
+    
+    //Keep the soft values of the coded data for the decoder
+    }else if((dataFlag == TRUE) && (postfixFlag == FALSE)){
+        codeSoft[dataCount - 1] = bitSoft;
+    }
+    
+    //Decode each frame byte once its FEC_CODED_BITS are in
+    if((dataFlag == TRUE) && (postfixFlag == FALSE) && (dataCount >= FEC_CODED_BITS)){
+        // Add this copy's byte to the earlier ones and decode them all
+        uint8 byte = combinerAddByte(&combiner, frameIndex, codeSoft);
+        if(frameIndex == 0){
+            // The length byte says how many follow
+            if(byte > PACKET_MAX_PAYLOAD){
+                byte = PACKET_MAX_PAYLOAD;
+            }
+            frameBytes = PACKET_FRAME_BYTES(byte);
+        }
+        frameIndex++;
+        overTimeCount = 0;
+        data = 0; //Restart data for decode
+        dataCount = 0; 
+        
+        // Whole frame in, check it
+        if(frameIndex >= frameBytes){
+            confident = combinerAddCopy(&combiner, frameBytes, &message);
+            crabs = INVALID;
+            if((combiner.checked != FALSE) && (reportFromPacket(&message, &report) != FALSE)){
+                crabs = report.crabs;
+            }
+            frameIndex = 0;
+            symbolTimingSetNominal(&timing, COUNT); // post-fix is at the base rate
+            lcdFlagEncode = FALSE; //Turn off pre-fix message
+            lcdFlagData = TRUE; //Display data
+            postfixFlag = TRUE;
+        }
+    }
+    
+    // Check for 8 bits of post-fix
+    if(postfixFlag == TRUE && (dataCount > DATA_LENGTH)){
+        // Correct postfix is 0x01
+        if(data == POSTFIX){
+            lcdFlagPostfix = TRUE; // lcd flag for "good" post-fix
+        }else{
+            lcdFlagPostfix = FALSE; // lcd flag for "bad" post-fix
+        }
+        postfixDone = TRUE;
+        //dataFlag = FALSE; //Don't want to check for data anymore
+        
+        transmissions++;
+        copyTicks = syncTicks;
+        logRecord(TELEMETRY_COPY);
+        overTimeCount = 0; // the next copy gets its own time
+        // Stop once the copies decode with confidence or no more are coming
+        if((confident == TRUE) || (transmissions >= TRANSMISSIONS)){
+            resultFlag = TRUE;
+        }
+       
+    }
+} /* END OF bitReceived() */
+
 ///*********************************************************************
 // * ISR: watchDogCheck
 // * parameters: void
 // * returns: void
 // * description: Clears watchdog timer to avoid reset unless timing 
-// * has drifted
+// * has drifted. The main loop pulses sleepToggle for it.
 // *********************************************************************
 // */
 CY_ISR(watchDogCheck){
     
-    sleepToggle_Write(TRUE);
-    CyDelay(Delay); 
-    sleepToggle_Write(FALSE);
-    CyWdtClear(); 
-    
-    
+    PROFILE_ENTER(PROFILE_WDT_CHECK);
+    HAL_WdtClear(); 
+    heartbeatFlag = TRUE;
+    PROFILE_EXIT(PROFILE_WDT_CHECK);
         
 } /* END OF CY_ISR(watchDogCheck) */
 
@@ -279,51 +581,64 @@ CY_ISR(watchDogCheck){
 // * ISR: wakeUp_ISR
 // * parameters: void
 // * returns: void
-// * description: Checks for prefix and disables sleep if prefix is seen
-// * Timer is enabled to restart sleep if false positive
-// * If no prefix, disable interrupt and nothing else
+// * description: Starts a listen: restores the clocks and the front end
+// * and has Bit_Timer ask the main loop for a look every LISTEN_LOOK_MS
+// * (listenLook). The CPU idles in between.
 // *********************************************************************
 // */
 
 
 CY_ISR(wakeUp_ISR){
+    PROFILE_ENTER(PROFILE_WAKEUP);
      #ifdef SLEEP_ON   
-    CyWdtClear(); 
+    HAL_WdtClear(); 
     
-    SleepTimer_GetStatus(); // Clears the sleep timer interrupt
+    HAL_SleepTimerClear(); // Clears the sleep timer interrupt
+    uptimeMs += LISTEN_INTERVAL_MS; // near enough, the listens add a little
     
-    wakeUpModules(); 
-   
-    /*  If data detected DO NOT SLEEP
-    *   Stop sleep timer
-    *   Enable Bit_Timer to start clocking data
-    *   Trigger the data timing ISR (Data_ISR)
-    */ 
-    if(Out_Comp_GetCompare() != 0){
-        SleepTimer_Stop();
-        LCD_Char_ClearDisplay(); 
-        sprintf(display, "counting crabs...");
-        LCD_Display(); 
-        Bit_Timer_Start();
-        //trigger interrupt to avoid data loss 
-        Data_ISR_SetPending();
-    }else{
-        
-        sleepFlag = TRUE; 
-        
-    }
+    listenWakeup(); 
+    looks = 0;
+#ifdef DEMOD_GOERTZEL
+    lookLevel = 0;
+    lookSoft = 0;
+#endif
+    listening = TRUE;
+    HAL_TimerStart(HAL_TIMER_BIT);
     
     #endif
+    PROFILE_EXIT(PROFILE_WAKEUP);
 
 }/* END OF wakeUp_ISR */
 
+///*********************************************************************
+// * ISR: hostWake
+// * parameters: void
+// * returns: void
+// * description: Activity on the UART's RX pin: a host is attached and
+// * wants the telemetry. Wakes the PSoC if it was asleep, the main loop
+// * then sends the ring and goes straight back to sleep.
+// *********************************************************************
+// */
+CY_ISR(hostWake){
+    
+    PROFILE_ENTER(PROFILE_HOST_WAKE);
+    HAL_IsrClearPending(HAL_IRQ_UART_WAKE);
+    hostFlag = TRUE;
+    if((awake == FALSE) && (listening == FALSE)){
+        quietFlag = TRUE;
+    }
+    PROFILE_EXIT(PROFILE_HOST_WAKE);
+    
+}/* END OF hostWake */
+
 
 ///*********************************************************************
 // * function: void Display(void)
 // * parameters: void
 // * returns: void
-// * description: Displays current data on LCD display depending
-// * on what flags are set
+// * description: Queues what the LCD should show depending on what
+// * flags are set. Called from Bit_Timer, so it never touches the LCD;
+// * showEvent() does that from the main loop.
 // *********************************************************************
 // */
 void Display()
@@ -331,127 +646,270 @@ void Display()
     // LCD Screen Messages
     // If encode is received, display message
     if(lcdFlagEncode == TRUE){
-        LCD_Char_ClearDisplay();
-        LCD_Char_PrintString("0xFF pre-fix");
+        eventQueuePut(&displayEvents, EVENT_SYNC, 0, 0);
         lcdFlagEncode = FALSE; 
-    // When 9 bits are received, data will display at top of screen
+    // When the coded data is decoded, data will display at top of screen
     }else if(lcdFlagData == TRUE){
-        parityResult[threeTransmissions - 1 ] = CheckParity(crabs);
-        crabs = crabs >> 1;
-        allData[threeTransmissions - 1] = crabs; 
-        sprintf(OutputString, "Crabs:%i Err:%i",crabs, !paritySuccess);
-        LCD_Char_ClearDisplay();
-        LCD_Char_Position(0u,0u);
-        LCD_Char_PrintString(OutputString);
+        eventQueuePut(&displayEvents, EVENT_DATA, combiner.corrected, crabs);
         dataFlag = FALSE;
         lcdFlagData = FALSE;
-    // Postfix will display good or bad below data on screen
-    }else if(postfixFlag == TRUE && lcdFlagPostfix == TRUE){
-        LCD_Char_Position(1u,0u);
-        char8 displayG[] = "good";
-        LCD_Char_PrintString(displayG);
+    // Postfix will display good or bad below data on screen, once it is in
+    }else if(postfixDone == TRUE && lcdFlagPostfix == TRUE){
+        eventQueuePut(&displayEvents, EVENT_POSTFIX, TRUE, 0);
         dataFlag = FALSE;
         lcdFlagPostfix = FALSE;
         postfixFlag = FALSE;
-    }else if(postfixFlag == TRUE && lcdFlagPostfix == FALSE){
-        LCD_Char_Position(1u,0u);
-        char8 displayB[] = "bad";
-        LCD_Char_PrintString(displayB);
-        CyDelay(200);
+        postfixDone = FALSE;
+    }else if(postfixDone == TRUE && lcdFlagPostfix == FALSE){
+        eventQueuePut(&displayEvents, EVENT_POSTFIX, FALSE, 0);
         dataFlag = FALSE;
         postfixFlag = FALSE;
+        postfixDone = FALSE;
     }
 } /* END OF Display() */
 
-///********************************************************************
-// * function: void CheckParity(void)
-// * parameters: int received data including parity
-// * returns: int whether 
-// * description: XORs each bit of data to get even or odd parity for
-// * error checking
-// ********************************************************************
+///*********************************************************************
+// * function: void showEvent(const event *shown)
+// * parameters: shown - event queued by Display()
+// * returns: void
+// * description: Puts a queued event on the LCD. Main loop only.
+// *********************************************************************
 // */
-int CheckParity(int crabs)
+void showEvent(const event *shown)
 {
-    int i = 0;
-    int bitToCheck = crabs >> 1; // Remove parity from data
-    int receivedParity = (crabs & BIT_0_MASK); //Save parity from data received
-    int parity = bitToCheck & BIT_0_MASK; // Get first bit of data to XOR
-    for(i = 0; i < DATA_LENGTH; i++){
-        bitToCheck = bitToCheck >> 1; // shift mask over
-        parity = (bitToCheck & BIT_0_MASK) ^ parity; // XOR new bit
+    switch(shown->type){
+        case EVENT_SYNC:
+            HAL_LcdClear();
+            HAL_LcdPrintString("sync found");
+            break;
+        // Data at top of screen
+        case EVENT_DATA:
+            if(shown->value == INVALID){
+                sprintf(OutputString, "CRC bad Err:%i", shown->flag);
+            }else{
+                sprintf(OutputString, "Crabs:%i Err:%i", shown->value, shown->flag);
+            }
+            HAL_LcdClear();
+            HAL_LcdPosition(0u,0u);
+            HAL_LcdPrintString(OutputString);
+            break;
+        // Postfix good or bad below data
+        case EVENT_POSTFIX:
+            HAL_LcdPosition(1u,0u);
+            HAL_LcdPrintString((shown->flag == TRUE) ? "good" : "bad");
+            break;
+        case EVENT_TRAP:
+            shownTrap = (uint8)shown->value;
+            break;
+        case EVENT_RESULT:
+            dataTransmission(shown->value, shown->flag);
+            break;
+        // What else the report had, below the result
+        case EVENT_MINUTES:
+            sprintf(OutputString, "%um", (uint16)shown->value);
+            HAL_LcdPosition(1u,0u);
+            HAL_LcdPrintString(OutputString);
+            break;
+        case EVENT_BATTERY:
+            sprintf(OutputString, "%d.%dV", shown->value / 10, shown->value % 10);
+            HAL_LcdPosition(1u,10u);
+            HAL_LcdPrintString(OutputString);
+            break;
+        // Rate the result came at, and the one to change to
+        case EVENT_RATE:
+            if(shown->value == shown->flag){
+                sprintf(OutputString, "r%d", shown->flag);
+            }else{
+                sprintf(OutputString, "r%d>%d", shown->flag, shown->value);
+                HAL_UartPutChar(LINK_RATE_COMMAND | (uint8)shown->value);
+            }
+            HAL_LcdPosition(1u,15u);
+            HAL_LcdPrintString(OutputString);
+            break;
+        default:
+            break;
     }
-    if(parity == receivedParity){
-        return SUCCESS;
-    }else{
-        return FAILURE;
+} /* END OF showEvent() */
+
+///*******************************************************************
+// * function: void sendTelemetry(void)
+// * parameters: void
+// * returns: void
+// * description: Sends the telemetry records not sent yet through UART,
+// * one frame each. Wakes the UART for them if the module is asleep.
+// * Main loop only.
+// *******************************************************************
+//*/
+void sendTelemetry(void)
+{
+    telemetryRecord record;
+    uint8 frame[TELEMETRY_MAX_FRAME];
+    uint8 bytes;
+    uint8 n;
+    uint8 wokeUart = FALSE;
+    
+    while(telemetryGet(&telemetry, &record) != FALSE){
+        if((awake == FALSE) && (wokeUart == FALSE)){
+            HAL_RestoreClocks();
+            HAL_UartWakeup();
+            wokeUart = TRUE;
+        }
+        bytes = telemetryFrame(&record, frame);
+        for(n = 0; n < bytes; n++){
+            HAL_UartPutChar(frame[n]);
+        }
+    }
+    if((wokeUart == TRUE) && (awake == FALSE)){ // unless a signal woke everything meanwhile
+        HAL_UartSleep();
+        HAL_SaveClocks();
     }
-} /* END OF CheckParity() */
+} /* END OF sendTelemetry() */
 
+#ifdef PROFILE_ON
 ///*******************************************************************
-// * function: void SendData(void)
+// * function: void sendProfile(void)
 // * parameters: void
 // * returns: void
-// * description: Sends received data through UART 
-// * Order sent is: 1 byte: Data
-// *                1 bit : Success/Failure
+// * description: Now and then sends the profile.h statistics to the
+// * host, like the telemetry. Main loop only.
 // *******************************************************************
 //*/
-void SendData(void)
+void sendProfile(void)
 {
-    UART_WriteTxData(crabs);
-    if((paritySuccess == SUCCESS) && (lcdFlagPostfix == FALSE)){
-        UART_WriteTxData(SUCCESS);
-    }else{
-        UART_WriteTxData(FAILURE);
+    uint8 wokeUart = FALSE;
+    
+    if(profileDue() == FALSE){
+        return;
+    }
+    if(awake == FALSE){
+        HAL_RestoreClocks();
+        HAL_UartWakeup();
+        wokeUart = TRUE;
+    }
+    profileDump(profileFrame);
+    if((wokeUart == TRUE) && (awake == FALSE)){
+        HAL_UartSleep();
+        HAL_SaveClocks();
+    }
+} /* END OF sendProfile() */
+
+///*******************************************************************
+// * function: void profileFrame(const char8 *line)
+// * parameters: line - one line of the profile
+// * returns: void
+// * description: Sends the line as text between two TELEMETRY_END
+// * bytes; it is no record, and logdump prints it as it is.
+// *******************************************************************
+//*/
+void profileFrame(const char8 *line)
+{
+    HAL_UartPutChar(TELEMETRY_END);
+    while(*line != '\0'){
+        HAL_UartPutChar((uint8)*line++);
+    }
+    HAL_UartPutChar(TELEMETRY_END);
+} /* END OF profileFrame() */
+#endif
+
+///*******************************************************************
+// * function: void logRecord(uint8 type)
+// * parameters: type - TELEMETRY_COPY, _RESULT or _TIMEOUT
+// * returns: void
+// * description: Puts what the receiver knows now in the telemetry
+// * ring. Bit_Timer only.
+// *******************************************************************
+//*/
+void logRecord(uint8 type)
+{
+    telemetryRecord record;
+    
+    record.type = type;
+    record.flags = 0;
+    if(combiner.checked != FALSE){
+        record.flags |= TELEMETRY_CRC_OK;
+    }
+    if((type == TELEMETRY_COPY) && (data == POSTFIX)){
+        record.flags |= TELEMETRY_POSTFIX_OK;
+    }
+    if(confident == TRUE){
+        record.flags |= TELEMETRY_CONFIDENT;
     }
-} /* END OF SendData() */
+    record.time = uptimeMs;
+    record.rate = frameRate;
+    record.suggested = quality.suggested;
+    record.copies = combiner.copies;
+    record.corrected = combiner.corrected;
+    record.postfix = (uint8)data;
+    record.trapId = (combiner.checked != FALSE) ? report.trapId : 0;
+    record.margin = combiner.margin;
+    record.crabs = crabs;
+    record.rateSoft[0] = rateSoft[0];
+    record.rateSoft[1] = rateSoft[1];
+    record.timingError = (int8)timing.lastError;
+    telemetryPut(&telemetry, &record);
+} /* END OF logRecord() */
 
 void sleepModules(void){
-    LCD_Char_Sleep();
-    UART_Sleep();
-    PWM_Recon_Sleep();
-    Shift_Reg_Sleep();
-    Out_Comp_Sleep();
-    Bit_Timer_Sleep();
-    checkWatchDogTimer_Sleep();
-    CyPmSaveClocks();
-    Power_Toggle_Write(FALSE);
+    HAL_LcdSleep();
+    HAL_UartSleep();
+    HAL_TimerSleep(HAL_TIMER_WDT_CHECK);
+    listenSleep();
+    HAL_PinWrite(HAL_PIN_POWER, FALSE);
 
 }
 
+/*  Everything listenWakeup() leaves asleep, 
+*   once a transmission is heard
+*/
 void wakeUpModules(void){
-    checkWatchDogTimer_Wakeup();
-    checkWatchDogTimer_Start();
-    CyPmRestoreClocks();
-    LCD_Char_Wakeup();
-    UART_Wakeup();
-    PWM_Recon_Wakeup();
-    Shift_Reg_Wakeup();
-    Out_Comp_Wakeup();
+    HAL_TimerWakeup(HAL_TIMER_WDT_CHECK);
+    HAL_TimerStart(HAL_TIMER_WDT_CHECK);
+    HAL_LcdWakeup();
+    HAL_UartWakeup();
+}
+
+// Just the clocks and the front end, to listen on every wakeup
+void listenWakeup(void){
+    HAL_RestoreClocks();
+    HAL_FrontEndWakeup();
+}
+
+// And Bit_Timer, which timed the looks
+void listenSleep(void){
+    HAL_TimerSleep(HAL_TIMER_BIT);
+    HAL_FrontEndSleep();
+    HAL_SaveClocks();
 }
 
 void startModules(void){
     
-    LCD_Char_Start();
-    UART_Start();
-    PWM_Recon_Start();
-    Shift_Reg_Start();
-    Out_Comp_Start();
+    HAL_LcdStart();
+    HAL_UartStart();
+    HAL_FrontEndStart();
     // Start timer to clear watch dog
-    checkWatchDogTimer_Start();
+    HAL_TimerStart(HAL_TIMER_WDT_CHECK);
+#ifdef DEMOD_GOERTZEL
+    fskDemodInit(&demod, HAL_ADC_SAMPLE_RATE);
+#endif
+    symbolTimingInit(&timing, COUNT);
+    combinerReset(&combiner);
+    linkQualityReset(&quality);
+    eventQueueInit(&displayEvents);
+    telemetryInit(&telemetry);
+    syncDetectInit(&sync, SYNC_THRESHOLD);
     
-    Data_ISR_StartEx(Bit_Timer);
-    Sleep_ISR_StartEx(wakeUp_ISR);
-    watchDogCheck_StartEx(watchDogCheck); 
-    Power_Toggle_Write(TRUE);
+    HAL_IsrStart(HAL_IRQ_BIT_TIMER, Bit_Timer);
+    HAL_IsrStart(HAL_IRQ_SLEEP, wakeUp_ISR);
+    HAL_IsrStart(HAL_IRQ_WDT_CHECK, watchDogCheck); 
+    HAL_IsrStart(HAL_IRQ_UART_WAKE, hostWake);
+    HAL_PinWrite(HAL_PIN_POWER, TRUE);
 
 }
 
 void LCD_Display(void){
   
-    LCD_Char_Position(0u,0u); // Resets cursor to top of LCD Screen
-    LCD_Char_PrintString(display);
+    HAL_LcdPosition(0u,0u); // Resets cursor to top of LCD Screen
+    HAL_LcdPrintString(display);
 
 } 
 /*  Check out of 100 bits, how many are 1'a
@@ -464,12 +922,12 @@ void accuracy_Check(int count, int accuracy){
     if(count >= accuracy){ // 1 bit must be Accuracy/100 = 1 
         currentBit = 0x01;
         oneCount = 0;
-        Count_Out_Write(1);
+        HAL_PinWrite(HAL_PIN_COUNT_OUT, 1);
 
     }else{ // if oneCount <= PREFIX_ACCURACY, bit is 0
         currentBit = 0x00; 
         zeroCount = 0; 
-        Count_Out_Write(0);
+        HAL_PinWrite(HAL_PIN_COUNT_OUT, 0);
 
 
     }
@@ -478,197 +936,135 @@ void accuracy_Check(int count, int accuracy){
 
 void dataReset(void){
 
-    int i;
-    for(i = 0; i <= TRANSMISSIONS_3; i++){
-        parityResult[i] = INVALID; 
-        postFixResult[i] = INVALID;
-        allData[i] = INVALID;
-    
-    }
+    combinerReset(&combiner);
+    confident = FALSE;
+    frameIndex = 0;
     crabs = INVALID; 
+    symbolTimingSetNominal(&timing, COUNT); // in case a frame was cut off
 
 }
 
-void dataTransmission(void){
-    uint8 finalData = majorityVote();
-    sprintf(display,"crabs:%d",finalData);
+/*  Final result of the copies combined, 
+*   on the LCD and, if the packet checked out, out the UART
+*/
+void dataTransmission(int16 finalData, uint8 copies){
+    HAL_LcdClear();
+    if(finalData == INVALID){
+        sprintf(display,"no packet copies:%d", copies);
+        LCD_Display(); 
+        return;
+    }
+    sprintf(display,"T%d crabs:%d x%d", shownTrap, (uint8)finalData, copies);
     LCD_Display(); 
-    UART_WriteTxData(finalData); 
+    HAL_UartPutChar((uint8)finalData); 
     
 
 }
 
-uint8 majorityVote(void){
-    int i = 0;
-    int paritySuccess = 0;
-    int postSuccess = 0; 
-    uint8 finalResult = 0;
-    int majorityFlag = FALSE;
-    int correctParities[DATA_STORED];
-    int correctPosts[DATA_STORED];
-    
-    for(i = 0; i<DATA_STORED; i++){
-        if(parityResult[i] == SUCCESS){
-           correctParities[paritySuccess] = i;  
-           paritySuccess++;
+/*  Queues the combined result for the main loop, 
+*   with whatever fields the crab report had and the rate 
+*   to suggest from how well it came in. Bit_Timer only.
+*/
+void reportResult(void){
+    int16 margin = 0;
+    uint8 suggested;
+
+    if(combiner.checked == FALSE){
+        eventQueuePut(&displayEvents, EVENT_RESULT, combiner.copies, INVALID);
+    }else{
+        eventQueuePut(&displayEvents, EVENT_TRAP, 0, report.trapId);
+        eventQueuePut(&displayEvents, EVENT_RESULT, combiner.copies, report.crabs);
+        if(report.minutes != REPORT_NO_TIME){
+            eventQueuePut(&displayEvents, EVENT_MINUTES, 0, (int16)report.minutes);
         }
-        if(postFixResult[i] == SUCCESS){
-           correctPosts[postSuccess] = i;
-           postSuccess++;
-        }        
-    }
-    
-    switch (paritySuccess) {
-    
-        case 0:
-            switch (postSuccess){
-                case 0:
-                    finalResult = INVALID; 
-                    break;
-                case 1:
-                    finalResult = allData[correctPosts[0]];
-                    break;
-                case 2:
-                    if(allData[correctPosts[0]] == allData[correctPosts[1]]){
-                        finalResult = allData[correctPosts[0]]; 
-                    } else{
-                        finalResult = INVALID; 
-                    } 
-                    break;
-                case 3:
-                    majorityFlag = TRUE; 
-                    break;
-                default:
-                    break; 
-            }
-            break;
-        case 1:
-            switch (postSuccess){
-                case 0:
-                    finalResult = INVALID; 
-                    break;
-                case 1:
-                    if(correctPosts[0] == correctParities[0]){
-                        finalResult = allData[correctPosts[0]];
-                    }else{
-                        finalResult = INVALID;
-                    }
-                    break;
-                case 2:
-                    if(correctPosts[0] == correctParities[0]){
-                        finalResult = allData[correctPosts[0]];
-                    }else if(correctPosts[1] == correctParities[0]){
-                        finalResult = allData[correctPosts[1]];
-                    } else {
-                        finalResult = INVALID;
-                    }
-                    break;
-                case 3:
-                    majorityFlag = TRUE; 
-                    break;
-                default:
-                    break; 
-            }            
-            break;
-        case 2:
-            switch (postSuccess){
-                case 0:
-                    if(allData[correctParities[0]] == allData[correctParities[1]]){
-                        finalResult = allData[correctParities[0]];
-                    }else{
-                         finalResult = INVALID;
-                    }
-                    break;
-                case 1:
-                    if(correctPosts[0] == correctParities[0]){
-                        finalResult = allData[correctParities[0]];
-                    }else if (correctPosts[0] == correctParities[1]){
-                        finalResult = allData[correctParities[1]];
-                    }else {
-                        finalResult = INVALID;
-                    }
-                   
-                    break;
-                case 2:
-                    if(correctPosts[0] == correctParities[0]){
-                        finalResult = allData[correctParities[0]];
-                    }else if (correctPosts[0] == correctParities[1]){
-                        finalResult = allData[correctParities[1]];
-                    }else if(correctPosts[1] == correctParities[0]) {
-                        finalResult = allData[correctParities[0]];
-                    }else if(correctPosts[1] == correctParities[1]) {
-                        finalResult = allData[correctParities[1]];
-                    }
-                    
-                    else{
-                        finalResult = INVALID;
-                    }
-                    
-                    break;
-                case 3:
-                    majorityFlag = TRUE; 
-                    break;
-                default:
-                    break; 
-            }
-            
-            break;
-        case 3: //all good parities
-            switch (postSuccess){
-                case 0:
-                    majorityFlag = TRUE;
-                    break;
-                case 1:
-                    finalResult = allData[correctPosts[0]]; 
-                    break;
-                case 2:
-                    if(allData[correctPosts[0]] == allData[correctPosts[1]]){
-                        finalResult = allData[correctPosts[0]]; 
-                    } else{
-                        finalResult = INVALID; 
-                    }        
-                    break;
-                case 3:
-                    majorityFlag = TRUE;
-                    break;
-                default:
-                    
-                    break; 
-            }
-            
-            break; 
-        default:
-            break;
-    
+        if(report.battery != REPORT_NO_BATTERY){
+            eventQueuePut(&displayEvents, EVENT_BATTERY, 0, report.battery);
+        }
+        margin = combiner.margin / combiner.copies;
     }
-    
-    if(majorityFlag == TRUE){
-        
-        int bit1;  
-        int j; 
-        int majorityResult = 0; 
-        
-        for(i = 0; i < BYTE; i++){
-            for (j = 0; j < DATA_STORED; j++){
-                bit1 = allData[j] & (BIT_0_MASK << i);
-                bit1 = bit1 >> i; 
-                majorityResult += bit1;
-            }
-            
-            if(majorityResult > 1){
-                finalResult = finalResult | (BIT_0_MASK << i);
-            }
+    suggested = linkQualityFrame(&quality, frameRate, combiner.checked, margin);
+    eventQueuePut(&displayEvents, EVENT_RATE, frameRate, suggested);
+    logRecord(TELEMETRY_RESULT);
+}
 
-        }
-        
-    }   
- 
-        
-       
-    
-    
-    return finalResult;
+/*
+ * function: uint8 signalLook(void)
+ * parameters: void
+ * returns: LOOK_HEARD if a transmission seems to be starting, LOOK_QUIET
+ * if not, LOOK_MORE until the last look
+ * description: One look with only the front end on, a DEMOD_BLOCK of
+ * samples from since the last one. The prefix starts with 5 ones, so look
+ * for the mark tone LISTEN_LOOKS times. The tone level and soft value are
+ * averaged over the looks, which steadies them against noise better than
+ * one longer look would against a burst of it. Silence is given up on
+ * after the first look. The comparator has no level, every look must see
+ * the mark.
+ */
+uint8 signalLook(void){
+#ifdef DEMOD_GOERTZEL
+    fskResult block;
+
+    HAL_AdcRead(adcBlock, DEMOD_BLOCK);
+    fskDemodBlock(&demod, adcBlock, DEMOD_BLOCK, &block);
+    if((looks == 0) && (block.level < LISTEN_QUIET_LEVEL)){
+        return LOOK_QUIET;
+    }
+    lookLevel += block.level;
+    lookSoft += block.soft;
+#else
+    if(HAL_CompRead() == 0){
+        return LOOK_QUIET;
+    }
+#endif
+    looks++;
+    if(looks < LISTEN_LOOKS){
+        return LOOK_MORE;
+    }
+#ifdef DEMOD_GOERTZEL
+    if((lookLevel < DEMOD_DETECT_LEVEL * LISTEN_LOOKS) || (lookSoft <= 0)){
+        return LOOK_QUIET;
+    }
+#endif
+    return LOOK_HEARD;
 }
 
+/*
+ * function: void listenLook(void)
+ * parameters: void
+ * returns: void
+ * description: Takes a look when Bit_Timer asks for one during a listen.
+ * If the transmission is heard, wakes everything else up, stops the sleep
+ * timer and turns Bit_Timer over to the bits, the first starting now.
+ * If not, the front end goes back to sleep and nothing else. Main loop only.
+ */
+void listenLook(void){
+    uint8 heard = signalLook();
+
+    HAL_WdtClear(); // listening took part of its time
+    if(heard == LOOK_MORE){
+        return;
+    }
+    if(heard == LOOK_QUIET){
+        listening = FALSE;
+        listenSleep();
+        quietFlag = TRUE;
+        return;
+    }
+    wakeUpModules();
+    awake = TRUE;
+    HAL_SleepTimerStop();
+    listenFlag = TRUE;
+    symbolTimingReset(&timing);
+#ifdef DEMOD_GOERTZEL
+    fskSymbolReset(&symbolTones);
+#endif
+    syncDetectReset(&sync);
+    levelCounter = 0;
+    oneCount = 0;
+    zeroCount = 0;
+    listening = FALSE;
+    //trigger interrupt to avoid data loss 
+    HAL_IsrSetPending(HAL_IRQ_BIT_TIMER);
+}
 
 /* [] END OF FILE */
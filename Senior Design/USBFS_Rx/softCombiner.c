@@ -0,0 +1,97 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Soft Combiner
+ * Function: Equal-gain combining of repeated messages. Each bit's soft value
+ * already grows with its signal quality, so a plain sum weights the better
+ * copies most.
+ * =============================================================================
+*/
+
+#include <stdint.h>
+#include "softCombiner.h"
+
+/*  A decode is trusted once every byte's best codeword leads the next by
+*   this much and the frame's CRC matches.
+*   A clean bit is worth FSK_SOFT_MAX (127) and the closest codewords differ
+*   in 3 bits, so one clean copy leads by 6 * 127. Soft values shrink with
+*   the signal's share of the energy: one copy leads by about 370 at 0 dB,
+*   170 at -5 dB and 50 at -10 dB, so this takes one copy down to about
+*   0 dB and two at -5 dB, and combines all of them below that.
+*/
+#define COMBINE_MARGIN      192
+
+// Forget all copies, for a new message
+void combinerReset(softCombiner *combiner){
+    uint8 n, bit;
+
+    for(n = 0; n < PACKET_MAX_FRAME; n++){
+        for(bit = 0; bit < FEC_CODED_BITS; bit++){
+            combiner->sum[n][bit] = 0;
+        }
+        combiner->frame[n] = 0;
+    }
+    combiner->copies = 0;
+    combiner->checked = 0;
+    combiner->corrected = 0;
+    combiner->margin = 0;
+}
+
+/*
+ * function: uint8 combinerAddByte(softCombiner *combiner, uint8 index, const int8 *soft)
+ * parameters: combiner - state
+ *             index - the byte's place in the frame
+ *             soft - FEC_CODED_BITS soft values of it in this copy
+ * returns: the decode of the byte over all copies so far
+ * description: The receiver needs the length byte before it knows how many
+ * more to read, so bytes are added as they come in.
+ */
+uint8 combinerAddByte(softCombiner *combiner, uint8 index, const int8 *soft){
+    uint8 corrected;
+    int16 margin;
+    uint8 bit;
+
+    if(index >= PACKET_MAX_FRAME){
+        return 0;
+    }
+    for(bit = 0; bit < FEC_CODED_BITS; bit++){
+        combiner->sum[index][bit] += soft[bit];
+    }
+    combiner->frame[index] = fecDecode(combiner->sum[index], &corrected, &margin);
+    return combiner->frame[index];
+}
+
+/*
+ * function: uint8 combinerAddCopy(softCombiner *combiner, uint8 bytes, packet *message)
+ * parameters: combiner - state, with this copy's bytes added
+ *             bytes - frame length of this copy
+ *             message - filled with the payload if the frame checks out
+ * returns: TRUE once the copies so far decode with confidence
+ * description: Counts the copy and checks the combined frame. Corrected and
+ * margin are over the whole frame, checked says whether the CRC matched.
+ */
+uint8 combinerAddCopy(softCombiner *combiner, uint8 bytes, packet *message){
+    uint8 corrected;
+    int16 margin;
+    uint8 n;
+
+    if(bytes > PACKET_MAX_FRAME){
+        bytes = PACKET_MAX_FRAME;
+    }
+    combiner->copies++;
+    combiner->corrected = 0;
+    combiner->margin = INT16_MAX;
+    for(n = 0; n < bytes; n++){
+        combiner->frame[n] = fecDecode(combiner->sum[n], &corrected, &margin);
+        combiner->corrected += corrected;
+        if(margin < combiner->margin){
+            combiner->margin = margin;
+        }
+    }
+    combiner->checked = packetCheck(combiner->frame, message);
+    if(combiner->checked == 0){
+        return 0;
+    }
+    return combiner->margin >= COMBINE_MARGIN;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,34 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Soft Combiner
+ * Function: Adds up the soft values of the coded frame bytes over every
+ * copy of a message the transmitter repeats, and decodes the sums. A bit
+ * that came through weak in one copy is carried by the others, and the
+ * decode gets more certain with each copy, so listening can stop as soon as
+ * it is certain enough instead of after a fixed number of copies.
+ * =============================================================================
+*/
+
+#ifndef SOFT_COMBINER_H
+#define SOFT_COMBINER_H
+
+#include "project.h"
+#include "fec.h"
+#include "packet.h"
+
+typedef struct{
+    int16 sum[PACKET_MAX_FRAME][FEC_CODED_BITS]; // soft values summed over the copies
+    uint8 frame[PACKET_MAX_FRAME];  // decode of the sums
+    uint8 copies;                   // copies added since the last reset
+    uint8 checked;                  // the last frame decode's CRC matched
+    uint8 corrected;                // bits the FEC overruled in the last frame decode
+    int16 margin;                   // weakest byte's lead over its next best decode
+}softCombiner;
+
+void combinerReset(softCombiner *combiner);
+uint8 combinerAddByte(softCombiner *combiner, uint8 index, const int8 *soft);
+uint8 combinerAddCopy(softCombiner *combiner, uint8 bytes, packet *message);
+
+#endif /* SOFT_COMBINER_H */
+
+/* [] END OF FILE */
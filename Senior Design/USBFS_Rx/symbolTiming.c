@@ -0,0 +1,226 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Symbol Timing Recovery
+ * Function: Early/late gate with a proportional-integral loop filter. The
+ * integral part learns the clock difference between the two PSoCs, the
+ * proportional part takes out the start-phase offset.
+ * =============================================================================
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "symbolTiming.h"
+
+#define TIMING_FRAC         16  // loop works in 1/16 tick
+#define TIMING_KP_SHIFT     0   // proportional gain 1, the estimate is exact
+#define TIMING_KI_SHIFT     6   // integral gain 1/64, transitions are few
+#define TIMING_MAX_DIVISOR  8   // clocks never differ by more than 1/8
+#define TIMING_STEP_DIVISOR 2   // never move a symbol by more than 1/2 of its length
+#define TIMING_MIN_SOFT     2   // weaker symbols (silence) say nothing about timing
+
+void symbolTimingInit(symbolTiming *timing, uint16 nominal){
+    timing->base = nominal;
+    symbolTimingReset(timing);
+}
+
+// Back to nominal timing at the base symbol length, for a new transmission
+void symbolTimingReset(symbolTiming *timing){
+    timing->nominal = timing->base;
+    timing->length = timing->nominal;
+    timing->tick = 0;
+    timing->firstHalf = 0;
+    timing->secondHalf = 0;
+    timing->total = 0;
+    timing->lastHalf = 0;
+    timing->lastLength = timing->nominal;
+    timing->lastSoft = 0;
+    timing->adjust = 0;
+    timing->residue = 0;
+    timing->symbolSoft = 0;
+    timing->lastError = 0;
+}
+
+/*
+ * function: static int32 towards(int32 sum, int32 sign)
+ * returns: sum taken in the direction of sign's bit, negative parts cut off
+ */
+static int32 towards(int32 sum, int32 sign){
+    if(sign < 0){
+        sum = -sum;
+    }
+    return (sum > 0) ? sum : 0;
+}
+
+/*
+ * function: static uint8 isTransition(int32 last, int32 current)
+ * returns: TRUE if two symbol soft values are opposite bits of about the
+ * same strength. A symbol that is partly silence is weaker than its
+ * neighbour and would read as a timing error.
+ */
+static uint8 isTransition(int32 last, int32 current){
+    int32 lastLevel = labs(last);
+    int32 currentLevel = labs(current);
+
+    if((last < 0) == (current < 0)){
+        return 0;
+    }
+    if((lastLevel < TIMING_MIN_SOFT) || (currentLevel < TIMING_MIN_SOFT)){
+        return 0;
+    }
+    return (2 * lastLevel >= currentLevel) && (2 * currentLevel >= lastLevel);
+}
+
+/*
+ * function: static uint8 isOnset(int32 prior, int32 last, int32 current)
+ * returns: TRUE if a transmission started in the last symbol: silence
+ * before it and a clearly stronger symbol after it
+ */
+static uint8 isOnset(int32 prior, int32 last, int32 current){
+    int32 currentLevel = labs(current);
+
+    if((currentLevel < TIMING_MIN_SOFT) || (labs(prior) >= TIMING_MIN_SOFT)){
+        return 0;
+    }
+    return 4 * towards(last, current) < 3 * currentLevel;
+}
+
+/*
+ * function: static int32 transitionError(const symbolTiming *timing)
+ * returns: how late the last symbol boundary was, in 1/TIMING_FRAC ticks
+ * (negative = early)
+ * description: With half length H, a boundary late by d ticks leaves the
+ * last symbol's second half at L = (H - 2d) and the current symbol's first
+ * half at C = H (both taken towards their own bit), so
+ * d = H * (C - L) / (2 * C). An early boundary weakens C instead, and the
+ * stronger half goes in the divisor. The two half sums are brought to the
+ * same length first.
+ */
+static int32 transitionError(const symbolTiming *timing){
+    int64_t half = timing->length / 2;
+    int64_t current = towards(timing->firstHalf, timing->symbolSoft);
+    int64_t last = towards(timing->lastHalf, -timing->symbolSoft);
+    int64_t scale;
+
+    current *= timing->lastLength / 2;
+    last *= half;
+    scale = 2 * ((current > last) ? current : last);
+    if(scale == 0){
+        return 0;
+    }
+    return (int32)(((current - last) * half * TIMING_FRAC) / scale);
+}
+
+/*
+ * function: static int32 onsetError(const symbolTiming *timing, int32 last)
+ * parameters: timing - state at the end of the first full symbol,
+ *             last - soft value of the symbol before it
+ * returns: how late the boundary between them was, in 1/TIMING_FRAC ticks
+ * (negative = early)
+ * description: The last symbol holds k = N * last / current ticks of signal,
+ * all at its end. Under half a symbol it reads as silence and its end is
+ * k ticks late, over half it is the first bit and its end is N - k early.
+ */
+static int32 onsetError(const symbolTiming *timing, int32 last){
+    int32 length = timing->lastLength;
+    int32 signal = towards(last, timing->symbolSoft);
+    int32 ticks = (signal * length * TIMING_FRAC) / labs(timing->symbolSoft);
+
+    if(2 * ticks < length * TIMING_FRAC){
+        return ticks;
+    }
+    return ticks - length * TIMING_FRAC;
+}
+
+/*
+ * function: void symbolTimingSetNominal(symbolTiming *timing, uint16 nominal)
+ * parameters: timing - state at the end of a symbol
+ *             nominal - ticks per symbol from the next symbol on
+ * description: For a change of symbol rate mid-transmission. The phase
+ * correction already taken for the next symbol stays (within half of the
+ * new length), the learned clock difference is per symbol and scales with
+ * its length.
+ */
+void symbolTimingSetNominal(symbolTiming *timing, uint16 nominal){
+    int32 ticks = (int32)timing->nominal - timing->length;
+    int32 limit = nominal / TIMING_STEP_DIVISOR;
+
+    if(ticks > limit){
+        ticks = limit;
+    }else if(ticks < -limit){
+        ticks = -limit;
+    }
+    timing->adjust = (timing->adjust * nominal) / timing->nominal;
+    timing->nominal = nominal;
+    timing->length = (uint16)(nominal - ticks);
+}
+
+/*
+ * function: uint8 symbolTimingTick(symbolTiming *timing, int8 soft)
+ * parameters: timing - state, soft - soft value of this Bit_Timer tick
+ * returns: TRUE when this tick ends a symbol; its soft value is then in
+ * timing->symbolSoft
+ */
+uint8 symbolTimingTick(symbolTiming *timing, int8 soft){
+    uint16 half = timing->length / 2;
+    int32 lastSoft = timing->symbolSoft;
+    int32 priorSoft = timing->lastSoft;
+    int32 error, limit, correction, ticks;
+
+    // The middle tick of an odd length only counts toward the symbol
+    if(timing->tick < half){
+        timing->firstHalf += soft;
+    }else if(timing->tick >= timing->length - half){
+        timing->secondHalf += soft;
+    }
+    timing->total += soft;
+    timing->tick++;
+    if(timing->tick < timing->length){
+        return 0;
+    }
+
+    timing->symbolSoft = timing->total / timing->length;
+    limit = (timing->nominal * TIMING_FRAC) / TIMING_MAX_DIVISOR;
+    error = 0;
+    correction = 0;
+    if(isTransition(lastSoft, timing->symbolSoft) != 0){
+        // Mid-transmission: the integral learns the clock difference
+        error = transitionError(timing);
+        timing->adjust += error >> TIMING_KI_SHIFT;
+        if(timing->adjust > limit){
+            timing->adjust = limit;
+        }else if(timing->adjust < -limit){
+            timing->adjust = -limit;
+        }
+        correction = error >> TIMING_KP_SHIFT;
+    }else if(isOnset(priorSoft, lastSoft, timing->symbolSoft) != 0){
+        // A new transmission has its own phase, move straight to it
+        error = onsetError(timing, lastSoft);
+        correction = error;
+    }
+    timing->lastError = (int16)(error / TIMING_FRAC);
+
+    // Late means the next window has to end sooner
+    correction += timing->adjust;
+    limit = (timing->nominal * TIMING_FRAC) / TIMING_STEP_DIVISOR;
+    if(correction > limit){
+        correction = limit;
+    }else if(correction < -limit){
+        correction = -limit;
+    }
+    // Whole ticks now, the fraction keeps the average length exact
+    correction += timing->residue;
+    ticks = correction / TIMING_FRAC;
+    timing->residue = correction - ticks * TIMING_FRAC;
+
+    timing->lastSoft = lastSoft;
+    timing->lastHalf = timing->secondHalf;
+    timing->lastLength = timing->length;
+    timing->length = (uint16)(timing->nominal - ticks);
+    timing->tick = 0;
+    timing->firstHalf = 0;
+    timing->secondHalf = 0;
+    timing->total = 0;
+    return 1;
+}
+
+/* [] END OF FILE */
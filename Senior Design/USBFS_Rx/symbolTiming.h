@@ -0,0 +1,45 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Symbol Timing Recovery
+ * Function: Integrate-and-dump over the Bit_Timer ticks of one symbol, with
+ * a symbol length that follows the transmitter. Where one symbol ends and
+ * the next, opposite one begins, the soft sums of the half symbols either
+ * side of the boundary are compared (an early/late gate): the half that
+ * overlaps the neighbouring symbol comes out weaker, which says how many
+ * ticks early or late the boundary is. The next symbol is lengthened or
+ * shortened to match. Where a transmission starts out of silence, the share
+ * of signal in its first, partial symbol gives the phase directly. Runs of
+ * equal bits and silence leave the timing alone.
+ * =============================================================================
+*/
+
+#ifndef SYMBOL_TIMING_H
+#define SYMBOL_TIMING_H
+
+#include "project.h"
+
+typedef struct{
+    uint16 base;        // nominal ticks per symbol outside the frame
+    uint16 nominal;     // ticks per symbol at the transmitter's nominal rate
+    uint16 length;      // ticks in the current symbol
+    uint16 tick;        // ticks into the current symbol
+    int32 firstHalf;    // soft sums of the two halves of the current symbol
+    int32 secondHalf;
+    int32 total;        // soft sum of the current symbol
+    int32 lastHalf;     // second half soft sum of the last finished symbol
+    uint16 lastLength;  // and its length
+    int32 lastSoft;     // soft value of the symbol before the last one
+    int32 adjust;       // loop integrator, ticks * TIMING_FRAC
+    int32 residue;      // correction below one tick, carried to the next symbol
+    int32 symbolSoft;   // soft value of the last finished symbol
+    int16 lastError;    // last timing error, ticks (+ = window was late)
+}symbolTiming;
+
+void symbolTimingInit(symbolTiming *timing, uint16 nominal);
+void symbolTimingReset(symbolTiming *timing);
+void symbolTimingSetNominal(symbolTiming *timing, uint16 nominal);
+uint8 symbolTimingTick(symbolTiming *timing, int8 soft);
+
+#endif /* SYMBOL_TIMING_H */
+
+/* [] END OF FILE */
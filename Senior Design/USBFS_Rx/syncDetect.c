@@ -0,0 +1,69 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Sync Detector
+ * Function: Normalized correlation of the last SYNC_LENGTH soft bits with
+ * the sync word, in integers and without a square root.
+ * =============================================================================
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "syncDetect.h"
+
+#define SYNC_MIN_SOFT   4   // average bit soft value below which it is only noise
+
+void syncDetectInit(syncDetect *sync, uint8 threshold){
+    sync->threshold = threshold;
+    syncDetectReset(sync);
+}
+
+// Forget all bits, for a new search
+void syncDetectReset(syncDetect *sync){
+    uint8 n;
+
+    for(n = 0; n < SYNC_LENGTH; n++){
+        sync->soft[n] = 0;
+    }
+    sync->next = 0;
+}
+
+/*
+ * function: uint8 syncDetectBit(syncDetect *sync, int8 soft)
+ * parameters: sync - state, soft - soft value of the bit just decided
+ * returns: TRUE if this bit ends the sync word
+ * description: With correlation C and soft values s, the test is
+ *     C / sqrt(SYNC_LENGTH * sum(s^2)) >= threshold / 100
+ * squared. Noise alone can line up too, so the bits also have to carry
+ * some signal on average.
+ */
+uint8 syncDetectBit(syncDetect *sync, int8 soft){
+    int32 correlation = 0;
+    int32 magnitude = 0;
+    int32 power = 0;
+    uint8 index;
+    uint8 n;
+
+    sync->soft[sync->next] = soft;
+    sync->next = (uint8)((sync->next + 1u) % SYNC_LENGTH);
+
+    // Oldest bit first, against the sync word's first bit
+    index = sync->next;
+    for(n = 0; n < SYNC_LENGTH; n++){
+        if(((SYNC_WORD >> (SYNC_LENGTH - 1 - n)) & 1u) != 0u){
+            correlation += sync->soft[index];
+        }else{
+            correlation -= sync->soft[index];
+        }
+        magnitude += abs(sync->soft[index]);
+        power += sync->soft[index] * sync->soft[index];
+        index = (uint8)((index + 1u) % SYNC_LENGTH);
+    }
+
+    if((correlation <= 0) || (magnitude < SYNC_LENGTH * SYNC_MIN_SOFT)){
+        return 0;
+    }
+    return (int64_t)correlation * correlation * 100 * 100 >=
+        (int64_t)sync->threshold * sync->threshold * SYNC_LENGTH * power;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,32 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Sync Detector
+ * Function: Sliding correlator over the soft values of the last SYNC_LENGTH
+ * bits. Each bit adds its soft value where the sync word has a 1 and
+ * subtracts it where it has a 0; the sum is divided by what the same bits
+ * would give if they all matched at their RMS level, so a perfect match
+ * scores 100% whatever the signal level. Weak bits count for little, so one
+ * bad bit no longer throws away the whole preamble, while a few strong bits
+ * after silence score only sqrt(bits / SYNC_LENGTH).
+ * =============================================================================
+*/
+
+#ifndef SYNC_DETECT_H
+#define SYNC_DETECT_H
+
+#include "project.h"
+#include "syncWord.h"
+
+typedef struct{
+    int8 soft[SYNC_LENGTH]; // soft values of the last bits, oldest at next
+    uint8 next;             // where the next bit goes
+    uint8 threshold;        // correlation (percent) that counts as sync
+}syncDetect;
+
+void syncDetectInit(syncDetect *sync, uint8 threshold);
+void syncDetectReset(syncDetect *sync);
+uint8 syncDetectBit(syncDetect *sync, int8 soft);
+
+#endif /* SYNC_DETECT_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,179 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Telemetry
+ * Function: Single-producer, single-consumer ring that keeps the newest
+ * records. Bit_Timer puts, the main loop gets. The producer never waits for
+ * the consumer: a record not taken in time is overwritten, and the consumer
+ * notices from the count of records made and skips to the oldest one left.
+ * The entry being written is never one the consumer may take, and a copy
+ * the producer came round to while it was being taken is thrown away.
+ * =============================================================================
+*/
+
+#include "telemetry.h"
+#include "packet.h"
+
+#define TELEMETRY_MASK      (TELEMETRY_RECORDS - 1u)
+#define TELEMETRY_KEPT      (TELEMETRY_RECORDS - 1u) // the other one is being written
+
+// Empty the ring; only before the producing ISR is started
+void telemetryInit(telemetryLog *log){
+    log->made = 0;
+    log->sent = 0;
+}
+
+/*
+ * function: void telemetryPut(telemetryLog *log, telemetryRecord *record)
+ * parameters: log - from telemetryInit, record - gets its sequence number
+ * description: Called from the producing ISR only.
+ */
+void telemetryPut(telemetryLog *log, telemetryRecord *record){
+    uint16 made = log->made;
+
+    record->sequence = made;
+    log->entries[made & TELEMETRY_MASK] = *record;
+    log->made = (uint16)(made + 1u); // publish only once the entry is written
+}
+
+/*
+ * function: uint8 telemetryGet(telemetryLog *log, telemetryRecord *out)
+ * parameters: log - from telemetryInit, out - where the record goes
+ * returns: TRUE if a record was taken, FALSE if there are no new ones
+ * description: Called from the main loop only. Records overwritten before
+ * they were taken are skipped, out's sequence number shows the gap.
+ */
+uint8 telemetryGet(telemetryLog *log, telemetryRecord *out){
+    uint16 made;
+
+    for(;;){
+        made = log->made;
+        if(log->sent == made){
+            return 0;
+        }
+        if((uint16)(made - log->sent) > TELEMETRY_KEPT){
+            log->sent = (uint16)(made - TELEMETRY_KEPT);
+        }
+        *out = log->entries[log->sent & TELEMETRY_MASK];
+        // Still the same record, or lapped while it was copied
+        if((uint16)(log->made - log->sent) <= TELEMETRY_KEPT){
+            log->sent++;
+            return 1;
+        }
+    }
+}
+
+static uint8 *putLe(uint8 *bytes, uint32 value, uint8 count){
+    uint8 n;
+    for(n = 0; n < count; n++){
+        *bytes++ = (uint8)(value >> (8u * n));
+    }
+    return bytes;
+}
+
+static const uint8 *getLe(const uint8 *bytes, uint32 *value, uint8 count){
+    uint8 n;
+    *value = 0;
+    for(n = count; n > 0; n--){
+        *value = (*value << 8) | bytes[n - 1u];
+    }
+    return bytes + count;
+}
+
+// Puts one byte of a frame, escaped, returns where the next goes
+static uint8 *putEscaped(uint8 *frame, uint8 byte){
+    if(byte == TELEMETRY_END){
+        *frame++ = TELEMETRY_ESC;
+        *frame++ = TELEMETRY_ESC_END;
+    }else if(byte == TELEMETRY_ESC){
+        *frame++ = TELEMETRY_ESC;
+        *frame++ = TELEMETRY_ESC_ESC;
+    }else{
+        *frame++ = byte;
+    }
+    return frame;
+}
+
+/*
+ * function: uint8 telemetryFrame(const telemetryRecord *record, uint8 *frame)
+ * parameters: record - to send, frame - TELEMETRY_MAX_FRAME bytes
+ * returns: bytes in the frame
+ */
+uint8 telemetryFrame(const telemetryRecord *record, uint8 *frame){
+    uint8 payload[TELEMETRY_PAYLOAD_BYTES];
+    uint8 *next = payload;
+    uint8 *out = frame;
+    uint8 n;
+
+    next = putLe(next, record->sequence, 2);
+    next = putLe(next, record->type, 1);
+    next = putLe(next, record->flags, 1);
+    next = putLe(next, record->time, 4);
+    next = putLe(next, record->rate, 1);
+    next = putLe(next, record->suggested, 1);
+    next = putLe(next, record->copies, 1);
+    next = putLe(next, record->corrected, 1);
+    next = putLe(next, record->postfix, 1);
+    next = putLe(next, record->trapId, 1);
+    next = putLe(next, (uint16)record->margin, 2);
+    next = putLe(next, (uint16)record->crabs, 2);
+    next = putLe(next, (uint16)record->rateSoft[0], 2);
+    next = putLe(next, (uint16)record->rateSoft[1], 2);
+    putLe(next, (uint8)record->timingError, 1);
+
+    *out++ = TELEMETRY_END;
+    for(n = 0; n < TELEMETRY_PAYLOAD_BYTES; n++){
+        out = putEscaped(out, payload[n]);
+    }
+    out = putEscaped(out, packetCrc8(payload, TELEMETRY_PAYLOAD_BYTES));
+    *out++ = TELEMETRY_END;
+    return (uint8)(out - frame);
+}
+
+/*
+ * function: uint8 telemetryParse(const uint8 *payload, uint8 count, telemetryRecord *record)
+ * parameters: payload - a frame's bytes between its END bytes, unescaped,
+ *             count - how many, record - filled in
+ * returns: TRUE if it is a record and its CRC matches
+ * description: For the host side.
+ */
+uint8 telemetryParse(const uint8 *payload, uint8 count, telemetryRecord *record){
+    uint32 value;
+
+    if((count != TELEMETRY_PAYLOAD_BYTES + 1u) ||
+        (packetCrc8(payload, TELEMETRY_PAYLOAD_BYTES) != payload[TELEMETRY_PAYLOAD_BYTES])){
+        return 0;
+    }
+    payload = getLe(payload, &value, 2);
+    record->sequence = (uint16)value;
+    payload = getLe(payload, &value, 1);
+    record->type = (uint8)value;
+    payload = getLe(payload, &value, 1);
+    record->flags = (uint8)value;
+    payload = getLe(payload, &value, 4);
+    record->time = value;
+    payload = getLe(payload, &value, 1);
+    record->rate = (uint8)value;
+    payload = getLe(payload, &value, 1);
+    record->suggested = (uint8)value;
+    payload = getLe(payload, &value, 1);
+    record->copies = (uint8)value;
+    payload = getLe(payload, &value, 1);
+    record->corrected = (uint8)value;
+    payload = getLe(payload, &value, 1);
+    record->postfix = (uint8)value;
+    payload = getLe(payload, &value, 1);
+    record->trapId = (uint8)value;
+    payload = getLe(payload, &value, 2);
+    record->margin = (int16)value;
+    payload = getLe(payload, &value, 2);
+    record->crabs = (int16)value;
+    payload = getLe(payload, &value, 2);
+    record->rateSoft[0] = (int16)value;
+    payload = getLe(payload, &value, 2);
+    record->rateSoft[1] = (int16)value;
+    getLe(payload, &value, 1);
+    record->timingError = (int8)value;
+    return 1;
+}
+
+/* [] END OF FILE */
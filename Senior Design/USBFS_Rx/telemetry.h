@@ -0,0 +1,76 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Telemetry
+ * Function: A record of what the receiver made of every copy it heard,
+ * every result it reported and every wakeup that came to nothing, kept in a
+ * ring in RAM. Once a host attaches to the UART the ring goes out as binary
+ * frames, and so does every record after it.
+ *
+ * A frame is the record's TELEMETRY_PAYLOAD_BYTES (fields little-endian, in
+ * the order of telemetryRecord) and a CRC-8 over them, between two
+ * TELEMETRY_END bytes, SLIP escaped:
+ *
+ *     END | payload | CRC-8 | END
+ *
+ * END and ESC in the payload and CRC go as ESC ESC_END and ESC ESC_ESC.
+ * Crab counts and rate commands (linkRate.h) still go out as single bytes
+ * between frames; both stay below TELEMETRY_END.
+ * =============================================================================
+*/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "project.h"
+
+#define TELEMETRY_RECORDS       32u     // kept in the ring, a power of two
+#define TELEMETRY_PAYLOAD_BYTES 23u
+#define TELEMETRY_MAX_FRAME     (2u * (TELEMETRY_PAYLOAD_BYTES + 1u) + 2u) // all escaped
+
+#define TELEMETRY_END           0xC0u
+#define TELEMETRY_ESC           0xDBu
+#define TELEMETRY_ESC_END       0xDCu
+#define TELEMETRY_ESC_ESC       0xDDu
+
+// Record types
+#define TELEMETRY_COPY          1u  // a copy's frame and post-fix are in
+#define TELEMETRY_RESULT        2u  // the combined result was reported
+#define TELEMETRY_TIMEOUT       3u  // woke up, but no copy came
+
+// Record flags
+#define TELEMETRY_CRC_OK        0x01u   // the copies so far pass their CRC
+#define TELEMETRY_POSTFIX_OK    0x02u   // the post-fix was 0x01
+#define TELEMETRY_CONFIDENT     0x04u   // the copies so far decode with confidence
+
+typedef struct{
+    uint16 sequence;    // numbers every record, a gap means the ring overflowed
+    uint8 type;
+    uint8 flags;
+    uint32 time;        // ms since the receiver started
+    uint8 rate;         // frame rate the copy came at
+    uint8 suggested;    // rate suggested to the transmitter (results)
+    uint8 copies;       // combined so far
+    uint8 corrected;    // bits the FEC corrected in the copies so far
+    uint8 postfix;      // the post-fix bits as they came (copies)
+    uint8 trapId;       // results with a good packet
+    int16 margin;       // decode margin of the copies so far
+    int16 crabs;        // -1 without a good packet
+    int16 rateSoft[2];  // soft sums of the rate field's bits, + is a 1
+    int8 timingError;   // last symbol timing error, ticks (+ = late)
+}telemetryRecord;
+
+typedef struct{
+    volatile telemetryRecord entries[TELEMETRY_RECORDS];
+    volatile uint16 made;   // records put so far, ISR only
+    uint16 sent;            // records taken so far, main loop only
+}telemetryLog;
+
+void telemetryInit(telemetryLog *log);
+void telemetryPut(telemetryLog *log, telemetryRecord *record);
+uint8 telemetryGet(telemetryLog *log, telemetryRecord *out);
+uint8 telemetryFrame(const telemetryRecord *record, uint8 *frame);
+uint8 telemetryParse(const uint8 *payload, uint8 count, telemetryRecord *record);
+
+#endif /* TELEMETRY_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,260 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Transmitter HAL (PSoC 5LP)
+ * Function: Implements ../common/hal.h on top of the USBFS_Tx components.
+ * Only the calls the transmitter makes are implemented.
+ * =============================================================================
+*/
+
+#include "project.h"
+#include "hal.h"
+#include "dwtCycle.h"
+
+/* PWM_Modulator clock */
+#define CLOCK_FREQ 1000000
+#define FREQ(x) (CLOCK_FREQ/x)-1
+
+void HAL_IntEnable(void){
+    CyGlobalIntEnable;
+}
+
+void HAL_IsrStart(halIrq irq, halIsr handler){
+    switch(irq){
+        case HAL_IRQ_SYMBOL:
+            isr_sec_StartEx(handler);
+            break;
+        case HAL_IRQ_UART_RX:
+            isr_rx_StartEx(handler);
+            break;
+        case HAL_IRQ_UART_WAKE:
+            RxWakeUp_StartEx(handler);
+            break;
+        case HAL_IRQ_SLEEP:
+            Sleep_ISR_StartEx(handler);
+            break;
+        case HAL_IRQ_WDT_CHECK:
+            watchDogCheck_StartEx(handler);
+            break;
+        default:
+            break;
+    }
+}
+
+void HAL_IsrStop(halIrq irq){
+    if(irq == HAL_IRQ_UART_WAKE){
+        RxWakeUp_Stop();
+    }
+}
+
+void HAL_IsrSetPending(halIrq irq){
+    if(irq == HAL_IRQ_UART_RX){
+        isr_rx_SetPending();
+    }
+}
+
+void HAL_IsrClearPending(halIrq irq){
+    switch(irq){
+        case HAL_IRQ_SYMBOL:
+            isr_sec_ClearPending();
+            break;
+        case HAL_IRQ_UART_RX:
+            isr_rx_ClearPending();
+            break;
+        case HAL_IRQ_UART_WAKE:
+            RxWakeUp_ClearPending();
+            break;
+        case HAL_IRQ_WDT_CHECK:
+            watchDogCheck_ClearPending();
+            break;
+        default:
+            break;
+    }
+}
+
+void HAL_TimerStart(halTimer timer){
+    if(timer == HAL_TIMER_SYMBOL){
+        PWM_Switch_Timer_Start();
+    }else if(timer == HAL_TIMER_WDT_CHECK){
+        checkWatchDogTimer_Start();
+    }
+}
+
+void HAL_TimerStop(halTimer timer){
+    if(timer == HAL_TIMER_SYMBOL){
+        PWM_Switch_Timer_Stop();
+    }else if(timer == HAL_TIMER_WDT_CHECK){
+        checkWatchDogTimer_Stop();
+    }
+}
+
+void HAL_TimerSleep(halTimer timer){
+    if(timer == HAL_TIMER_SYMBOL){
+        PWM_Switch_Timer_Sleep();
+    }else if(timer == HAL_TIMER_WDT_CHECK){
+        checkWatchDogTimer_Sleep();
+    }
+}
+
+void HAL_TimerWakeup(halTimer timer){
+    if(timer == HAL_TIMER_SYMBOL){
+        PWM_Switch_Timer_Wakeup();
+    }else if(timer == HAL_TIMER_WDT_CHECK){
+        checkWatchDogTimer_Wakeup();
+    }
+}
+
+void HAL_DelayMs(uint32 ms){
+    CyDelay(ms);
+}
+
+// isr_sec plays the symbols, sleep until the next interrupt
+void HAL_Idle(void){
+    CY_PM_WFI;
+}
+
+void HAL_WdtStart(void){
+    CyWdtStart(CYWDT_1024_TICKS, CYWDT_LPMODE_NOCHANGE); // 2.048 - 3.072 s
+}
+
+void HAL_WdtClear(void){
+    CyWdtClear();
+}
+
+void HAL_SleepTimerStart(void){
+    SleepTimer_Start();
+}
+
+void HAL_SleepTimerStop(void){
+    SleepTimer_Stop();
+}
+
+void HAL_SleepTimerClear(void){
+    SleepTimer_GetStatus();
+}
+
+/*  The SleepTimer takes powers of two from 2 ms (SleepTimer__CTW_2_MS, 0)
+*   to 4096 ms (SleepTimer__CTW_4096_MS, 11), the nearest one below ms
+*/
+void HAL_SleepTimerSetInterval(uint16 ms){
+    uint8 interval = SleepTimer__CTW_2_MS;
+
+    while((interval < SleepTimer__CTW_4096_MS) && ((4u << interval) <= ms)){
+        interval++;
+    }
+    SleepTimer_SetInterval(interval);
+}
+
+void HAL_SaveClocks(void){
+    CyPmSaveClocks();
+}
+
+void HAL_RestoreClocks(void){
+    CyPmRestoreClocks();
+}
+
+// Sleep time is the SleepTimer hardware block's, or HAL_SleepTimerSetInterval()'s
+void HAL_Sleep(void){
+    CyPmSleep(PM_SLEEP_TIME_NONE, PM_SLEEP_SRC_CTW);
+}
+
+void HAL_PinWrite(halPin pin, uint8 value){
+    switch(pin){
+        case HAL_PIN_SLEEP_TOGGLE:
+            sleepToggle_Write(value);
+            break;
+        case HAL_PIN_HIGH_VOLTAGE:
+            HighVoltage_Write(value);
+            break;
+        case HAL_PIN_SIGNAL_BASE:
+            SignalBase_Write(value);
+            break;
+        default:
+            break;
+    }
+}
+
+void HAL_PwmStart(void){
+    PWM_Modulator_Start();
+}
+
+void HAL_PwmStop(void){
+    PWM_Modulator_Stop();
+}
+
+void HAL_PwmSetFrequency(uint32 hz){
+    PWM_Modulator_WritePeriod(FREQ(hz));
+    PWM_Modulator_WriteCompare((FREQ(hz))/2); // Sets pulse width
+}
+
+void HAL_PwmSleep(void){
+    PWM_Modulator_Sleep();
+}
+
+void HAL_PwmWakeup(void){
+    PWM_Modulator_Wakeup();
+}
+
+void HAL_UartStart(void){
+    UART_Start();
+}
+
+void HAL_UartSleep(void){
+    UART_Sleep();
+}
+
+void HAL_UartWakeup(void){
+    UART_Wakeup();
+}
+
+// Waits for room in the FIFO; profile lines are longer than it
+void HAL_UartPutChar(uint8 byte){
+    UART_PutChar(byte);
+}
+
+uint8 HAL_UartRxStatus(void){
+    uint8 rxStatus = UART_RXSTATUS_REG;
+    uint8 status = 0u;
+
+    if((rxStatus & UART_RX_STS_FIFO_NOTEMPTY) != 0u){
+        status |= HAL_UART_RX_NOTEMPTY;
+    }
+    if((rxStatus & UART_RX_STS_BREAK) != 0u){
+        status |= HAL_UART_RX_BREAK;
+    }
+    if((rxStatus & UART_RX_STS_PAR_ERROR) != 0u){
+        status |= HAL_UART_RX_PAR_ERROR;
+    }
+    if((rxStatus & UART_RX_STS_STOP_ERROR) != 0u){
+        status |= HAL_UART_RX_STOP_ERROR;
+    }
+    if((rxStatus & UART_RX_STS_OVERRUN) != 0u){
+        status |= HAL_UART_RX_OVERRUN;
+    }
+    return status;
+}
+
+uint8 HAL_UartGetByte(void){
+    return (uint8)UART_GetByte();
+}
+
+void HAL_LcdStart(void){
+    LCD_Start();
+}
+
+void HAL_LcdSleep(void){
+    LCD_Sleep();
+}
+
+void HAL_LcdWakeup(void){
+    LCD_Wakeup();
+}
+
+void HAL_LcdPosition(uint8 row, uint8 column){
+    LCD_Position(row, column);
+}
+
+void HAL_LcdPrintString(const char8 *text){
+    LCD_PrintString(text);
+}
+
+/* [] END OF FILE */
@@ -31,6 +31,15 @@
 #include <project.h>
 #include <stdio.h>
 #include "stdlib.h"
+#include "hal.h"
+#include "syncWord.h"
+#include "fec.h"
+#include "packet.h"
+#include "mfsk.h"
+#include "eventQueue.h"
+#include "linkRate.h"
+#include "countLink.h"
+#include "profile.h"
 
 /***************************************
 * UART/TESTING MACRO
@@ -45,14 +54,22 @@
 #define MAX_CRABS           (15)
 /* Error used for user error */
 #define ERROR               (333u)
+/* This trap's ID in its reports, unless the count came with another */
+#define TRAP_ID             (1u)
+/* Report fields sent, this trap has no battery monitor */
+#define REPORT_LENGTH       REPORT_TIMED
 
-/*Definitions*/
-#define CLOCK_FREQ 1000000
-#define FREQ(x) (CLOCK_FREQ/x)-1
-
-/*PWM Frequencies*/
-#define ONE_FREQ     42000
-#define ZERO_FREQ    37000
+/***************************************
+* UART message policy
+***************************************/
+#define TX_POLICY_NEWEST    0u  // only the newest waiting count is sent
+#define TX_POLICY_ALL       1u  // every count is sent, oldest first
+#define TX_POLICY_COALESCE  2u  // like ALL, a count equal to the one waiting before it is dropped
+#define TX_POLICY           TX_POLICY_COALESCE
+#define TX_MESSAGE          0u  // event type of a count from the UART, flag = its trap ID or 0
+#define TX_RATE             1u  // event type of a rate command, for the counts after it
+
+/*PWM Frequencies, the signal tones are in mfsk.h*/
 #define AUDIBLE_FREQ 12000
 
 #define BIT_0_MASK 0x01
@@ -73,26 +90,61 @@
 #define DATA_LENGTH       8
 #define DECODE_VALUE      0x01
 #define PREFIX_BIT_LENGTH 6
-#define PREFIX_MESSAGE    0xFF
-#define MAX_DATA_SENDING  3
+#define MAX_DATA_SENDING  3 // the receiver combines the copies and stops once it is sure
 #define MAX_SLEEP_COUNT   5
 #define FiveSecs          5000
 #define ON                1
 #define OFF               0
+#define WDT_CHECK_MS      1400 // checkWatchDogTimer period
+#define SLEEP_TIMER_MS    1024 // SleepTimer period
+#define MS_PER_MINUTE     60000u
+#define BIT_TONE(bit)     (((bit) == ONE) ? MFSK_MARK : MFSK_SPACE)
+#define TX_SILENT         0xFFu // symbol time with the transducer off
+#define GAP_SYMBOLS       2 // 1 s between copies
+#define MESSAGE_GAP_SYMBOLS 8 // 4 s before a message that follows another, so the receiver keeps them apart
+#define FRAME_SYMBOLS     ((PACKET_MAX_FRAME * FEC_CODED_BITS + MFSK_BITS - 1) / MFSK_BITS)
+#define COPY_SYMBOLS      (SYNC_LENGTH + LINK_RATE_FIELD_SYMBOLS + FRAME_SYMBOLS + DATA_LENGTH + GAP_SYMBOLS)
+#define BURST_SYMBOLS     (MESSAGE_GAP_SYMBOLS + MAX_DATA_SENDING * COPY_SYMBOLS)
+#define TICKS_PER_SYMBOL  LINK_RATE_DIVISOR(LINK_RATES - 1u) // isr_sec ticks in a base symbol time
+#define TX_TICK_MS        (LINK_RATE_BASE_MS / TICKS_PER_SYMBOL) // PWM_Switch_Timer period, 125 ms
 
 /*Enumerations*/
 enum state{
     Encoding_Byte,
-    Data,
-    Parity,
+    Rate_Field,     // linkRate, LINK_RATE_BITS twice
+    Data,           // the packet frame, FEC_CODED_BITS per byte, MFSK_BITS per symbol
     Decoding_Byte,
 };
 
+/* What profile.h times, PROFILE_ON builds only */
+enum profileSlot{
+    PROFILE_SYMBOL,         // isr_sec
+    PROFILE_UART_RX,        // RxIsr
+    PROFILE_WDT_CHECK,      // watchDogCheck
+    PROFILE_WAKEUP,         // wakeUpIsr
+    PROFILE_UART_WAKE,      // RxWakeUp
+    PROFILE_BUILD_BURST,    // main loop: buildBurst
+    PROFILE_SLOT_COUNT
+};
+
 /*Function Prototypes*/
 int Byte(unsigned int hex_value, int bT);
-int FindParity(void);
+int Bits(unsigned int value, int length, int bT);
+int ByteLength(int byte);
+int FrameSymbol(int bT);
+void buildFrame(void);
+void buildBurst(uint8 leadGap);
+void startBurst(void);
+void playSymbol(void);
+uint8 nextMessage(void);
+void reportRoom(void);
+void answerSender(void);
+void showSending(void);
 void goToSleep(void);
 void wakeUp(void);
+#ifdef PROFILE_ON
+void profileLine(const char8 *line);
+#endif
 
 CY_ISR_PROTO(isr_sec); // High F Interrupt
 CY_ISR_PROTO(watchDogCheck); //reset watchDog timer before reset
@@ -101,24 +153,39 @@ CY_ISR_PROTO(wakeUpIsr); // sleep timer interrupt
 CY_ISR_PROTO(RxWakeUp); // sleep timer interrupt from UART
 
 /*Global Variables*/
-static int error = 0; // flag for input error
-static int i = 2; // to iterate through data array
 static int sleepCount = 0;
 uint16 count;
 char8 lineStr[LINE_STR_LENGTH];
 char8 data[LINE_STR_LENGTH];
-uint8 newDataflag = FALSE;
-static int bitTime = 0;
-static int currentByte = Encoding_Byte;
-static int prefixTime = 0;
-static int sendDataCount = 0;
-static int ParityFlag = FALSE;
-static int maxDataFlag = FALSE;
 static int wakeUpData = FALSE;
+static uint8 frame[PACKET_MAX_FRAME]; // packet being sent, the same for every copy
+static uint8 frameBytes = 0;
+static volatile uint32 uptimeMs = 0; // counted by the periodic timers, for reports
+
+/* The burst being sent, one tone per symbol time, played out by isr_sec */
+static uint8 symbols[BURST_SYMBOLS];
+static uint8 symbolTicks[BURST_SYMBOLS]; // how many isr_sec ticks each one lasts
+static uint8 ticksLeft = 0; // of the symbol playing
+static uint16 symbolCount = 0;
+static volatile uint16 symbolNext = 0;
+static volatile uint8 playing = FALSE; // isr_sec has symbols left to play
+static uint8 lastTone = TX_SILENT; // tone the modulator is set to
+
+/* Counts from the UART wait here for their turn, RxIsr fills it */
+static eventQueue messages;
+static uint8 linkRate = 0; // rate of the frames sent, from the last rate command
+static volatile uint8 countFlag = FALSE; // RxIsr took a count or rate, the sender waits for the room
+
+#ifdef PROFILE_ON
+static const char8 *const profileNames[PROFILE_SLOT_COUNT] = {
+    "isr_sec", "RxIsr", "watchDogCheck", "wakeUpIsr", "RxWakeUp", "buildBurst"
+};
+#endif
 
 /* UART Global Variables */
 uint8 errorStatus = 0u; // No error at beginning
 uint8 crabsToSend = 0x1; // Start at 1 for testing
+uint8 trapToSend = TRAP_ID; // trap crabsToSend was counted at
 
 
 /*******************************************************************************
@@ -127,172 +194,137 @@ uint8 crabsToSend = 0x1; // Start at 1 for testing
 int main()
 {
     /*Variable initializations*/
-    int bitCase = 0;
+#if(UART == DISABLED)
     int data_turn = 0;
+#endif /* UART == DISABLED */
 
+#ifdef PROFILE_ON
+    profileInit(profileNames, PROFILE_SLOT_COUNT);
+#endif
 #if(UART == ENABLED)
-    isr_rx_StartEx(RxIsr);
+    eventQueueInit(&messages);
+    HAL_IsrStart(HAL_IRQ_UART_RX, RxIsr);
 #endif /* UART == ENABLED */
     
     /* Enable global interrupts. */
-    CyGlobalIntEnable;
+    HAL_IntEnable();
     /* Start Watchdog and its check timer */
-    CyWdtStart(CYWDT_1024_TICKS, CYWDT_LPMODE_NOCHANGE); // 2.048 - 3.072 s
-    checkWatchDogTimer_Start();
-    watchDogCheck_StartEx(watchDogCheck);
+    HAL_WdtStart(); // 2.048 - 3.072 s
+    HAL_TimerStart(HAL_TIMER_WDT_CHECK);
+    HAL_IsrStart(HAL_IRQ_WDT_CHECK, watchDogCheck);
     
     /*Block initializations*/
-    UART_Start(); 
-    LCD_Start();
-    PWM_Modulator_Start();
-    PWM_Switch_Timer_Start();
+    HAL_UartStart(); 
+    HAL_LcdStart();
+    HAL_PwmStart();
     
     /* Start Interrupts */
-    isr_sec_StartEx(isr_sec);
-    Sleep_ISR_StartEx(wakeUpIsr);
+    HAL_IsrStart(HAL_IRQ_SYMBOL, isr_sec);
+    HAL_IsrStart(HAL_IRQ_SLEEP, wakeUpIsr);
     
     /* Clear LCD line. */
-    LCD_Position(0u, 0u);
-    LCD_PrintString("                    ");
+    HAL_LcdPosition(0u, 0u);
+    HAL_LcdPrintString("                    ");
 
     /* Output string on LCD. */
-    LCD_Position(0u, 0u);
-    LCD_PrintString("Hello");
-    CyDelay(FiveSecs);
+    HAL_LcdPosition(0u, 0u);
+    HAL_LcdPrintString("Hello");
+    HAL_DelayMs(FiveSecs);
+    
+    /* First symbol starts now, not during the delay */
+#if(UART == ENABLED)
+    reportRoom(); // the sender may have been waiting for us
+    nextMessage(); // a count may have come in during the delay
+#endif /* UART == ENABLED */
+    showSending();
+    buildBurst(FALSE);
+    startBurst();
 
     for(;;)
     {
+        /* isr_sec plays the burst, sleep until the next interrupt */
+        HAL_Idle();
+#if(UART == ENABLED)
+        answerSender();
+#endif /* UART == ENABLED */
+#ifdef PROFILE_ON
+        /* The statistics go out the UART now and then */
+        if(profileDue() != FALSE){
+            profileDump(profileLine);
+        }
+#endif
         if(errorStatus != 0u)
         {
+            sprintf(data,"%d", errorStatus);
+            HAL_LcdPrintString(data);
             /* Clear error status */
             errorStatus = 0u;
         }
-        switch(currentByte){
-            case Encoding_Byte:
-                bitCase = Byte(PREFIX_MESSAGE, bitTime);
-                break;
-            case Data:
-                bitCase = Byte(crabsToSend, bitTime);
-                break;
-            case Parity:
-                ParityFlag = TRUE;
-                bitCase = FindParity();
-                break;
-            case Decoding_Byte:
-                bitCase = Byte(DECODE_VALUE, bitTime);
-                break;
- 
-            default:
-                /* Switch data or repeat data depending on sendDataCount */
-                sendDataCount++; // count how many times we send data
-                newDataflag = FALSE; // Turn sending off until new data from UART
-                prefixTime = 0;
+        if(playing == TRUE){
+            continue;
+        }
+
+        /* Burst over: every copy is out */
 #if(UART == ENABLED)
-                data_turn++;
-                if (data_turn == DATA_LENGTH) {
-                    data_turn = 0;
-                }
-#else 
-                // Restart data if sent MAX_DATA_SENDING
-                if(sendDataCount >= MAX_DATA_SENDING){
-                    
-                    crabsToSend <<= 1; // Move over data a bit
-                    data_turn++;
-                    maxDataFlag = TRUE; // flag for extra 2 second delay between new data
-                }
-                //Once data to be sent can't be contained in a byte, reset to 0x1
-                if (data_turn >= DATA_LENGTH-1) {
-                    data_turn = 0;
-                    crabsToSend = ONE;
-                }
-                
-                /* Clear LCD line. */
-                LCD_Position(0u, 0u);
-                sprintf(data,"Crabs: %d", crabsToSend);
-                LCD_PrintString("             ");
-
-                /* Output string on LCD. */
-                LCD_Position(0u, 0u);
-                LCD_PrintString(data);
- 
+        /* More counts waiting, send the next one after a short gap */
+        if(nextMessage() != FALSE){
+            showSending();
+            buildBurst(TRUE);
+            startBurst();
+            continue;
+        }
+#else
+        crabsToSend <<= 1; // Move over data a bit
+        data_turn++;
+        //Once data to be sent can't be contained in a byte, reset to 0x1
+        if (data_turn >= DATA_LENGTH-1) {
+            data_turn = 0;
+            crabsToSend = ONE;
+        }
+        showSending();
 #endif /* UART == ENABLED */
 
-                // Turn off PWM and stop timer 
-                PWM_Modulator_Stop();
-                PWM_Switch_Timer_Stop();
-                HighVoltage_Write(0); // Turn High Voltage off while delaying
-                CyDelay(20);
-                SignalBase_Write(0);               
-                
-                if(sendDataCount >= MAX_DATA_SENDING){
-                    
-                    SleepTimer_Start();
-                    goToSleep();
-                    // PSoC Sleep command. To adjust sleep time, change in the hardware
-                    CyPmSleep(PM_SLEEP_TIME_NONE, PM_SLEEP_SRC_CTW);
-                }
+        // Turn off PWM and the high voltage while waiting
+        HAL_PinWrite(HAL_PIN_HIGH_VOLTAGE, 0);
+        HAL_PinWrite(HAL_PIN_SIGNAL_BASE, 0);               
+        
+        HAL_SleepTimerStart();
+        goToSleep();
+        HAL_WdtClear(); // the sleep lasts up to a SleepTimer period
+        // PSoC Sleep command. To adjust sleep time, change in the hardware
+        HAL_Sleep();
 
 #if(UART == ENABLED)
-                /* Check if data has been sent 3 time */
-                if(sendDataCount >= MAX_DATA_SENDING){
-                    RxWakeUp_StartEx(RxWakeUp); //Start UART interrupt while in sleep mode
-                    sendDataCount = 0; // reset for sending new data
-                    /* Wait for new data before sending out data */
-                    while(newDataflag == FALSE){
-                        CyWdtClear(); // Clear watchdog timer while in sleep
-                        
-                    }
-                    //New Transmission, wake up PSOC
-                    RxWakeUp_Stop();
-                    SleepTimer_Stop();
-                    wakeUp(); 
-                }else{
-                    /* Delay 1 s before sending out for MAX_DATA_SENDING times */
-                    CyDelay(1000);
-                }
+        HAL_IsrStart(HAL_IRQ_UART_WAKE, RxWakeUp); //Start UART interrupt while in sleep mode
+        /* Wait for new data before sending out data */
+        while(nextMessage() == FALSE){
+            HAL_WdtClear(); // Clear watchdog timer while in sleep
+            HAL_Idle();
+            answerSender();
+        }
+        //New Transmission, wake up PSOC
+        HAL_IsrStop(HAL_IRQ_UART_WAKE);
 #else 
-                if(maxDataFlag == TRUE){
-                    sendDataCount = 0;
-                    /* Delay in ms and send data after without waiting for UART */
-                    while(wakeUpData == FALSE){
-                        CyWdtClear(); // Clear watchdog timer while in sleep
-                        // PSoC Sleep command. To adjust sleep time, change in the hardware
-                        CyPmSleep(PM_SLEEP_TIME_NONE, PM_SLEEP_SRC_CTW);
-                    }
-                    maxDataFlag = FALSE;
-                    wakeUpData = FALSE;
-                    //New Transmission, wake up PSOC
-                    SleepTimer_Stop();
-                    wakeUp(); 
-                }else{
-                    // Sending data again, pause 1 s in between
-                    CyDelay(1000);
-                }
-                
+        /* Send data after a while without waiting for UART */
+        while(wakeUpData == FALSE){
+            HAL_WdtClear(); // Clear watchdog timer while in sleep
+            // PSoC Sleep command. To adjust sleep time, change in the hardware
+            HAL_Sleep();
+        }
+        wakeUpData = FALSE;
+#endif /* UART == ENABLED */
+        HAL_SleepTimerStop();
+        wakeUp(); 
+        HAL_WdtClear(); // watchDogCheck's first tick is a whole WDT_CHECK_MS away
+#if(UART == ENABLED)
+        showSending(); // the LCD was asleep when nextMessage took it
 #endif /* UART == ENABLED */
 
-                /* New data: Turn on circuitry and begin transmission */
-                HighVoltage_Write(1);
-                CyDelay(20); // Give voltage booster time to charge up
-                SignalBase_Write(1);
-                /* Reset PWM blocks and bitTime for new transmission */
-                bitTime = 0; 
-                PWM_Modulator_Start();
-                PWM_Switch_Timer_Start();
-                currentByte = Encoding_Byte;
-                break;
-         } //end switch(bitTime) 
-        
-        /* Send out frequency depending on bit is 1 or 0 */
-        if(bitCase == ONE){
-            SignalBase_Write(1);
-            PWM_Modulator_Start();
-            PWM_Modulator_WritePeriod(FREQ(ONE_FREQ));
-            PWM_Modulator_WriteCompare((FREQ(ONE_FREQ))/2); // Sets pulse width
-        }else if(bitCase == ZERO){
-            PWM_Modulator_Stop();
-            SignalBase_Write(0);
-        } // end if statement
+        /* New data: Turn on circuitry and begin transmission */
+        HAL_PinWrite(HAL_PIN_HIGH_VOLTAGE, 1);
+        HAL_DelayMs(20); // Give voltage booster time to charge up
+        buildBurst(FALSE);
+        startBurst();
     } // end for loop
 } // end main
 
@@ -306,7 +338,7 @@ int main()
  */
 int Byte(unsigned int hex_value, int bT)
 {
-    int bitCase;
+    int bitCase = 0; // bit times past the byte send a low
     switch(bT){
         case 0:
             bitCase = (hex_value & BIT_7_MASK) >> 7;
@@ -338,25 +370,294 @@ int Byte(unsigned int hex_value, int bT)
     return bitCase;
 }//end Byte()
 
+/*
+ * function: int Bits(unsigned int value, int length, int bT)
+ * parameters: value - bits to send, right aligned
+ *             length - how many bits of value to send
+ *             bT - the current bit time
+ * returns: bitCase - the bit of value to send at this bit time, MSB first
+ * description: Byte() for sequences that are not 8 bits long, like the
+ *  sync word.
+ */
+int Bits(unsigned int value, int length, int bT)
+{
+    return (value >> (length - 1 - bT)) & BIT_0_MASK;
+}//end Bits()
+
+
+/*
+ * function: int ByteLength(int byte)
+ * parameters: byte - a state from enum state
+ * returns: how many bit times that part of the message takes
+ */
+int ByteLength(int byte)
+{
+    switch(byte){
+        case Encoding_Byte:
+            return SYNC_LENGTH;
+        case Rate_Field:
+            return LINK_RATE_FIELD_SYMBOLS;
+        case Data:
+            return (frameBytes * FEC_CODED_BITS + MFSK_BITS - 1) / MFSK_BITS;
+        default:
+            return DATA_LENGTH;
+    }
+}//end ByteLength()
+
+/*
+ * function: int FrameSymbol(int bT)
+ * parameters: bT - the current symbol time in the frame
+ * returns: the MFSK_BITS coded frame bits to send at this symbol time,
+ *  first bit in the MSB. Bits past the end of the frame are 0.
+ */
+int FrameSymbol(int bT)
+{
+    int symbol = 0;
+    int n, bit;
+
+    for(bit = 0; bit < MFSK_BITS; bit++){
+        n = bT * MFSK_BITS + bit;
+        symbol <<= 1;
+        if(n < frameBytes * FEC_CODED_BITS){
+            symbol |= Bits(fecEncode(frame[n / FEC_CODED_BITS]), FEC_CODED_BITS,
+                n % FEC_CODED_BITS);
+        }
+    }
+    return symbol;
+}//end FrameSymbol()
+
+/*
+ * function: void buildFrame(void)
+ * parameters: none
+ * returns: none
+ * description: Packs crabsToSend and trapToSend into a crab report and frames it for
+ *  sending. Called before each new message, so that every copy of it
+ *  is the same.
+ */
+void buildFrame(void)
+{
+    crabReport report;
+    packet message;
+
+    report.trapId = trapToSend;
+    report.crabs = crabsToSend;
+    report.minutes = (uint16)(uptimeMs / MS_PER_MINUTE);
+    report.battery = REPORT_NO_BATTERY;
+    reportToPacket(&report, REPORT_LENGTH, &message);
+    frameBytes = packetBuild(&message, frame);
+}//end buildFrame()
+
+/*
+ * function: void buildBurst(uint8 leadGap)
+ * parameters: leadGap - TRUE to start with MESSAGE_GAP_SYMBOLS of silence,
+ *  for a burst that follows the last one right away
+ * returns: none
+ * description: Works out the tone and length of every symbol of the burst
+ *  up front: MAX_DATA_SENDING copies of sync word, rate field, frame and
+ *  post-fix, with GAP_SYMBOLS of silence between them. The frame symbols
+ *  are linkRate's length, all others a base symbol time. Only call while
+ *  nothing plays.
+ */
+void buildBurst(uint8 leadGap)
+{
+    int copy, byte, bT;
+    int tone = MFSK_SPACE;
+    uint8 ticks;
+
+    PROFILE_ENTER(PROFILE_BUILD_BURST);
+    buildFrame();
+    symbolCount = 0;
+    /* The receiver tells a new message from another copy by the longer gap */
+    if(leadGap == TRUE){
+        for(bT = 0; bT < MESSAGE_GAP_SYMBOLS; bT++){
+            symbolTicks[symbolCount] = TICKS_PER_SYMBOL;
+            symbols[symbolCount++] = TX_SILENT;
+        }
+    }
+    for(copy = 0; copy < MAX_DATA_SENDING; copy++){
+        if(copy > 0){
+            for(bT = 0; bT < GAP_SYMBOLS; bT++){
+                symbolTicks[symbolCount] = TICKS_PER_SYMBOL;
+                symbols[symbolCount++] = TX_SILENT;
+            }
+        }
+        for(byte = Encoding_Byte; byte <= Decoding_Byte; byte++){
+            ticks = TICKS_PER_SYMBOL;
+            if(byte == Data){
+                ticks = TICKS_PER_SYMBOL / LINK_RATE_DIVISOR(linkRate);
+            }
+            for(bT = 0; bT < ByteLength(byte); bT++){
+                switch(byte){
+                    case Encoding_Byte:
+                        tone = BIT_TONE(Bits(SYNC_WORD, SYNC_LENGTH, bT));
+                        break;
+                    case Rate_Field:
+                        tone = BIT_TONE(Bits(linkRate, LINK_RATE_BITS, bT % LINK_RATE_BITS));
+                        break;
+                    case Data:
+                        tone = mfskTone(FrameSymbol(bT));
+                        break;
+                    default:
+                        tone = BIT_TONE(Byte(DECODE_VALUE, bT));
+                        break;
+                }
+                symbolTicks[symbolCount] = ticks;
+                symbols[symbolCount++] = (uint8)tone;
+            }
+        }
+    }
+    PROFILE_EXIT(PROFILE_BUILD_BURST);
+}//end buildBurst()
+
+/*
+ * function: void startBurst(void)
+ * parameters: none
+ * returns: none
+ * description: Plays the first symbol now and lets isr_sec play the rest.
+ */
+void startBurst(void)
+{
+    symbolNext = 0;
+    ticksLeft = 0;
+    lastTone = TX_SILENT;
+    playing = TRUE;
+    playSymbol();
+    HAL_TimerStart(HAL_TIMER_SYMBOL);
+}//end startBurst()
 
 /*
- * function: void FindParity(void)
- * parameters: void
- * returns: void
- * description: XORs each bit of data to get even or odd parity for
- * error checking
+ * function: void playSymbol(void)
+ * parameters: none
+ * returns: none
+ * description: Called every isr_sec tick. Once the symbol playing has had
+ *  its ticks, sets the modulator to the next symbol's tone. It is only
+ *  touched when the tone changes. After the last symbol the transducer
+ *  and the symbol timer stop.
  */
-int FindParity()
+void playSymbol(void)
 {
-    uint8 bitToCheck = crabsToSend; // store crabsToSend in new variable to manipulate
-    int i = 0;
-    int parity = (bitToCheck & BIT_0_MASK);
-    for(i = 0; i < DATA_LENGTH; i++){
-        bitToCheck = bitToCheck >> 1; // shift mask over
-        parity = (bitToCheck & BIT_0_MASK) ^ parity; // XOR new bit
+    uint8 tone;
+
+    if(ticksLeft > 1u){
+        ticksLeft--;
+        return;
+    }
+    if(symbolNext >= symbolCount){
+        HAL_TimerStop(HAL_TIMER_SYMBOL);
+        HAL_PwmStop();
+        HAL_PinWrite(HAL_PIN_SIGNAL_BASE, 0);
+        lastTone = TX_SILENT;
+        playing = FALSE;
+        return;
     }
-    return parity;
-}//end FindParity()   
+    ticksLeft = symbolTicks[symbolNext];
+    tone = symbols[symbolNext++];
+    if(tone == lastTone){
+        return;
+    }
+    if(tone == TX_SILENT){
+        HAL_PwmStop();
+        HAL_PinWrite(HAL_PIN_SIGNAL_BASE, 0);
+    }else{
+        /* Zeros get their own tone so the receiver can compare the two */
+        HAL_PinWrite(HAL_PIN_SIGNAL_BASE, 1);
+        HAL_PwmSetFrequency(mfskFreq[tone]); // 50% duty cycle
+        if(lastTone == TX_SILENT){
+            HAL_PwmStart();
+        }
+    }
+    lastTone = tone;
+}//end playSymbol()
+
+/*
+ * function: uint8 nextMessage(void)
+ * parameters: none
+ * returns: TRUE if crabsToSend now holds a count from the UART
+ * description: Takes the next count to send out of the message queue,
+ *  following TX_POLICY, and tells the sender there is room again. Rate
+ *  commands on the way set linkRate. Only call between bursts.
+ */
+uint8 nextMessage(void)
+{
+    event message;
+    uint8 taken = FALSE;
+
+    while(eventQueueGet(&messages, &message) != FALSE){
+        if(message.type == TX_RATE){
+            if(message.value < LINK_RATES){
+                linkRate = (uint8)message.value;
+            }
+            continue;
+        }
+        crabsToSend = (uint8)message.value;
+        trapToSend = (message.flag != 0u) ? message.flag : TRAP_ID;
+        taken = TRUE;
+#if(TX_POLICY != TX_POLICY_NEWEST)
+        break; // one burst per count
+#endif
+    }
+    if(taken == TRUE){
+        reportRoom();
+    }
+    return taken;
+}//end nextMessage()
+
+/*
+ * function: void reportRoom(void)
+ * parameters: none
+ * returns: none
+ * description: Sends the sender a COUNT_LINK_READY byte with the room left
+ *  in the message queue (countLink.h). Main loop only: after RxIsr took
+ *  counts or rates (answerSender), when a count is taken out and at start.
+ */
+void reportRoom(void)
+{
+    uint8 room = (uint8)(EVENT_QUEUE_SIZE - 1u - eventQueuePending(&messages));
+
+    if(room > COUNT_LINK_ROOM_MASK){
+        room = COUNT_LINK_ROOM_MASK;
+    }
+    HAL_UartPutChar(COUNT_LINK_READY | room);
+}//end reportRoom()
+
+/*
+ * function: void answerSender(void)
+ * parameters: none
+ * returns: none
+ * description: Once RxIsr has taken counts or rate commands, reports the
+ *  room left to the sender. Main loop only: the UART call waits for room
+ *  in its FIFO, which does not belong in RxIsr.
+ */
+void answerSender(void)
+{
+    if(countFlag == FALSE){
+        return;
+    }
+    countFlag = FALSE;
+    reportRoom();
+}//end answerSender()
+
+/*
+ * function: void showSending(void)
+ * parameters: none
+ * returns: none
+ * description: Shows the count the burst about to start sends on the LCD,
+ *  and its trap when it is another's. Main loop only, with the LCD awake.
+ */
+void showSending(void)
+{
+    /* Clear LCD line. */
+    HAL_LcdPosition(0u, 0u);
+    HAL_LcdPrintString("                    ");
+    if(trapToSend != TRAP_ID){
+        sprintf(data,"Crabs: %d T%d", crabsToSend, trapToSend);
+    }else{
+        sprintf(data,"Crabs: %d", crabsToSend);
+    }
+    /* Output string on LCD. */
+    HAL_LcdPosition(0u, 0u);
+    HAL_LcdPrintString(data);
+}//end showSending()
 
 /*
  * function: void wakeUp(void)
@@ -368,13 +669,12 @@ int FindParity()
 
 void wakeUp(void){
 #if(UART == DISABLED)
-    CyPmRestoreClocks();
+    HAL_RestoreClocks();
 #endif /* UART == ENABLED */
-    LCD_Wakeup();
-    checkWatchDogTimer_Wakeup();
-    PWM_Modulator_Wakeup();
-    PWM_Switch_Timer_Wakeup(); 
-    PWM_Switch_Timer_Start();
+    HAL_LcdWakeup();
+    HAL_TimerWakeup(HAL_TIMER_WDT_CHECK);
+    HAL_PwmWakeup();
+    HAL_TimerWakeup(HAL_TIMER_SYMBOL); 
     
 }//end wakeUp()
 
@@ -386,15 +686,15 @@ void wakeUp(void){
  *  
  */
 void goToSleep(){
-    LCD_Sleep();
-    PWM_Modulator_Sleep();
-    PWM_Switch_Timer_Sleep();
-    checkWatchDogTimer_Sleep();
-    UART_Sleep();
-    watchDogCheck_ClearPending();
-    isr_sec_ClearPending();
-    isr_rx_ClearPending();
-    CyPmSaveClocks();
+    HAL_LcdSleep();
+    HAL_PwmSleep();
+    HAL_TimerSleep(HAL_TIMER_SYMBOL);
+    HAL_TimerSleep(HAL_TIMER_WDT_CHECK);
+    HAL_UartSleep();
+    HAL_IsrClearPending(HAL_IRQ_WDT_CHECK);
+    HAL_IsrClearPending(HAL_IRQ_SYMBOL);
+    HAL_IsrClearPending(HAL_IRQ_UART_RX);
+    HAL_SaveClocks();
 
 }//end goToSleep()
 
@@ -405,9 +705,8 @@ void goToSleep(){
 *
 * Summary:
 * Interrupt triggered on a 0.1s timer timeout
- * This ISR will activate every half second and keep track of what
- *  current bit we are on within a byte. After every 8th bit, it resets and
- *  moves on to a new byte.
+ * This ISR will activate every TX_TICK_MS and start the next symbol of
+ *  the burst when it is due, so the symbol edges don't wait on the main loop.
 *
 * Parameters:
 *  None.
@@ -418,17 +717,9 @@ void goToSleep(){
 *******************************************************************************/
 CY_ISR(isr_sec)
 {
-    bitTime++;
-    /* Only want to send one bit for parity */
-    if(ParityFlag == TRUE){
-        bitTime = 0;
-        currentByte++;
-        ParityFlag = FALSE;
-    }
-    if (bitTime == 8){
-        bitTime = 0;
-        currentByte++;
-    }
+    PROFILE_ENTER(PROFILE_SYMBOL);
+    playSymbol();
+    PROFILE_EXIT(PROFILE_SYMBOL);
 }//end CY_ISR(isr_sec)
 
 /*******************************************************************************
@@ -449,51 +740,71 @@ CY_ISR(isr_sec)
 CY_ISR(RxIsr)
 {
     
+    PROFILE_ENTER(PROFILE_UART_RX);
     //sleepToggle_Write(ON);
+    static uint8 lastQueued = 0; // count last put in the queue
+    static uint8 lastTrap = 0; // and its trap, 0 for this one
+    static uint8 nextTrap = 0; // trap of the next count, from COUNT_LINK_TRAP
+    static uint8 trapFollows = FALSE; // the byte after COUNT_LINK_TRAP is the ID
     uint8 rxStatus;   
+    uint8 received;
     do
     {
         /* Read receiver status register */
-        rxStatus = UART_RXSTATUS_REG;
+        rxStatus = HAL_UartRxStatus();
 
-        if((rxStatus & (UART_RX_STS_BREAK      | UART_RX_STS_PAR_ERROR |
-                        UART_RX_STS_STOP_ERROR | UART_RX_STS_OVERRUN)) != 0u)
+        if((rxStatus & HAL_UART_RX_ERRORS) != 0u)
         {
             /* ERROR handling. */
-            errorStatus |= rxStatus & ( UART_RX_STS_BREAK      | UART_RX_STS_PAR_ERROR | 
-                                        UART_RX_STS_STOP_ERROR | UART_RX_STS_OVERRUN);
+            errorStatus |= rxStatus & HAL_UART_RX_ERRORS;
         }
         
-        if((rxStatus & UART_RX_STS_FIFO_NOTEMPTY) != 0u)
+        if((rxStatus & HAL_UART_RX_NOTEMPTY) != 0u)
         {
-            newDataflag = TRUE;
             /* Read data from the RX data register */
-            //crabsToSend = UART_RXDATA_REG;
-            crabsToSend =  UART_GetByte()  ;
+            received =  HAL_UartGetByte()  ;
             if(errorStatus == 0u)
             {
-                /* Send data backward */
-                UART_TXDATA_REG = crabsToSend;
-                /* Clear LCD line. */
-                LCD_Position(0u, 0u);
-                sprintf(data,"Crabs: %d", crabsToSend);
-                LCD_PrintString("             ");
-                /* Output string on LCD. */
-                LCD_Position(0u, 0u);
-                LCD_PrintString(data);
+                /* Queue it, the frame on the air is not touched */
+                if(trapFollows == TRUE){
+                    trapFollows = FALSE;
+                    nextTrap = received & COUNT_LINK_MAX_TRAP;
+                }
+                else if(received == COUNT_LINK_TRAP){
+                    trapFollows = TRUE;
+                }
+                else if((received & LINK_RATE_COMMAND) != 0u){
+                    eventQueuePut(&messages, TX_RATE, 0u, received & LINK_RATE_MASK);
+                    lastQueued = received; // never equal to a count
+                    countFlag = TRUE; // the sender waits for this answer too
+                }
+                else
+                {
+#if(TX_POLICY == TX_POLICY_COALESCE)
+                    if((eventQueuePending(&messages) == 0u) || (received != lastQueued) ||
+                        (nextTrap != lastTrap))
+#endif
+                    {
+                        eventQueuePut(&messages, TX_MESSAGE, nextTrap, received);
+                        lastQueued = received;
+                        lastTrap = nextTrap;
+                    }
+                    nextTrap = 0; // the next count is this trap's unless told
+                    /* The main loop answers the sender */
+                    countFlag = TRUE;
+                }
 
             }else{
-                isr_rx_SetPending();
-                sprintf(data,"%d", errorStatus);
-                LCD_PrintString(data);
+                HAL_IsrSetPending(HAL_IRQ_UART_RX); // the main loop shows the error
             }
 
         }
     // Read FIFO until empty
-    }while((rxStatus & UART_RX_STS_FIFO_NOTEMPTY) != 0u);
+    }while((rxStatus & HAL_UART_RX_NOTEMPTY) != 0u);
     
-    isr_rx_ClearPending();
+    HAL_IsrClearPending(HAL_IRQ_UART_RX);
     //sleepToggle_Write(OFF);
+    PROFILE_EXIT(PROFILE_UART_RX);
 } //end CY_ISR(RxIsr)
 
 /*******************************************************************************
@@ -514,7 +825,10 @@ CY_ISR(RxIsr)
 *******************************************************************************/
 CY_ISR(watchDogCheck){
     
-    CyWdtClear(); 
+    PROFILE_ENTER(PROFILE_WDT_CHECK);
+    HAL_WdtClear(); 
+    uptimeMs += WDT_CHECK_MS;
+    PROFILE_EXIT(PROFILE_WDT_CHECK);
 } //CY_ISR(watchDogCheck)
 
 
@@ -534,13 +848,16 @@ CY_ISR(watchDogCheck){
 *
 *******************************************************************************/
 CY_ISR(wakeUpIsr){
-    SleepTimer_GetStatus(); // Clears the sleep timer interrupt
-    CyWdtClear(); // Clear watchdog timer while in sleep
+    PROFILE_ENTER(PROFILE_WAKEUP);
+    HAL_SleepTimerClear(); // Clears the sleep timer interrupt
+    HAL_WdtClear(); // Clear watchdog timer while in sleep
+    uptimeMs += SLEEP_TIMER_MS;
     sleepCount++;
     if(sleepCount > MAX_SLEEP_COUNT){
         wakeUpData = TRUE;
         sleepCount = 0;
     }
+    PROFILE_EXIT(PROFILE_WAKEUP);
 
 } //end CY_ISR(wakeUpIsr)
 
@@ -559,15 +876,34 @@ CY_ISR(wakeUpIsr){
 *
 *******************************************************************************/
 CY_ISR(RxWakeUp){
-    sleepToggle_Write(1);
-    CyPmRestoreClocks();
-    UART_Wakeup();
-    UART_Start();
-    isr_rx_StartEx(RxIsr);
-    RxWakeUp_ClearPending();
-    RxWakeUp_Disable();
-    isr_rx_SetPending();
+    PROFILE_ENTER(PROFILE_UART_WAKE);
+    HAL_PinWrite(HAL_PIN_SLEEP_TOGGLE, 1);
+    HAL_RestoreClocks();
+    HAL_UartWakeup();
+    HAL_UartStart();
+    HAL_IsrStart(HAL_IRQ_UART_RX, RxIsr);
+    HAL_IsrClearPending(HAL_IRQ_UART_WAKE);
+    HAL_IsrStop(HAL_IRQ_UART_WAKE);
+    HAL_IsrSetPending(HAL_IRQ_UART_RX);
+    PROFILE_EXIT(PROFILE_UART_WAKE);
 
 } //end CY_ISR(wakeUpIsr)
 
+#ifdef PROFILE_ON
+/*
+ * function: void profileLine(const char8 *line)
+ * parameters: line - one line of the profile
+ * returns: none
+ * description: Sends the line out the UART, the way the counts come back.
+ */
+void profileLine(const char8 *line)
+{
+    while(*line != '\0'){
+        HAL_UartPutChar((uint8)*line++);
+    }
+    HAL_UartPutChar('\r');
+    HAL_UartPutChar('\n');
+}
+#endif /* PROFILE_ON */
+
 /* [] END OF FILE */
\ No newline at end of file
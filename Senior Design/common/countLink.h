@@ -0,0 +1,40 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Count Link
+ * Function: The bytes user_input and USBFS_Tx swap over the UART.
+ *
+ * To the transmitter:
+ *     0x00-0x7F           a crab count, sent in a message of its own
+ *     LINK_RATE_COMMAND | rate    (linkRate.h) for the messages after it
+ *     COUNT_LINK_TRAP, id the count after it is from trap id (1-127), not
+ *                         from the transmitter's own trap
+ *
+ * Back from the transmitter:
+ *     COUNT_LINK_READY | n    room for n more counts. Sent after the counts
+ *                             and rate commands it gets, kept or not,
+ *                             whenever it takes one out to send, and once
+ *                             after it starts.
+ *
+ * The sender has one count or rate out at a time and waits for the report that
+ * answers it; a report can be one count behind, so it only sends while
+ * the room is more than COUNT_LINK_SPARE. A transmitter that never reports
+ * gets a count every COUNT_LINK_TIMEOUT_MS, the old pacing of one count per
+ * burst, so its queue can't overflow either.
+ * =============================================================================
+*/
+
+#ifndef COUNT_LINK_H
+#define COUNT_LINK_H
+
+#define COUNT_LINK_MAX_COUNT    0x7Fu   // counts stay below the command bytes
+#define COUNT_LINK_TRAP         0xC0u   // trap ID of the next count follows
+#define COUNT_LINK_MAX_TRAP     0x7Fu
+#define COUNT_LINK_READY        0xE0u   // COUNT_LINK_READY | room
+#define COUNT_LINK_READY_MASK   0xF0u
+#define COUNT_LINK_ROOM_MASK    0x0Fu
+#define COUNT_LINK_SPARE        1u      // room the sender leaves for a late report
+#define COUNT_LINK_TIMEOUT_MS   81920u  // no answer, the count is taken as received (80 x 1.024 s)
+
+#endif /* COUNT_LINK_H */
+
+/* [] END OF FILE */
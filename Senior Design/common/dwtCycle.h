@@ -0,0 +1,34 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * DWT Cycle Counter
+ * Function: HAL_CycleCounterStart and HAL_CycleCount (hal.h) for the PSoC
+ * 5LP, on the cycle counter of the Cortex-M3 debug watchpoint unit. Each
+ * firmware's halPsoc.c includes it once; the simulator has its own.
+ * =============================================================================
+*/
+
+#ifndef DWT_CYCLE_H
+#define DWT_CYCLE_H
+
+#include "project.h"
+#include "hal.h"
+
+#define DEMCR               (*(reg32 *)0xE000EDFCu)
+#define DEMCR_TRCENA        0x01000000u
+#define DWT_CTRL            (*(reg32 *)0xE0001000u)
+#define DWT_CTRL_CYCCNTENA  0x00000001u
+#define DWT_CYCCNT          (*(reg32 *)0xE0001004u)
+
+void HAL_CycleCounterStart(void){
+    DEMCR |= DEMCR_TRCENA;
+    DWT_CYCCNT = 0u;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+uint32 HAL_CycleCount(void){
+    return DWT_CYCCNT;
+}
+
+#endif /* DWT_CYCLE_H */
+
+/* [] END OF FILE */
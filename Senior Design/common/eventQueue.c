@@ -0,0 +1,71 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Event Queue
+ * Function: Single-producer, single-consumer ring buffer. head == tail is
+ * empty, so one entry always stays free.
+ * =============================================================================
+*/
+
+#include "eventQueue.h"
+
+#define EVENT_QUEUE_MASK    (EVENT_QUEUE_SIZE - 1u)
+
+// Empty the queue; only before the producing ISR is started
+void eventQueueInit(eventQueue *queue){
+    queue->head = 0;
+    queue->tail = 0;
+    queue->dropped = 0;
+}
+
+/*
+ * function: uint8 eventQueuePut(eventQueue *queue, uint8 type, uint8 flag, int16 value)
+ * parameters: queue - from eventQueueInit, type/flag/value - the event
+ * returns: TRUE if queued, FALSE if the queue was full and the event dropped
+ * description: Called from the producing ISR only.
+ */
+uint8 eventQueuePut(eventQueue *queue, uint8 type, uint8 flag, int16 value){
+    uint8 head = queue->head;
+    uint8 next = (uint8)((head + 1u) & EVENT_QUEUE_MASK);
+
+    if(next == queue->tail){
+        queue->dropped++;
+        return 0;
+    }
+    queue->entries[head].type = type;
+    queue->entries[head].flag = flag;
+    queue->entries[head].value = value;
+    queue->head = next; // publish only once the entry is written
+    return 1;
+}
+
+/*
+ * function: uint8 eventQueueGet(eventQueue *queue, event *out)
+ * parameters: queue - from eventQueueInit, out - where the event goes
+ * returns: TRUE if an event was taken, FALSE if the queue was empty
+ * description: Called from the main loop only.
+ */
+uint8 eventQueueGet(eventQueue *queue, event *out){
+    uint8 tail = queue->tail;
+
+    if(tail == queue->head){
+        return 0;
+    }
+    out->type = queue->entries[tail].type;
+    out->flag = queue->entries[tail].flag;
+    out->value = queue->entries[tail].value;
+    queue->tail = (uint8)((tail + 1u) & EVENT_QUEUE_MASK); // entry free again
+    return 1;
+}
+
+/*
+ * function: uint8 eventQueuePending(const eventQueue *queue)
+ * parameters: queue - from eventQueueInit
+ * returns: events waiting. Either side may ask; the other side can only
+ * change the answer in its own direction (more for the ISR, fewer for the
+ * main loop).
+ */
+uint8 eventQueuePending(const eventQueue *queue){
+    return (uint8)((queue->head - queue->tail) & EVENT_QUEUE_MASK);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,43 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Event Queue
+ * Function: Hands events from one ISR to the main loop without disabling
+ * interrupts. The ISR only writes head and the main loop only writes tail,
+ * so neither can undo the other's update. Each side writes the entry before
+ * moving its own index (all volatile, so the compiler keeps that order),
+ * and the indices are single bytes, which the Cortex-M3 reads and writes
+ * in one go.
+ *
+ * One queue per producing ISR: two ISRs at different priorities could
+ * preempt each other in eventQueuePut.
+ * =============================================================================
+*/
+
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include "project.h"
+
+#define EVENT_QUEUE_SIZE    16u // entries, a power of two
+
+typedef struct{
+    uint8 type;         // what happened, each firmware numbers its own
+    uint8 flag;         // small detail, e.g. a pass/fail result
+    int16 value;
+}event;
+
+typedef struct{
+    volatile event entries[EVENT_QUEUE_SIZE];
+    volatile uint8 head;    // next entry to write, ISR only
+    volatile uint8 tail;    // next entry to read, main loop only
+    volatile uint8 dropped; // events lost to a full queue, ISR only
+}eventQueue;
+
+void eventQueueInit(eventQueue *queue);
+uint8 eventQueuePut(eventQueue *queue, uint8 type, uint8 flag, int16 value);
+uint8 eventQueueGet(eventQueue *queue, event *out);
+uint8 eventQueuePending(const eventQueue *queue);
+
+#endif /* EVENT_QUEUE_H */
+
+/* [] END OF FILE */
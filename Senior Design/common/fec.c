@@ -0,0 +1,124 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Forward Error Correction
+ * Function: Hamming(7,4) encoder and soft maximum-likelihood decoder.
+ * Codeword bits, first sent first: d3 d2 d1 d0 p2 p1 p0 (data MSB first).
+ * The coded word sends bit i of the high nibble's codeword, then bit i of
+ * the low nibble's, for i = 0..6.
+ * =============================================================================
+*/
+
+#include <stdint.h>
+#include "fec.h"
+
+#define HAMMING_BITS        7
+#define HAMMING_WORDS       16  // one per nibble value
+#define NIBBLE_MASK         0x0Fu
+
+/*
+ * function: static uint8 hammingWord(uint8 nibble)
+ * returns: the 7-bit codeword of a nibble, d3 d2 d1 d0 p2 p1 p0
+ */
+static uint8 hammingWord(uint8 nibble){
+    uint8 d0 = nibble & 1u;
+    uint8 d1 = (nibble >> 1) & 1u;
+    uint8 d2 = (nibble >> 2) & 1u;
+    uint8 d3 = (nibble >> 3) & 1u;
+    uint8 p2 = d3 ^ d2 ^ d0;
+    uint8 p1 = d3 ^ d1 ^ d0;
+    uint8 p0 = d2 ^ d1 ^ d0;
+
+    return (uint8)((nibble << 3) | (p2 << 2) | (p1 << 1) | p0);
+}
+
+/*
+ * function: uint16 fecEncode(uint8 data)
+ * parameters: data - byte to send
+ * returns: FEC_CODED_BITS bits, right aligned, to send MSB first
+ */
+uint16 fecEncode(uint8 data){
+    uint8 high = hammingWord((uint8)(data >> 4));
+    uint8 low = hammingWord((uint8)(data & NIBBLE_MASK));
+    uint16 coded = 0;
+    int8 bit;
+
+    for(bit = HAMMING_BITS - 1; bit >= 0; bit--){
+        coded = (uint16)((coded << 1) | ((high >> bit) & 1u));
+        coded = (uint16)((coded << 1) | ((low >> bit) & 1u));
+    }
+    return coded;
+}
+
+/*
+ * function: static uint8 decodeNibble(const int16 *soft, uint8 *corrected, int32 *margin)
+ * parameters: soft - the codeword's soft values, every other entry
+ *             corrected - incremented once per bit the decision overruled
+ *             margin - set to how far the best codeword scored ahead of the next
+ * returns: the nibble whose codeword agrees best with the soft values
+ * description: Each codeword scores the sum of the soft values where it has
+ * a 1 minus those where it has a 0. Trying all 16 is 112 additions.
+ */
+static uint8 decodeNibble(const int16 *soft, uint8 *corrected, int32 *margin){
+    int32 best = INT32_MIN;
+    int32 second = INT32_MIN;
+    uint8 bestNibble = 0;
+    uint8 nibble;
+    uint8 bit;
+
+    for(nibble = 0; nibble < HAMMING_WORDS; nibble++){
+        uint8 word = hammingWord(nibble);
+        int32 score = 0;
+
+        for(bit = 0; bit < HAMMING_BITS; bit++){
+            if(((word >> (HAMMING_BITS - 1 - bit)) & 1u) != 0u){
+                score += soft[2 * bit];
+            }else{
+                score -= soft[2 * bit];
+            }
+        }
+        if(score > best){
+            second = best;
+            best = score;
+            bestNibble = nibble;
+        }else if(score > second){
+            second = score;
+        }
+    }
+    *margin = best - second;
+
+    // Bits whose own sign disagreed with the chosen codeword
+    for(bit = 0; bit < HAMMING_BITS; bit++){
+        uint8 sent = (hammingWord(bestNibble) >> (HAMMING_BITS - 1 - bit)) & 1u;
+        if((soft[2 * bit] > 0) != (sent != 0u)){
+            (*corrected)++;
+        }
+    }
+    return bestNibble;
+}
+
+/*
+ * function: uint8 fecDecode(const int16 *soft, uint8 *corrected, int16 *margin)
+ * parameters: soft - FEC_CODED_BITS soft values in the order received,
+ *             positive for a 1 (sums over several copies are fine)
+ *             corrected - set to the number of bits the code overruled
+ *             margin - set to the smaller of the two nibbles' lead of the
+ *             best codeword over the next best, in soft units. Codewords
+ *             differ in 3 or more bits, so a clean decode leads by at least
+ *             6 times the bits' soft value.
+ * returns: the decoded byte
+ */
+uint8 fecDecode(const int16 *soft, uint8 *corrected, int16 *margin){
+    int32 highMargin, lowMargin;
+    uint8 high, low;
+
+    *corrected = 0;
+    high = decodeNibble(&soft[0], corrected, &highMargin);
+    low = decodeNibble(&soft[1], corrected, &lowMargin);
+    if(lowMargin < highMargin){
+        highMargin = lowMargin;
+    }
+    *margin = (int16)((highMargin > INT16_MAX) ? INT16_MAX : highMargin);
+    return (uint8)((high << 4) | low);
+}
+
+/* [] END OF FILE */
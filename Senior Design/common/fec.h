@@ -0,0 +1,27 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Forward Error Correction
+ * Function: Hamming(7,4) over the two nibbles of a data byte, with the two
+ * codewords interleaved bit by bit so that two bad bits in a row land in
+ * different codewords. Any two codewords differ in at least 3 bits, so a
+ * hard decoder fixes one bad bit per nibble; the receiver decodes from soft
+ * values instead and also gets through most pairs of weak bits.
+ *
+ * Shared by USBFS_Tx (fecEncode) and USBFS_Rx (fecDecode).
+ * =============================================================================
+*/
+
+#ifndef FEC_H
+#define FEC_H
+
+#include "project.h"
+
+#define FEC_DATA_BITS       8
+#define FEC_CODED_BITS      14  // sent MSB first
+
+uint16 fecEncode(uint8 data);
+uint8 fecDecode(const int16 *soft, uint8 *corrected, int16 *margin);
+
+#endif /* FEC_H */
+
+/* [] END OF FILE */
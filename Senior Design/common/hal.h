@@ -0,0 +1,148 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Hardware Abstraction Layer
+ * Function: Thin layer between the three firmwares (USBFS_Rx, USBFS_Tx,
+ * user_input) and the hardware. Each PSoC Creator project implements it in
+ * its own halPsoc.c on top of the generated component APIs; sim/halSim.c
+ * implements it on Linux with a simulated clock that drives the ISRs, so
+ * the same main.c files build and run on a PC (see sim/Makefile).
+ *
+ * Only what the firmwares actually use is here. Interrupts, timers and
+ * pins are named by role rather than by component, since the components
+ * differ between projects.
+ * =============================================================================
+*/
+
+#ifndef HAL_H
+#define HAL_H
+
+#include "project.h" /* Cypress types and CY_ISR, real or simulated */
+
+/* Interrupt handler, as defined with CY_ISR() */
+typedef void (*halIsr)(void);
+
+/* Interrupt lines, in priority order (lowest number first) */
+typedef enum{
+    HAL_IRQ_BIT_TIMER,  /* Rx: Data_ISR, bit sampling tick */
+    HAL_IRQ_SYMBOL,     /* Tx: isr_sec, symbol timer */
+    HAL_IRQ_UART_RX,    /* Tx: isr_rx, UART receive */
+    HAL_IRQ_UART_WAKE,  /* Tx/Rx: RxWakeUp, UART activity while asleep */
+    HAL_IRQ_TX_DONE,    /* user_input: tx_done, wait for the Tx to answer a count */
+    HAL_IRQ_SLEEP,      /* Rx/Tx: Sleep_ISR, sleep timer wakeup */
+    HAL_IRQ_WDT_CHECK,  /* Rx/Tx: watchDogCheck, clears the watchdog */
+    HAL_IRQ_COUNT
+}halIrq;
+
+/* Hardware timers */
+typedef enum{
+    HAL_TIMER_BIT,       /* Rx: Bit_Timer */
+    HAL_TIMER_SYMBOL,    /* Tx: PWM_Switch_Timer, 125 ms */
+    HAL_TIMER_DATA,      /* user_input: Data_Timer */
+    HAL_TIMER_WDT_CHECK, /* Rx/Tx: checkWatchDogTimer */
+    HAL_TIMER_COUNT
+}halTimer;
+
+/* Output pins */
+typedef enum{
+    HAL_PIN_POWER,        /* Rx: Power_Toggle */
+    HAL_PIN_COUNT_OUT,    /* Rx: Count_Out, last bit decision */
+    HAL_PIN_SLEEP_TOGGLE, /* Rx/Tx: sleepToggle, debug strobe */
+    HAL_PIN_HIGH_VOLTAGE, /* Tx: HighVoltage, boost converter enable */
+    HAL_PIN_SIGNAL_BASE,  /* Tx: SignalBase, transducer drive enable */
+    HAL_PIN_COUNT
+}halPin;
+
+/* HAL_UartRxStatus() flags */
+#define HAL_UART_RX_NOTEMPTY    0x01u
+#define HAL_UART_RX_BREAK       0x02u
+#define HAL_UART_RX_PAR_ERROR   0x04u
+#define HAL_UART_RX_STOP_ERROR  0x08u
+#define HAL_UART_RX_OVERRUN     0x10u
+#define HAL_UART_RX_ERRORS      (HAL_UART_RX_BREAK | HAL_UART_RX_PAR_ERROR | \
+                                 HAL_UART_RX_STOP_ERROR | HAL_UART_RX_OVERRUN)
+
+/* Interrupts */
+void HAL_IntEnable(void);
+void HAL_IsrStart(halIrq irq, halIsr handler);
+void HAL_IsrStop(halIrq irq);
+void HAL_IsrSetPending(halIrq irq);
+void HAL_IsrClearPending(halIrq irq);
+
+/* Timers */
+void HAL_TimerStart(halTimer timer);
+void HAL_TimerStop(halTimer timer);
+void HAL_TimerSleep(halTimer timer);
+void HAL_TimerWakeup(halTimer timer);
+
+/* Time, watchdog and power */
+void HAL_DelayMs(uint32 ms);
+void HAL_Idle(void);
+void HAL_WdtStart(void);
+void HAL_WdtClear(void);
+void HAL_SleepTimerStart(void);
+void HAL_SleepTimerStop(void);
+void HAL_SleepTimerClear(void);
+void HAL_SleepTimerSetInterval(uint16 ms);  /* rounded down to a power of two, 2 to 4096 ms */
+void HAL_SaveClocks(void);
+void HAL_RestoreClocks(void);
+void HAL_Sleep(void);
+
+/* CPU cycle counter, free running at BCLK__BUS_CLK__HZ and wrapping; it
+ * stops while the CPU sleeps. For profile.h.
+ */
+void HAL_CycleCounterStart(void);
+uint32 HAL_CycleCount(void);
+
+/* Pins */
+void HAL_PinWrite(halPin pin, uint8 value);
+
+/* Receiver front end: reconstruction PWM, shift register and comparator,
+ * and the hydrophone ADC. The ADC runs continuously into a ring buffer;
+ * HAL_AdcRead copies out the newest samples, oldest first, as signed values
+ * around mid-scale.
+ */
+#define HAL_ADC_SAMPLE_RATE     100000u /* Hz */
+#define HAL_ADC_RING_SIZE       1024u   /* most samples HAL_AdcRead can return */
+
+void HAL_FrontEndStart(void);
+void HAL_FrontEndSleep(void);
+void HAL_FrontEndWakeup(void);
+uint8 HAL_CompRead(void);
+uint16 HAL_AdcRead(int16 *samples, uint16 count);
+
+/* Transmitter modulator PWM */
+void HAL_PwmStart(void);
+void HAL_PwmStop(void);
+void HAL_PwmSetFrequency(uint32 hz);
+void HAL_PwmSleep(void);
+void HAL_PwmWakeup(void);
+
+/* UART */
+void HAL_UartStart(void);
+void HAL_UartSleep(void);
+void HAL_UartWakeup(void);
+void HAL_UartPutChar(uint8 byte);
+uint8 HAL_UartRxStatus(void);
+uint8 HAL_UartGetByte(void);
+
+/* Character LCD */
+void HAL_LcdStart(void);
+void HAL_LcdSleep(void);
+void HAL_LcdWakeup(void);
+void HAL_LcdClear(void);
+void HAL_LcdPosition(uint8 row, uint8 column);
+void HAL_LcdPrintString(const char8 *text);
+
+/* USB CDC (virtual COM port) */
+void HAL_UsbStart(void);
+uint8 HAL_UsbConfigChanged(void);
+uint8 HAL_UsbConfigured(void);
+void HAL_UsbCdcInit(void);
+uint8 HAL_UsbTxReady(void);
+void HAL_UsbPutData(const uint8 *data, uint16 length);
+uint8 HAL_UsbRxReady(void);
+uint16 HAL_UsbGetAll(uint8 *buffer);
+
+#endif /* HAL_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,39 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Link Rate
+ * Function: The ladder of symbol times the packet frame can be sent at. The
+ * sync word, the rate field after it and the post-fix always go at the base
+ * symbol time, so a receiver finds every message the same way and learns
+ * from the rate field how fast the frame that follows is:
+ *
+ *     sync word | rate field | frame (at the rate) | post-fix
+ *
+ * The rate field is the rate's LINK_RATE_BITS bits, MSB first, sent twice
+ * on the binary tones; the receiver adds up the two copies of each bit.
+ *
+ * There is no way back from the receiver to the trap. The receiver suggests
+ * a rate from how well the frames come in (USBFS_Rx/linkQuality.h), shows
+ * it on its LCD (r0>1) and sends it out its UART as a rate command. Nothing
+ * carries that byte to the trap: the operator types the rate into
+ * user_input (r1), which queues it with the counts and sends the rate
+ * command to the transmitter's UART, and the messages after it go at that
+ * rate. Rate commands can't be mistaken for crab counts, which stay below
+ * LINK_RATE_COMMAND.
+ * countLink.h has the other bytes on that UART.
+ * =============================================================================
+*/
+
+#ifndef LINK_RATE_H
+#define LINK_RATE_H
+
+#define LINK_RATE_BASE_MS       500u    // symbol time of rate 0 and of everything but the frame
+#define LINK_RATES              3u      // 500, 250 and 125 ms frame symbols
+#define LINK_RATE_BITS          2u
+#define LINK_RATE_FIELD_SYMBOLS (2u * LINK_RATE_BITS)
+#define LINK_RATE_DIVISOR(rate) (1u << (rate))  // frame symbols per base symbol time
+#define LINK_RATE_COMMAND       0x80u   // UART byte LINK_RATE_COMMAND | rate
+#define LINK_RATE_MASK          0x7Fu
+
+#endif /* LINK_RATE_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,36 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * M-ary FSK
+ * Function: Tone table and the Gray code mapping between symbols and tones.
+ * =============================================================================
+*/
+
+#include "mfsk.h"
+
+const uint32 mfskFreq[MFSK_TONES] = MFSK_TONE_TABLE;
+
+/*
+ * function: uint8 mfskTone(uint8 symbol)
+ * parameters: symbol - MFSK_BITS bits to send
+ * returns: the tone whose Gray code is the symbol
+ */
+uint8 mfskTone(uint8 symbol){
+    uint8 tone = symbol;
+
+    while(symbol != 0u){
+        symbol >>= 1;
+        tone ^= symbol;
+    }
+    return tone;
+}
+
+/*
+ * function: uint8 mfskSymbol(uint8 tone)
+ * parameters: tone - index into mfskFreq
+ * returns: the symbol the tone carries, its Gray code
+ */
+uint8 mfskSymbol(uint8 tone){
+    return (uint8)(tone ^ (tone >> 1));
+}
+
+/* [] END OF FILE */
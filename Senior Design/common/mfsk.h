@@ -0,0 +1,53 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * M-ary FSK
+ * Function: The tones the transmitter keys and the receiver listens for.
+ * With MFSK_ORDER tones each symbol of the packet frame carries
+ * MFSK_BITS bits; the sync word and post-fix stay one bit per symbol, sent
+ * on the lowest (0) and highest (1) tone, so finding a message works the
+ * same in every mode. At any one symbol time (linkRate.h picks the
+ * frame's) 4 tones send the frame in half the time and 8 tones in a third.
+ *
+ * Tones carry the Gray code of their index, so mistaking a tone for its
+ * neighbour costs one bit, and the top half of the tones all have the
+ * first bit set: the receiver's timing recovery watches that bit the way
+ * it watches mark against space in 2-tone mode.
+ *
+ * Both ends must be built with the same MFSK_ORDER.
+ * =============================================================================
+*/
+
+#ifndef MFSK_H
+#define MFSK_H
+
+#include "project.h"
+
+#ifndef MFSK_ORDER
+#define MFSK_ORDER          4   // tones: 2, 4 or 8
+#endif
+
+#if MFSK_ORDER == 2
+#define MFSK_BITS           1
+#define MFSK_TONE_TABLE     {37000u, 42000u}
+#elif MFSK_ORDER == 4
+#define MFSK_BITS           2
+#define MFSK_TONE_TABLE     {36000u, 38000u, 40000u, 42000u}
+#elif MFSK_ORDER == 8
+#define MFSK_BITS           3
+#define MFSK_TONE_TABLE     {35000u, 36000u, 37000u, 38000u, 39000u, 40000u, 41000u, 42000u}
+#else
+#error "MFSK_ORDER must be 2, 4 or 8"
+#endif
+
+#define MFSK_TONES          MFSK_ORDER
+#define MFSK_MARK           (MFSK_TONES - 1)    // tone of a 1 bit outside the frame
+#define MFSK_SPACE          0                   // tone of a 0 bit
+
+extern const uint32 mfskFreq[MFSK_TONES];   // Hz, lowest first
+
+uint8 mfskTone(uint8 symbol);
+uint8 mfskSymbol(uint8 tone);
+
+#endif /* MFSK_H */
+
+/* [] END OF FILE */
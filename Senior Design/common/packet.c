@@ -0,0 +1,134 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Packet
+ * Function: Frames a payload with its length and a CRC-8, and packs crab
+ * reports into payloads. The CRC is CRC-8/ATM (polynomial x^8 + x^2 + x + 1,
+ * bitwise, starting from 0): over a frame this short it catches every
+ * error of up to three bits and any single burst up to 8 bits long.
+ * =============================================================================
+*/
+
+#include "packet.h"
+
+#define CRC8_POLY           0x07u
+#define BYTE_MSB            0x80u
+
+/*
+ * function: uint8 packetCrc8(const uint8 *bytes, uint8 count)
+ * parameters: bytes - data to check, count - its length
+ * returns: the CRC-8 of the bytes
+ */
+uint8 packetCrc8(const uint8 *bytes, uint8 count){
+    uint8 crc = 0;
+    uint8 n, bit;
+
+    for(n = 0; n < count; n++){
+        crc ^= bytes[n];
+        for(bit = 0; bit < 8; bit++){
+            if((crc & BYTE_MSB) != 0u){
+                crc = (uint8)((crc << 1) ^ CRC8_POLY);
+            }else{
+                crc = (uint8)(crc << 1);
+            }
+        }
+    }
+    return crc;
+}
+
+/*
+ * function: uint8 packetBuild(const packet *message, uint8 *frame)
+ * parameters: message - payload to send, at most PACKET_MAX_PAYLOAD bytes
+ *             frame - filled with the frame, PACKET_MAX_FRAME bytes long
+ * returns: bytes in the frame
+ */
+uint8 packetBuild(const packet *message, uint8 *frame){
+    uint8 length = message->length;
+    uint8 n;
+
+    if(length > PACKET_MAX_PAYLOAD){
+        length = PACKET_MAX_PAYLOAD;
+    }
+    frame[0] = length;
+    for(n = 0; n < length; n++){
+        frame[1 + n] = message->payload[n];
+    }
+    frame[1 + length] = packetCrc8(frame, (uint8)(1 + length));
+    return PACKET_FRAME_BYTES(length);
+}
+
+/*
+ * function: uint8 packetCheck(const uint8 *frame, packet *message)
+ * parameters: frame - received frame, starting with its length byte
+ *             message - filled with the payload if the frame checks out
+ * returns: TRUE if the length is possible and the CRC matches
+ */
+uint8 packetCheck(const uint8 *frame, packet *message){
+    uint8 length = frame[0];
+    uint8 n;
+
+    if(length > PACKET_MAX_PAYLOAD){
+        return 0;
+    }
+    if(packetCrc8(frame, (uint8)(1 + length)) != frame[1 + length]){
+        return 0;
+    }
+    message->length = length;
+    for(n = 0; n < length; n++){
+        message->payload[n] = frame[1 + n];
+    }
+    return 1;
+}
+
+/*
+ * function: void reportToPacket(const crabReport *report, uint8 length, packet *message)
+ * parameters: report - what to send
+ *             length - REPORT_BASIC, REPORT_TIMED or REPORT_FULL
+ *             message - filled with the report's first length bytes
+ */
+void reportToPacket(const crabReport *report, uint8 length, packet *message){
+    uint8 bytes[REPORT_FULL];
+    uint8 n;
+
+    bytes[0] = report->trapId;
+    bytes[1] = report->crabs;
+    bytes[2] = (uint8)(report->minutes >> 8);
+    bytes[3] = (uint8)(report->minutes & 0xFFu);
+    bytes[4] = report->battery;
+    if(length > REPORT_FULL){
+        length = REPORT_FULL;
+    }
+    message->length = length;
+    for(n = 0; n < length; n++){
+        message->payload[n] = bytes[n];
+    }
+}
+
+/*
+ * function: uint8 reportFromPacket(const packet *message, crabReport *report)
+ * parameters: message - a checked packet
+ *             report - filled with the fields the packet has; the others
+ *             are REPORT_NO_TIME and REPORT_NO_BATTERY
+ * returns: TRUE if the packet holds at least a basic report
+ * description: Bytes past REPORT_FULL belong to fields a newer trap knows
+ * about and are skipped.
+ */
+uint8 reportFromPacket(const packet *message, crabReport *report){
+    const uint8 *bytes = message->payload;
+
+    if(message->length < REPORT_BASIC){
+        return 0;
+    }
+    report->trapId = bytes[0];
+    report->crabs = bytes[1];
+    report->minutes = REPORT_NO_TIME;
+    report->battery = REPORT_NO_BATTERY;
+    if(message->length >= REPORT_TIMED){
+        report->minutes = (uint16)((bytes[2] << 8) | bytes[3]);
+    }
+    if(message->length >= REPORT_FULL){
+        report->battery = bytes[4];
+    }
+    return 1;
+}
+
+/* [] END OF FILE */
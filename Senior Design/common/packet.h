@@ -0,0 +1,58 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Packet
+ * Function: What the transmitter sends between the sync word and the
+ * post-fix. A frame is a length byte, that many payload bytes and a CRC-8
+ * over both, each byte sent FEC coded (fec.h):
+ *
+ *     length | payload (0 to PACKET_MAX_PAYLOAD bytes) | CRC-8
+ *
+ * The payload of a trap is a crab report. Its fields go in a fixed order
+ * and a report may stop after any of the marked lengths, so a trap only
+ * sends what it knows:
+ *
+ *     trap ID | crabs || minutes (2, MSB first) || battery (0.1 V)
+ *              REPORT_BASIC    REPORT_TIMED      REPORT_FULL
+ *
+ * Shared by USBFS_Tx (packetBuild) and USBFS_Rx (packetCheck).
+ * =============================================================================
+*/
+
+#ifndef PACKET_H
+#define PACKET_H
+
+#include "project.h"
+
+#define PACKET_MAX_PAYLOAD  8
+#define PACKET_OVERHEAD     2   // length byte and CRC
+#define PACKET_MAX_FRAME    (PACKET_MAX_PAYLOAD + PACKET_OVERHEAD)
+#define PACKET_FRAME_BYTES(length)  ((length) + PACKET_OVERHEAD)
+
+// Crab report lengths
+#define REPORT_BASIC        2   // trap ID and crabs
+#define REPORT_TIMED        4   // and minutes since the trap started
+#define REPORT_FULL         5   // and battery voltage
+#define REPORT_NO_TIME      0xFFFFu // minutes of a report that left them out
+#define REPORT_NO_BATTERY   0xFFu   // battery of a report that left it out
+
+typedef struct{
+    uint8 length;                       // payload bytes
+    uint8 payload[PACKET_MAX_PAYLOAD];
+}packet;
+
+typedef struct{
+    uint8 trapId;
+    uint8 crabs;
+    uint16 minutes;     // since the trap started, wraps after 45 days
+    uint8 battery;      // 0.1 V
+}crabReport;
+
+uint8 packetCrc8(const uint8 *bytes, uint8 count);
+uint8 packetBuild(const packet *message, uint8 *frame);
+uint8 packetCheck(const uint8 *frame, packet *message);
+void reportToPacket(const crabReport *report, uint8 length, packet *message);
+uint8 reportFromPacket(const packet *message, crabReport *report);
+
+#endif /* PACKET_H */
+
+/* [] END OF FILE */
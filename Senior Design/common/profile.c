@@ -0,0 +1,143 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Profile
+ * Function: Per-slot run time statistics. Each slot is written by one ISR
+ * or by the main loop only, so profileAdd needs no locking; a dump can be
+ * off by the one run being added while it reads the slot.
+ * =============================================================================
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "profile.h"
+
+#ifdef PROFILE_ON
+
+#define PROFILE_BIN_SHIFT   2u  // bins are 4 times as wide as the one before
+#define PROFILE_DUMP_S      10u // profileDue, in seconds of CPU time
+
+typedef struct{
+    uint32 count;
+    uint32 min;
+    uint32 max;
+    uint64 total;
+    uint32 bins[PROFILE_BINS];
+}profileStats;
+
+static volatile profileStats stats[PROFILE_SLOTS];
+static const char8 *const *slotNames;
+static uint8 slots = 0;
+static uint32 lastCycles;   // counter when the elapsed time was last brought up to date
+static uint64 elapsed;      // cycles since profileInit
+static uint64 sinceDue;     // cycles since profileDue last said so
+
+// Starts the cycle counter and clears every slot; before the ISRs timed start
+void profileInit(const char8 *const *names, uint8 count){
+    uint8 slot;
+
+    HAL_CycleCounterStart();
+    slotNames = names;
+    slots = (count < PROFILE_SLOTS) ? count : PROFILE_SLOTS;
+    for(slot = 0; slot < PROFILE_SLOTS; slot++){
+        memset((void *)&stats[slot], 0, sizeof(stats[slot]));
+        stats[slot].min = 0xFFFFFFFFu;
+    }
+    lastCycles = HAL_CycleCount();
+    elapsed = 0;
+    sinceDue = 0;
+}
+
+/*
+ * function: void profileAdd(uint8 slot, uint32 cycles)
+ * parameters: slot - the firmware's, cycles - one run of it
+ * description: PROFILE_EXIT calls it. One ISR or the main loop per slot.
+ */
+void profileAdd(uint8 slot, uint32 cycles){
+    volatile profileStats *entry;
+    uint32 top = PROFILE_FIRST_BIN;
+    uint8 bin = 0;
+
+    if(slot >= slots){
+        return;
+    }
+    entry = &stats[slot];
+    entry->count++;
+    entry->total += cycles;
+    if(cycles < entry->min){
+        entry->min = cycles;
+    }
+    if(cycles > entry->max){
+        entry->max = cycles;
+    }
+    while((bin < PROFILE_BINS - 1u) && (cycles >= top)){
+        top <<= PROFILE_BIN_SHIFT;
+        bin++;
+    }
+    entry->bins[bin]++;
+}
+
+// Brings the elapsed time up to date; the counter wraps, so often enough
+static void profileTime(void){
+    uint32 now = HAL_CycleCount();
+    uint32 cycles = now - lastCycles;
+
+    lastCycles = now;
+    elapsed += cycles;
+    sinceDue += cycles;
+}
+
+/*
+ * function: uint8 profileDue(void)
+ * returns: TRUE once every PROFILE_DUMP_S seconds of CPU time
+ * description: For the main loop, to dump now and then. Call it at least
+ * once per wrap of the cycle counter.
+ */
+uint8 profileDue(void){
+    profileTime();
+    if(sinceDue < (uint64)BCLK__BUS_CLK__HZ * PROFILE_DUMP_S){
+        return 0;
+    }
+    sinceDue = 0;
+    return 1;
+}
+
+/*
+ * function: void profileDump(profileOut out)
+ * parameters: out - gets the lines, a header and one per slot that ran
+ * description: Times are in cycles, at BCLK__BUS_CLK__HZ. Load is the
+ * slot's share of the cycles since profileInit, in tenths of a percent.
+ * hist counts the runs below PROFILE_FIRST_BIN cycles, below 4 times
+ * that, and so on; the last bin takes the rest.
+ */
+void profileDump(profileOut out){
+    char8 line[PROFILE_LINE];
+    profileStats entry;
+    uint32 load;
+    uint8 slot;
+    uint8 bin;
+    int used;
+
+    profileTime();
+    sprintf(line, "# profile %lu ms of CPU at %lu Hz", (unsigned long)(elapsed * 1000u / BCLK__BUS_CLK__HZ),
+        (unsigned long)BCLK__BUS_CLK__HZ);
+    out(line);
+    for(slot = 0; slot < slots; slot++){
+        memcpy(&entry, (const void *)&stats[slot], sizeof(entry));
+        if(entry.count == 0u){
+            continue;
+        }
+        load = (elapsed > 0u) ? (uint32)(entry.total * 1000u / elapsed) : 0u;
+        used = sprintf(line, "# %-14s n %lu min %lu mean %lu max %lu load %lu.%lu%% hist",
+            slotNames[slot], (unsigned long)entry.count, (unsigned long)entry.min,
+            (unsigned long)(entry.total / entry.count), (unsigned long)entry.max,
+            (unsigned long)(load / 10u), (unsigned long)(load % 10u));
+        for(bin = 0; bin < PROFILE_BINS; bin++){
+            used += sprintf(&line[used], " %lu", (unsigned long)entry.bins[bin]);
+        }
+        out(line);
+    }
+}
+
+#endif /* PROFILE_ON */
+
+/* [] END OF FILE */
@@ -0,0 +1,50 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Profile
+ * Function: Times ISRs and main loop phases with the CPU's free running
+ * cycle counter (HAL_CycleCount) and keeps, per slot, how often it ran,
+ * the shortest, mean and longest run and a histogram of run times. Each
+ * firmware numbers its own slots and names them in profileInit.
+ *
+ * Built in only with PROFILE_ON; without it the PROFILE_ macros are empty
+ * and nothing here is linked. Define it below or in the compiler options
+ * (sim: make clean && make PROFILE=1).
+ *
+ * An ISR's time includes the ISRs that preempted it. The cycle counter
+ * stops while the CPU sleeps, so the load is a share of the time awake.
+ * =============================================================================
+*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "project.h"
+#include "hal.h"
+
+//#define PROFILE_ON
+
+#define PROFILE_SLOTS       8u      // most slots a firmware can have
+#define PROFILE_BINS        8u      // histogram bins, each 4 times as wide
+#define PROFILE_FIRST_BIN   64u     // cycles, top of the first bin
+#define PROFILE_LINE        200u    // longest line profileDump writes
+
+/* Line sink for profileDump, without line ending */
+typedef void (*profileOut)(const char8 *line);
+
+#ifdef PROFILE_ON
+/* Both in the same block; a slot can be timed once per block */
+#define PROFILE_ENTER(slot)     uint32 profileStart_##slot = HAL_CycleCount()
+#define PROFILE_EXIT(slot)      profileAdd((slot), HAL_CycleCount() - profileStart_##slot)
+
+void profileInit(const char8 *const *names, uint8 count);
+void profileAdd(uint8 slot, uint32 cycles);
+uint8 profileDue(void);
+void profileDump(profileOut out);
+#else
+#define PROFILE_ENTER(slot)
+#define PROFILE_EXIT(slot)
+#endif /* PROFILE_ON */
+
+#endif /* PROFILE_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,19 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Sync Word
+ * Function: The sequence USBFS_Tx sends at the start of every message and
+ * USBFS_Rx correlates against to find it. A Barker code: against any shifted
+ * copy of itself it matches at most one bit more than it mismatches, so a
+ * partly received or noisy sync word is still far from a false lock.
+ * =============================================================================
+*/
+
+#ifndef SYNC_WORD_H
+#define SYNC_WORD_H
+
+#define SYNC_WORD       0x1F35u // Barker-13, 1111100110101, sent MSB first
+#define SYNC_LENGTH     13      // bits
+
+#endif /* SYNC_WORD_H */
+
+/* [] END OF FILE */
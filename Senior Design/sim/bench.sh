@@ -0,0 +1,152 @@
+#!/bin/sh
+# =============================================================================
+# Smart Crab Trap
+# Link benchmark
+# Function: Sends MESSAGES crab counts through tx_sim, then decodes the tone
+# trace with rx_sim once per SNR over the simulated channel, and prints one
+# line per SNR:
+#
+#   sync     copies whose sync word was found, of the first copy of each message
+#   copy FER first copies that did not decode to the count sent, alone
+#   BER      bits the FEC corrected over the coded bits of the first copies
+#            that decoded, an estimate of the raw bit error rate
+#   msg FER  messages whose first result was missing or wrong
+#   wrong    results with a count other than the one sent (passed the CRC)
+#   copies   copies combined for the first result, on average
+#   acq s    first tone to sync found, on average (the sync word is 6.5 s)
+#   us/tick  host CPU per Bit_Timer interrupt, less the channel model
+#
+# Every message starts fresh: the counts are spaced SPACING seconds apart,
+# long enough for the receiver to give up on the last copies in between.
+#
+# usage: ./bench.sh [--snr "DB DB ..."] [--messages N] [--clock-ppm PPM]
+#                   [--echo MS:GAIN]... [--doppler M_PER_S] [--seed N]
+# Run make first. The channel options are the ones of halSim.c.
+# =============================================================================
+
+SNRS="9 6 3 0 -3 -6 -9 -12"
+MESSAGES=10
+SPACING=150         # s between counts, a burst of 3 copies takes about 100
+FIRST_COUNT=10      # counts sent are FIRST_COUNT, FIRST_COUNT + 1, ...
+CODED_BITS=84       # REPORT_TIMED frame: 6 bytes of FEC_CODED_BITS
+TX_OPTIONS=""
+RX_OPTIONS=""
+
+while [ $# -gt 1 ]; do
+    case "$1" in
+        --snr) SNRS="$2" ;;
+        --messages) MESSAGES="$2" ;;
+        --clock-ppm) TX_OPTIONS="$TX_OPTIONS --clock-ppm $2" ;;
+        --echo|--doppler|--seed) RX_OPTIONS="$RX_OPTIONS $1 $2" ;;
+        *) break ;;
+    esac
+    shift 2
+done
+if [ $# -gt 0 ]; then
+    sed -n 's/^# usage: //p;s/^#                   /    /p' "$0" >&2
+    exit 1
+fi
+for sim in tx_sim rx_sim; do
+    if [ ! -x "./$sim" ]; then
+        echo "bench.sh: no ./$sim, run make first" >&2
+        exit 1
+    fi
+done
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+TIME=$(( (MESSAGES + 1) * SPACING ))
+
+# The first count arrives during the transmitter's start-up delay
+n=0
+while [ $n -lt "$MESSAGES" ]; do
+    echo "$(( 1000 + n * SPACING * 1000 )) $(( FIRST_COUNT + n ))"
+    n=$(( n + 1 ))
+done > "$WORK/uart.txt"
+./tx_sim --time $TIME $TX_OPTIONS --uart-in "$WORK/uart.txt" --trace "$WORK/tone.txt" > /dev/null
+
+echo "channel:${RX_OPTIONS:- none}${TX_OPTIONS}, $MESSAGES messages"
+printf "%6s %6s %8s %8s %8s %6s %6s %6s %8s\n" \
+    "SNR dB" "sync" "copy FER" "BER" "msg FER" "wrong" "copies" "acq s" "us/tick"
+for snr in $SNRS; do
+    ./rx_sim --time $TIME --comp "$WORK/tone.txt" --snr "$snr" $RX_OPTIONS > "$WORK/rx.txt"
+    awk -v snr="$snr" -v first="$FIRST_COUNT" -v coded="$CODED_BITS" '
+        # Tone trace: copies start on a tone after silence, messages after
+        # more than the gap between copies
+        FNR == NR {
+            t = $1 / 1e6
+            if ($2 > 0 && silent) {
+                if (messages == 0 || t - silentSince > 2) {
+                    start[messages++] = t
+                } else if (!(messages - 1 in second)) {
+                    second[messages - 1] = t
+                }
+            }
+            if ($2 == 0 && !silent) {
+                silentSince = t
+            }
+            silent = ($2 == 0)
+            next
+        }
+        # Receiver output: which message and copy each line is about
+        FNR == 1 {
+            silent = 1
+            for (m = 0; m < messages; m++) {
+                if (!(m in second)) {
+                    second[m] = (m + 1 < messages) ? start[m + 1] : 1e12
+                }
+            }
+            start[messages] = 1e12
+        }
+        /LCD 0 \|/ {
+            t = substr($0, 2, index($0, "]") - 2) + 0
+            text = substr($0, index($0, "|") + 1)
+            sub(/ *\|$/, "", text)
+            for (m = messages - 1; m >= 0 && start[m] > t; m--) {
+            }
+            if (m < 0) {
+                next
+            }
+            firstCopy = (t < second[m])
+            if (text == "sync found" && firstCopy && !(m in acquired)) {
+                acquired[m] = t - start[m]
+            } else if (text ~ /^(Crabs|CRC bad)/ && firstCopy && !(m in decoded)) {
+                decoded[m] = (text ~ ("^Crabs:" (first + m) " "))
+                if (decoded[m]) {
+                    split(text, field, "Err:")
+                    corrected += field[2]
+                }
+            } else if (text ~ /^T[0-9]+ crabs:/) {
+                split(substr(text, index(text, ":") + 1), field, " x")
+                if (field[1] != first + m) {
+                    wrong++
+                }
+                if (!(m in result)) {
+                    result[m] = (field[1] == first + m)
+                    copies += field[2] + 0
+                }
+            }
+        }
+        /BIT_TIMER/ {
+            split($0, field, ", ")
+            tick = field[2] + 0
+        }
+        END {
+            for (m = 0; m < messages; m++) {
+                if (m in acquired) {
+                    synced++
+                    acquisition += acquired[m]
+                }
+                good += ((m in decoded) && decoded[m])
+                delivered += ((m in result) && result[m])
+                results += (m in result)
+            }
+            printf "%6s %5.0f%% %8.2f %8s %8.2f %6d %6s %6s %8.2f\n", snr,
+                100 * synced / messages, 1 - good / messages,
+                good ? sprintf("%.4f", corrected / (good * coded)) : "-",
+                1 - delivered / messages, wrong,
+                results ? sprintf("%.1f", copies / results) : "-",
+                synced ? sprintf("%.1f", acquisition / synced) : "-", tick
+        }
+    ' "$WORK/tone.txt" "$WORK/rx.txt"
+done
@@ -0,0 +1,1140 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Linux simulation of the hardware abstraction layer
+ * Function: Implements ../common/hal.h with a simulated microsecond clock and
+ * provides main(), which parses the options below and then calls the
+ * firmware's main() (renamed firmwareMain by the Makefile).
+ *
+ * Every HAL call costs HAL_CALL_US of simulated time; HAL_DelayMs, HAL_Idle
+ * and HAL_Sleep skip ahead. Timers latch their interrupt when they expire and
+ * pending interrupts run in priority order (lowest halIrq first) as soon as
+ * the firmware makes its next HAL call outside of an ISR. ISRs don't nest.
+ * While asleep only the sleep timer and the UART wake interrupt run.
+ * The watchdog never resets, it prints a warning when a clear was missed.
+ *
+ * Build one binary per firmware with -DSIM_RX, -DSIM_TX or -DSIM_UI.
+ *
+ * Options:
+ *  --time SECONDS     simulated run time (default 60)
+ *  --comp FILE        Rx: tone at the hydrophone, lines of "t_us freq_hz".
+ *                     Drives both the comparator and the ADC
+ *  --snr DB           Rx: white noise added to the ADC samples, tone power
+ *                     to noise power over the whole ADC band (default none)
+ *  --echo MS:GAIN     Rx: adds a copy of the tone MS milliseconds late at GAIN
+ *                     times the amplitude (negative inverts it), for multipath.
+ *                     Up to SIM_MAX_ECHOES of them
+ *  --doppler M_PER_S  Rx: the transmitter closes in (+) or moves away at this
+ *                     speed. Tones and symbol times scale by 1 + v / 1500 m/s
+ *  --seed N           Rx: start of the noise sequence (default 1)
+ *  --adc-in FILE      Rx: ADC samples from a 16-bit mono WAV file (render
+ *                     makes them from a --trace), instead of --comp. Full
+ *                     scale is the ADC's, other sample rates are interpolated.
+ *                     --snr noise and --doppler apply, --echo doesn't, and
+ *                     --time defaults to the length of the file
+ *  --adc-rate HZ      Rx: --adc-in is raw little-endian samples at this rate
+ *  --trace FILE       Tx: writes the transmitted tone in the same format
+ *  --clock-ppm PPM    error of this PSoC's clock: timers, the sleep timer and
+ *                     delays all run PPM parts per million slow (+) or fast
+ *  --uart-in FILE     bytes arriving on the UART, lines of "t_ms byte"
+ *  --uart-out FILE    writes the bytes sent on the UART in the same format
+ *  --usb-in FILE      user_input: packets from the terminal, "t_ms text"
+ *                     (\r, \n and \b in the text are CR, LF and backspace)
+ *  --usb-stall FROM_MS:TO_MS
+ *                     user_input: the terminal reads nothing in between, as
+ *                     if the laptop slept; the IN endpoint stays busy
+ *  --verbose          also log pins, interrupts and sleep
+ *
+ * At exit it prints the host CPU time each interrupt took, less the time
+ * spent synthesizing ADC samples, as a measure of what the firmware costs.
+ * Built with PROFILE_ON (make PROFILE=1) it also prints the firmware's own
+ * profile.h statistics, counted in host CPU time at the PSoC's bus clock.
+ * =============================================================================
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include "hal.h"
+#include "profile.h"
+#include "wavFile.h"
+
+#if defined(SIM_RX)
+    #define SIM_NAME            "rx_sim"
+    #define SLEEP_TIMER_US      8000u       /* SleepTimer, 8 ms */
+    #define WDT_TIMEOUT_US      32000u      /* CYWDT_16_TICKS, shortest case */
+    #define WDT_RUNS_IN_SLEEP   0           /* CYWDT_LPMODE_DISABLED */
+    static const uint32 timerPeriodUs[HAL_TIMER_COUNT] = {5000u, 0u, 0u, 20000u};
+#elif defined(SIM_TX)
+    #define SIM_NAME            "tx_sim"
+    #define SLEEP_TIMER_US      1024000u    /* SleepTimer, 1.024 s */
+    #define WDT_TIMEOUT_US      2048000u    /* CYWDT_1024_TICKS, shortest case */
+    #define WDT_RUNS_IN_SLEEP   1           /* CYWDT_LPMODE_NOCHANGE */
+    static const uint32 timerPeriodUs[HAL_TIMER_COUNT] = {0u, 125000u, 0u, 1400000u};
+#elif defined(SIM_UI)
+    #define SIM_NAME            "ui_sim"
+    #define SLEEP_TIMER_US      1024000u
+    #define WDT_TIMEOUT_US      0u          /* no watchdog */
+    #define WDT_RUNS_IN_SLEEP   0
+    static const uint32 timerPeriodUs[HAL_TIMER_COUNT] = {0u, 0u, 1024000u, 0u};
+#else
+    #error "Build with -DSIM_RX, -DSIM_TX or -DSIM_UI (see Makefile)"
+#endif
+
+#define TRUE                1u
+#define FALSE               0u
+#define HAL_CALL_US         1u
+#define NEVER               UINT64_MAX
+#define LCD_ROWS            2u
+#define LCD_COLUMNS         20u
+#define UART_FIFO_SIZE      4u
+#define USB_PACKET_SIZE     64u
+#define USB_LINE_SIZE       256u
+#define RX_CENTER_HZ        42000u  /* receiver band-pass, ONE_FREQ */
+#define RX_BANDWIDTH_HZ     2000u
+#define ADC_AMPLITUDE       1000.0  /* tone peak in ADC counts, 12-bit ADC */
+#define ADC_MAX             2047
+#define SIM_MAX_ECHOES      4u
+#define SOUND_M_PER_S       1500.0  /* in sea water */
+#define ADC_IN_WINDOW       8192u   /* --adc-in samples kept, a ring read at any rate up to 800 kHz */
+#define ADC_IN_SCALE        16.0    /* 16-bit file to 12-bit ADC */
+
+int firmwareMain(void);
+
+static const char *irqNames[HAL_IRQ_COUNT] = {
+    "BIT_TIMER", "SYMBOL", "UART_RX", "UART_WAKE", "TX_DONE", "SLEEP", "WDT_CHECK"
+};
+static const halIrq timerIrq[HAL_TIMER_COUNT] = {
+    HAL_IRQ_BIT_TIMER, HAL_IRQ_SYMBOL, HAL_IRQ_TX_DONE, HAL_IRQ_WDT_CHECK
+};
+static const char *pinNames[HAL_PIN_COUNT] = {
+    "POWER", "COUNT_OUT", "SLEEP_TOGGLE", "HIGH_VOLTAGE", "SIGNAL_BASE"
+};
+
+typedef struct{
+    uint8 running;
+    uint8 asleep;
+    uint64_t next;      /* time of the next expiry, us */
+}simTimer;
+
+/* Input files, loaded whole at startup */
+typedef struct{
+    uint64_t time;      /* us */
+    uint32 value;       /* tone in Hz or UART byte */
+}simSample;
+
+typedef struct{
+    uint64_t time;      /* us */
+    uint8 data[USB_PACKET_SIZE];
+    uint16 length;
+}simPacket;
+
+/* Clock and interrupts */
+static uint64_t now;
+static uint64_t endTime = 60000000u;
+static uint8 intEnabled;
+static uint8 inIsr;
+static uint8 sleeping;
+static halIsr handlers[HAL_IRQ_COUNT];
+static uint8 pending[HAL_IRQ_COUNT];
+static uint32 isrCount[HAL_IRQ_COUNT];
+static uint64_t isrNs[HAL_IRQ_COUNT];  /* host CPU time in each ISR */
+static uint64_t channelNs;              /* host CPU time synthesizing ADC samples */
+static uint64_t hostStartNs;
+
+/* Timers, watchdog and power */
+static simTimer timers[HAL_TIMER_COUNT];
+static simTimer sleepTimer;
+static uint32 sleepTimerUs = SLEEP_TIMER_US;
+static uint8 wdtRunning;
+static uint64_t wdtDeadline;
+static uint32 wdtMisses;
+static uint64_t sleepUs;
+static uint64_t idleUs;
+static uint32 sleepCount;
+static uint8 pins[HAL_PIN_COUNT];
+
+/* Peripherals */
+static uint8 frontEndOn;
+static uint64_t frontEndSince;          /* when it last came on */
+static uint64_t frontEndUs;             /* time it was on before that */
+static uint8 pwmRunning;
+static uint8 pwmAsleep;
+static uint32 pwmHz;
+static uint32 lastTone;
+static uint8 uartAsleep;
+static uint8 uartFifo[UART_FIFO_SIZE];
+static uint8 uartFifoCount;
+static uint8 uartErrors;
+static uint32 uartSent;
+static char8 lcd[LCD_ROWS][LCD_COLUMNS + 1u];
+static uint8 lcdRow;
+static uint8 lcdColumn;
+static uint8 usbStarted;
+static uint8 usbEnumerated;
+static char8 usbLine[USB_LINE_SIZE];
+static uint16 usbLineLength;
+
+/* Inputs and outputs */
+static simSample *compTrace;
+static uint32 compCount;
+static double clockScale = 1.0;
+static double noiseSigma;
+static uint32 noiseSeed = 1u;
+static double echoDelayUs[SIM_MAX_ECHOES];
+static double echoGain[SIM_MAX_ECHOES];
+static uint32 echoCount;
+static double dopplerScale = 1.0;   /* transmitter time per receiver time */
+static FILE *adcIn;
+static uint32_t adcInRate;
+static uint32_t adcInSamples;       /* in the file, WAV_UNKNOWN_LENGTH until its end */
+static long adcInStart;             /* file offset of the first sample */
+static int16 adcInWindow[ADC_IN_WINDOW];
+static uint64_t adcInNext;          /* index of the next sample to read from the file */
+static simSample *uartIn;
+static uint32 uartInCount;
+static uint32 uartInCursor;
+static simPacket *usbIn;
+static uint32 usbInCount;
+static uint32 usbInCursor;
+static uint64_t usbStallFrom;       /* us, the terminal reads nothing until usbStallTo */
+static uint64_t usbStallTo;
+static FILE *traceOut;
+static FILE *uartOut;
+static int verbose;
+
+static void simLog(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+// Prints one line prefixed with the simulated time in seconds
+static void simLog(const char *format, ...){
+    va_list args;
+    printf("[%11.6f] ", now / 1e6);
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+}
+
+static uint64_t cpuNs(void);
+static void setFrontEnd(uint8 on);
+
+#ifdef PROFILE_ON
+static void profileLine(const char8 *line){
+    printf("  %s\n", line);
+}
+#endif
+
+static void simFinish(void){
+    double hostSeconds = (cpuNs() - hostStartNs) / 1e9;
+    int irq;
+
+    if(usbLineLength > 0u){
+        simLog("USB> %s", usbLine);
+    }
+    printf("%s: %.6f s simulated, %.1f%% asleep, %.1f%% idle, %u sleeps\n", SIM_NAME,
+        now / 1e6, 100.0 * sleepUs / (now ? now : 1), 100.0 * idleUs / (now ? now : 1),
+        sleepCount);
+    printf("  host       %.3f s CPU, %.0fx real time\n", hostSeconds,
+        now / 1e6 / (hostSeconds > 0.0 ? hostSeconds : 1e-9));
+    for(irq = 0; irq < HAL_IRQ_COUNT; irq++){
+        if(isrCount[irq] > 0u){
+            printf("  %-10s %u interrupts, %.2f us host CPU each\n", irqNames[irq],
+                isrCount[irq], isrNs[irq] / 1e3 / isrCount[irq]);
+        }
+    }
+    if(frontEndOn || frontEndUs > 0u){
+        setFrontEnd(FALSE);
+        printf("  front end  on %.1f%% of the time\n", 100.0 * frontEndUs / (now ? now : 1));
+    }
+    if(WDT_TIMEOUT_US > 0u){
+        printf("  watchdog   %u missed clears\n", wdtMisses);
+    }
+    if(uartSent > 0u){
+        printf("  uart       %u bytes sent\n", uartSent);
+    }
+#ifdef PROFILE_ON
+    profileDump(profileLine);
+#endif
+    if(traceOut != NULL){
+        fclose(traceOut);
+    }
+    if(uartOut != NULL){
+        fclose(uartOut);
+    }
+    fflush(stdout);
+    exit(0);
+}
+
+// Real time taken by an interval of 'us' on this PSoC's clock
+static uint64_t clockUs(uint64_t us){
+    return (uint64_t)(us * clockScale + 0.5);
+}
+
+// Latches an interrupt if its ISR is started, which also ends sleep
+static void latch(halIrq irq){
+    if(handlers[irq] != NULL){
+        pending[irq] = TRUE;
+        sleeping = FALSE;
+    }
+}
+
+static void uartReceive(uint8 byte){
+    if(verbose){
+        simLog("UART rx 0x%02X", byte);
+    }
+    if(uartFifoCount < UART_FIFO_SIZE){
+        uartFifo[uartFifoCount++] = byte;
+    }else{
+        uartErrors |= HAL_UART_RX_OVERRUN;
+    }
+    // The wake interrupt sits on the RX pin, the UART itself only runs awake
+    latch(HAL_IRQ_UART_WAKE);
+    if(!uartAsleep){
+        latch(HAL_IRQ_UART_RX);
+    }
+}
+
+// Time of the next thing that can happen without the firmware doing anything
+static uint64_t nextEvent(void){
+    uint64_t next = NEVER;
+    int t;
+
+    if(!sleeping){
+        for(t = 0; t < HAL_TIMER_COUNT; t++){
+            if(timers[t].running && !timers[t].asleep && timers[t].next < next){
+                next = timers[t].next;
+            }
+        }
+    }
+    if(sleepTimer.running && sleepTimer.next < next){
+        next = sleepTimer.next;
+    }
+    if(wdtRunning && (!sleeping || WDT_RUNS_IN_SLEEP) && wdtDeadline < next){
+        next = wdtDeadline;
+    }
+    if(uartInCursor < uartInCount && uartIn[uartInCursor].time < next){
+        next = uartIn[uartInCursor].time;
+    }
+    return next;
+}
+
+// Latches everything that is due at 'now'
+static void fireEvents(void){
+    uint8 asleep = sleeping;    // a wakeup below doesn't start the frozen clocks yet
+    int t;
+
+    if(!asleep){
+        for(t = 0; t < HAL_TIMER_COUNT; t++){
+            simTimer *timer = &timers[t];
+            if(timer->running && !timer->asleep && timer->next <= now){
+                latch(timerIrq[t]);
+                // A late ISR misses expiries, the interrupt only latches once
+                while(timer->next <= now){
+                    timer->next += clockUs(timerPeriodUs[t]);
+                }
+            }
+        }
+    }
+    if(sleepTimer.running && sleepTimer.next <= now){
+        latch(HAL_IRQ_SLEEP);
+        while(sleepTimer.next <= now){
+            sleepTimer.next += clockUs(sleepTimerUs);
+        }
+    }
+    if(wdtRunning && (!asleep || WDT_RUNS_IN_SLEEP) && wdtDeadline <= now){
+        wdtMisses++;
+        simLog("WATCHDOG not cleared in time, the PSoC would reset here");
+        wdtDeadline = now + WDT_TIMEOUT_US;
+    }
+    while(uartInCursor < uartInCount && uartIn[uartInCursor].time <= now){
+        uartReceive((uint8)uartIn[uartInCursor++].value);
+    }
+}
+
+// Host CPU time, ns
+static uint64_t cpuNs(void){
+    struct timespec clock;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &clock);
+    return (uint64_t)clock.tv_sec * 1000000000u + (uint64_t)clock.tv_nsec;
+}
+
+static void dispatch(void){
+    int irq = 0;
+    uint64_t start, channel;
+
+    if(inIsr || !intEnabled || sleeping){
+        return;
+    }
+    while(irq < HAL_IRQ_COUNT){
+        if(pending[irq] && handlers[irq] != NULL){
+            pending[irq] = FALSE;
+            isrCount[irq]++;
+            inIsr = TRUE;
+            channel = channelNs;
+            start = cpuNs();
+            handlers[irq]();
+            isrNs[irq] += cpuNs() - start - (channelNs - channel);
+            inIsr = FALSE;
+            irq = 0; // highest priority first again
+        }else{
+            irq++;
+        }
+    }
+}
+
+// Moves the clock to 'target', running any interrupt that comes due on the way
+static void advanceTo(uint64_t target){
+    uint64_t event;
+
+    while((event = nextEvent()) <= target){
+        if(event > now){
+            now = event;
+        }
+        if(now >= endTime){
+            simFinish();
+        }
+        fireEvents();
+        dispatch();
+    }
+    if(target > now){
+        now = target;
+    }
+    if(now >= endTime){
+        simFinish();
+    }
+}
+
+static void tick(void){
+    advanceTo(now + HAL_CALL_US);
+}
+
+// Tone on the transducer: modulator running and its drive enabled
+static void updateTone(void){
+    uint32 tone = (pwmRunning && !pwmAsleep && pins[HAL_PIN_SIGNAL_BASE]) ? pwmHz : 0u;
+
+    if(tone != lastTone){
+        lastTone = tone;
+        if(traceOut != NULL){
+            fprintf(traceOut, "%llu %u\n", (unsigned long long)now, tone);
+        }
+        if(verbose){
+            simLog("TONE %u Hz", tone);
+        }
+    }
+}
+
+/* Interrupts */
+void HAL_IntEnable(void){
+    intEnabled = TRUE;
+    tick();
+}
+
+void HAL_IsrStart(halIrq irq, halIsr handler){
+    handlers[irq] = handler;
+    tick();
+}
+
+void HAL_IsrStop(halIrq irq){
+    handlers[irq] = NULL;
+    pending[irq] = FALSE;
+    tick();
+}
+
+void HAL_IsrSetPending(halIrq irq){
+    pending[irq] = TRUE;
+    tick();
+}
+
+void HAL_IsrClearPending(halIrq irq){
+    pending[irq] = FALSE;
+    tick();
+}
+
+/* Timers */
+void HAL_TimerStart(halTimer timer){
+    if(!timers[timer].running || timers[timer].asleep){
+        timers[timer].next = now + clockUs(timerPeriodUs[timer]);
+    }
+    timers[timer].running = (timerPeriodUs[timer] > 0u);
+    timers[timer].asleep = FALSE;
+    tick();
+}
+
+void HAL_TimerStop(halTimer timer){
+    timers[timer].running = FALSE;
+    tick();
+}
+
+void HAL_TimerSleep(halTimer timer){
+    timers[timer].asleep = TRUE;
+    tick();
+}
+
+void HAL_TimerWakeup(halTimer timer){
+    if(timers[timer].asleep){
+        timers[timer].asleep = FALSE;
+        timers[timer].next = now + clockUs(timerPeriodUs[timer]);
+    }
+    tick();
+}
+
+/* Time, watchdog and power */
+void HAL_DelayMs(uint32 ms){
+    advanceTo(now + clockUs((uint64_t)ms * 1000u));
+}
+
+void HAL_CycleCounterStart(void){
+}
+
+// Host CPU time the firmware took, as bus clock cycles; costs no simulated time
+uint32 HAL_CycleCount(void){
+    return (uint32)((cpuNs() - channelNs) * (BCLK__BUS_CLK__HZ / 1000000u) / 1000u);
+}
+
+// Waits for the next event, like a WFI
+void HAL_Idle(void){
+    uint64_t start = now;
+    uint64_t event = nextEvent();
+
+    if(event == NEVER){
+        event = endTime;
+    }
+    advanceTo((event > now + HAL_CALL_US) ? event : now + HAL_CALL_US);
+    idleUs += now - start;
+}
+
+void HAL_WdtStart(void){
+    wdtRunning = (WDT_TIMEOUT_US > 0u);
+    wdtDeadline = now + WDT_TIMEOUT_US;
+    tick();
+}
+
+void HAL_WdtClear(void){
+    wdtDeadline = now + WDT_TIMEOUT_US;
+    tick();
+}
+
+void HAL_SleepTimerStart(void){
+    if(!sleepTimer.running){
+        sleepTimer.running = TRUE;
+        sleepTimer.next = now + clockUs(sleepTimerUs);
+    }
+    tick();
+}
+
+void HAL_SleepTimerStop(void){
+    sleepTimer.running = FALSE;
+    tick();
+}
+
+void HAL_SleepTimerClear(void){
+    tick();
+}
+
+// Powers of two from 2 to 4096 ms, like the SleepTimer's settings
+void HAL_SleepTimerSetInterval(uint16 ms){
+    sleepTimerUs = 2000u;
+    while(sleepTimerUs < 4096000u && sleepTimerUs * 2u <= ms * 1000u){
+        sleepTimerUs *= 2u;
+    }
+    tick();
+}
+
+void HAL_SaveClocks(void){
+    tick();
+}
+
+void HAL_RestoreClocks(void){
+    tick();
+}
+
+/*
+ * function: void HAL_Sleep(void)
+ * description: Skips to the first wake source, with every other timer (and the
+ * Rx watchdog) frozen, then runs the interrupt that woke it up. Returns right
+ * away if an interrupt is already pending.
+ */
+void HAL_Sleep(void){
+    uint64_t start = now;
+    uint64_t event;
+    int irq;
+    int t;
+
+    sleeping = TRUE;
+    for(irq = 0; irq < HAL_IRQ_COUNT; irq++){
+        if(pending[irq] && handlers[irq] != NULL){
+            sleeping = FALSE;
+        }
+    }
+    if(verbose && sleeping){
+        simLog("SLEEP");
+    }
+    while(sleeping){
+        event = nextEvent();
+        now = (event == NEVER || event > endTime) ? endTime : (event > now ? event : now);
+        if(now >= endTime){
+            sleepCount++;
+            sleepUs += now - start;
+            simFinish();
+        }
+        fireEvents();
+    }
+    for(t = 0; t < HAL_TIMER_COUNT; t++){
+        timers[t].next += now - start;
+    }
+    if(!WDT_RUNS_IN_SLEEP){
+        wdtDeadline += now - start;
+    }
+    if(now > start){
+        sleepCount++;
+        sleepUs += now - start;
+        if(verbose){
+            simLog("WAKE after %.3f ms", (now - start) / 1e3);
+        }
+    }
+    dispatch();
+    tick();
+}
+
+/* Pins */
+static void setPin(halPin pin, uint8 value){
+    if(pins[pin] != value && verbose){
+        simLog("PIN %s = %u", pinNames[pin], value);
+    }
+    pins[pin] = value;
+    updateTone();
+}
+
+void HAL_PinWrite(halPin pin, uint8 value){
+    setPin(pin, value);
+    tick();
+}
+
+/* Receiver front end */
+static void setFrontEnd(uint8 on){
+    if(on && !frontEndOn){
+        frontEndSince = now;
+    }else if(!on && frontEndOn){
+        frontEndUs += now - frontEndSince;
+    }
+    frontEndOn = on;
+}
+
+void HAL_FrontEndStart(void){
+    setFrontEnd(TRUE);
+    tick();
+}
+
+void HAL_FrontEndSleep(void){
+    setFrontEnd(FALSE);
+    tick();
+}
+
+void HAL_FrontEndWakeup(void){
+    setFrontEnd(TRUE);
+    tick();
+}
+
+// Tone from --comp at time t (us), 0 for silence
+static uint32 toneAt(double t){
+    uint32 low = 0u;
+    uint32 high = compCount;
+
+    while(low < high){
+        uint32 mid = (low + high) / 2u;
+        if(compTrace[mid].time <= t){
+            low = mid + 1u;
+        }else{
+            high = mid;
+        }
+    }
+    return (low > 0u) ? compTrace[low - 1u].value : 0u;
+}
+
+// Standard normal deviate (Box-Muller), repeatable from run to run
+static double gaussian(void){
+    double u1 = (rand_r(&noiseSeed) + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand_r(&noiseSeed) + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+// High while the tone from --comp is inside the receiver's band
+uint8 HAL_CompRead(void){
+    uint32 tone;
+
+    tick();
+    tone = (uint32)(toneAt(now * dopplerScale) * dopplerScale);
+    return frontEndOn && tone + RX_BANDWIDTH_HZ >= RX_CENTER_HZ &&
+        tone <= RX_CENTER_HZ + RX_BANDWIDTH_HZ;
+}
+
+// Tone sent at transmitter time t (us), as it arrives: amplitude 1
+static double toneSample(double t){
+    uint32 tone = toneAt(t);
+    return (tone > 0u) ? sin(2.0 * M_PI * tone * t / 1e6) : 0.0;
+}
+
+/*
+ * function: static double fileSample(uint64_t index)
+ * returns: sample 'index' of --adc-in, 0 past its end
+ * description: Reads the file forward only. Reads always move on with the
+ * clock, so the window holds whatever they look back at; a long jump (the
+ * receiver was asleep) seeks instead of reading through.
+ */
+static double fileSample(uint64_t index){
+    uint8 bytes[2];
+
+    if(index + ADC_IN_WINDOW < adcInNext || index >= adcInSamples){
+        return 0.0;
+    }
+    if(index >= adcInNext + ADC_IN_WINDOW &&
+        fseek(adcIn, adcInStart + (long)(index - ADC_IN_WINDOW) * 2L, SEEK_SET) == 0){
+        adcInNext = index - ADC_IN_WINDOW;
+    }
+    while(adcInNext <= index){
+        if(fread(bytes, sizeof(bytes), 1, adcIn) != 1){
+            adcInSamples = (uint32_t)adcInNext;
+            return 0.0;
+        }
+        adcInWindow[adcInNext % ADC_IN_WINDOW] = (int16)(bytes[0] | (bytes[1] << 8));
+        adcInNext++;
+    }
+    return adcInWindow[index % ADC_IN_WINDOW] / ADC_IN_SCALE;
+}
+
+// --adc-in at time t (us), in ADC counts, interpolated between its samples
+static double fileAt(double t){
+    double position = t * adcInRate / 1e6;
+    double index = floor(position);
+    double first = fileSample((uint64_t)index);
+
+    return first + (position - index) * (fileSample((uint64_t)index + 1u) - first);
+}
+
+/*
+ * function: uint16 HAL_AdcRead(int16 *samples, uint16 count)
+ * description: The count samples up to now, synthesized from the --comp
+ * tones through the channel: the direct path and the --echo paths, all
+ * scaled in time by --doppler, plus --snr noise. Or from --adc-in.
+ */
+uint16 HAL_AdcRead(int16 *samples, uint16 count){
+    const double period = 1e6 / HAL_ADC_SAMPLE_RATE;
+    uint64_t start = cpuNs();
+    double t;
+    uint16 n;
+    uint32 echo;
+
+    if(count > HAL_ADC_RING_SIZE){
+        count = HAL_ADC_RING_SIZE;
+    }
+    for(n = 0u; n < count; n++){
+        double value = 0.0;
+        // Samples sit on a fixed grid so the tone phase runs on across reads
+        t = (floor(now / period) - (count - 1u - n)) * period * dopplerScale;
+        if(frontEndOn && adcIn != NULL){
+            value = fileAt(t) + noiseSigma * gaussian();
+        }else if(frontEndOn){
+            value = toneSample(t);
+            for(echo = 0u; echo < echoCount; echo++){
+                value += echoGain[echo] * toneSample(t - echoDelayUs[echo]);
+            }
+            value = ADC_AMPLITUDE * value + noiseSigma * gaussian();
+        }
+        value = (value > ADC_MAX) ? ADC_MAX : (value < -ADC_MAX ? -ADC_MAX : value);
+        samples[n] = (int16)lround(value);
+    }
+    channelNs += cpuNs() - start;
+    tick();
+    return count;
+}
+
+/* Transmitter modulator */
+void HAL_PwmStart(void){
+    pwmRunning = TRUE;
+    updateTone();
+    tick();
+}
+
+void HAL_PwmStop(void){
+    pwmRunning = FALSE;
+    updateTone();
+    tick();
+}
+
+void HAL_PwmSetFrequency(uint32 hz){
+    pwmHz = hz;
+    updateTone();
+    tick();
+}
+
+void HAL_PwmSleep(void){
+    pwmAsleep = TRUE;
+    updateTone();
+    tick();
+}
+
+void HAL_PwmWakeup(void){
+    pwmAsleep = FALSE;
+    updateTone();
+    tick();
+}
+
+/* UART */
+void HAL_UartStart(void){
+    uartAsleep = FALSE;
+    tick();
+}
+
+void HAL_UartSleep(void){
+    uartAsleep = TRUE;
+    tick();
+}
+
+void HAL_UartWakeup(void){
+    uartAsleep = FALSE;
+    tick();
+}
+
+void HAL_UartPutChar(uint8 byte){
+    simLog("UART tx %u (0x%02X)", byte, byte);
+    if(uartOut != NULL){
+        fprintf(uartOut, "%llu %u\n", (unsigned long long)(now / 1000u), byte);
+    }
+    uartSent++;
+    tick();
+}
+
+// Errors clear when read, like the status register
+uint8 HAL_UartRxStatus(void){
+    uint8 status = uartErrors | ((uartFifoCount > 0u) ? HAL_UART_RX_NOTEMPTY : 0u);
+    uartErrors = 0u;
+    tick();
+    return status;
+}
+
+uint8 HAL_UartGetByte(void){
+    uint8 byte = 0u;
+    if(uartFifoCount > 0u){
+        byte = uartFifo[0];
+        memmove(&uartFifo[0], &uartFifo[1], --uartFifoCount);
+    }
+    tick();
+    return byte;
+}
+
+/* Character LCD */
+void HAL_LcdStart(void){
+    HAL_LcdClear();
+}
+
+void HAL_LcdSleep(void){
+    tick();
+}
+
+void HAL_LcdWakeup(void){
+    tick();
+}
+
+void HAL_LcdClear(void){
+    uint8 row;
+    for(row = 0u; row < LCD_ROWS; row++){
+        memset(lcd[row], ' ', LCD_COLUMNS);
+        lcd[row][LCD_COLUMNS] = '\0';
+    }
+    lcdRow = 0u;
+    lcdColumn = 0u;
+    tick();
+}
+
+void HAL_LcdPosition(uint8 row, uint8 column){
+    lcdRow = (row < LCD_ROWS) ? row : LCD_ROWS - 1u;
+    lcdColumn = (column < LCD_COLUMNS) ? column : LCD_COLUMNS;
+    tick();
+}
+
+// Characters past the end of the line are dropped
+void HAL_LcdPrintString(const char8 *text){
+    while(*text != '\0' && lcdColumn < LCD_COLUMNS){
+        lcd[lcdRow][lcdColumn++] = *text++;
+    }
+    simLog("LCD %u |%s|", lcdRow, lcd[lcdRow]);
+    tick();
+}
+
+/* USB CDC: enumerates as soon as it is started. A line is logged at its LF */
+static void usbAppend(const uint8 *data, uint16 length){
+    uint16 n;
+    for(n = 0u; n < length; n++){
+        if(data[n] == '\n'){
+            simLog("USB> %s", usbLine);
+            usbLineLength = 0u;
+            usbLine[0] = '\0';
+        }
+        if(data[n] == '\b' && usbLineLength > 0u){
+            usbLine[--usbLineLength] = '\0';
+        }
+        if(data[n] == '\r' || data[n] == '\n' || data[n] == '\b'){
+            continue;
+        }
+        if(usbLineLength + 1u < USB_LINE_SIZE){
+            usbLine[usbLineLength++] = (char8)data[n];
+            usbLine[usbLineLength] = '\0';
+        }
+    }
+}
+
+void HAL_UsbStart(void){
+    usbStarted = TRUE;
+    tick();
+}
+
+uint8 HAL_UsbConfigChanged(void){
+    uint8 changed = usbStarted && !usbEnumerated;
+    usbEnumerated = usbStarted;
+    tick();
+    return changed;
+}
+
+uint8 HAL_UsbConfigured(void){
+    tick();
+    return usbEnumerated;
+}
+
+void HAL_UsbCdcInit(void){
+    tick();
+}
+
+uint8 HAL_UsbTxReady(void){
+    tick();
+    return (now < usbStallFrom) || (now >= usbStallTo);
+}
+
+void HAL_UsbPutData(const uint8 *data, uint16 length){
+    if(data != NULL){
+        usbAppend(data, length);
+    }
+    tick();
+}
+
+uint8 HAL_UsbRxReady(void){
+    tick();
+    return usbEnumerated && usbInCursor < usbInCount && usbIn[usbInCursor].time <= now;
+}
+
+uint16 HAL_UsbGetAll(uint8 *buffer){
+    uint16 length = 0u;
+    if(usbInCursor < usbInCount){
+        simPacket *packet = &usbIn[usbInCursor++];
+        length = packet->length;
+        memcpy(buffer, packet->data, length);
+    }
+    tick();
+    return length;
+}
+
+/*
+ * function: static void *loadLines(const char *path, size_t size, uint32 *count,
+ *                                  int (*parse)(const char *line, void *element))
+ * parameters: path - input file, size - size of one element, count - elements read,
+ *             parse - fills an element from a line, returns 0 to keep it
+ * returns: array of elements (free() it), exits if the file can't be read
+ * description: Blank lines and lines starting with # are skipped. Elements must
+ * be in time order.
+ */
+static void *loadLines(const char *path, size_t size, uint32 *count,
+    int (*parse)(const char *line, void *element)){
+    FILE *file = fopen(path, "r");
+    char line[256];
+    uint8 *elements = NULL;
+    uint32 capacity = 0u;
+
+    if(file == NULL){
+        fprintf(stderr, "%s: can't open %s\n", SIM_NAME, path);
+        exit(1);
+    }
+    *count = 0u;
+    while(fgets(line, sizeof(line), file) != NULL){
+        if(line[0] == '#' || line[0] == '\n' || line[0] == '\r'){
+            continue;
+        }
+        if(*count == capacity){
+            capacity = capacity ? capacity * 2u : 256u;
+            elements = realloc(elements, capacity * size);
+            if(elements == NULL){
+                fprintf(stderr, "%s: out of memory reading %s\n", SIM_NAME, path);
+                exit(1);
+            }
+        }
+        if(parse(line, elements + *count * size) == 0){
+            (*count)++;
+        }else{
+            fprintf(stderr, "%s: ignoring bad line in %s: %s", SIM_NAME, path, line);
+        }
+    }
+    fclose(file);
+    return elements;
+}
+
+static int parseTone(const char *line, void *element){
+    simSample *sample = element;
+    unsigned long long time;
+    unsigned int hz;
+    if(sscanf(line, "%llu %u", &time, &hz) != 2){
+        return -1;
+    }
+    sample->time = time;
+    sample->value = hz;
+    return 0;
+}
+
+static int parseByte(const char *line, void *element){
+    simSample *sample = element;
+    unsigned long long ms;
+    unsigned int byte;
+    if(sscanf(line, "%llu %u", &ms, &byte) != 2 || byte > 0xFFu){
+        return -1;
+    }
+    sample->time = ms * 1000u;
+    sample->value = byte;
+    return 0;
+}
+
+static int parsePacket(const char *line, void *element){
+    simPacket *packet = element;
+    unsigned long long ms;
+    int offset;
+    const char *text;
+
+    if(sscanf(line, "%llu %n", &ms, &offset) != 1){
+        return -1;
+    }
+    packet->time = ms * 1000u;
+    packet->length = 0u;
+    for(text = line + offset; *text != '\0' && *text != '\n' &&
+        packet->length < USB_PACKET_SIZE; text++){
+        if(text[0] == '\\' && (text[1] == 'r' || text[1] == 'n' || text[1] == 'b')){
+            packet->data[packet->length++] = (text[1] == 'r') ? '\r' : (text[1] == 'n') ? '\n' : '\b';
+            text++;
+        }else{
+            packet->data[packet->length++] = (uint8)*text;
+        }
+    }
+    return (packet->length > 0u) ? 0 : -1;
+}
+
+static FILE *openOutput(const char *path){
+    FILE *file = fopen(path, "w");
+    if(file == NULL){
+        fprintf(stderr, "%s: can't write %s\n", SIM_NAME, path);
+        exit(1);
+    }
+    return file;
+}
+
+static void usage(void){
+    fprintf(stderr, "usage: %s [--time SECONDS] [--comp FILE] [--snr DB] [--echo MS:GAIN] "
+        "[--doppler M_PER_S] [--seed N] [--adc-in FILE] [--adc-rate HZ] [--trace FILE] [--clock-ppm PPM] [--uart-in FILE] "
+        "[--uart-out FILE] [--usb-in FILE] [--usb-stall FROM_MS:TO_MS] [--verbose]\n", SIM_NAME);
+    exit(1);
+}
+
+// Opens --adc-in, a WAV file unless --adc-rate says it is raw
+static void openAdcIn(const char *path){
+    adcIn = fopen(path, "rb");
+    if(adcIn == NULL){
+        fprintf(stderr, "%s: can't open %s\n", SIM_NAME, path);
+        exit(1);
+    }
+    adcInSamples = WAV_UNKNOWN_LENGTH;
+    if(adcInRate == 0u && wavReadHeader(adcIn, &adcInRate, &adcInSamples) != 0){
+        fprintf(stderr, "%s: %s is not a 16-bit mono WAV file, give --adc-rate for raw\n",
+            SIM_NAME, path);
+        exit(1);
+    }
+    adcInStart = ftell(adcIn);
+    // A raw file, or a WAV stream that was cut off: its length is what is there
+    if(adcInSamples == WAV_UNKNOWN_LENGTH && fseek(adcIn, 0L, SEEK_END) == 0){
+        adcInSamples = (uint32_t)((ftell(adcIn) - adcInStart) / 2);
+        fseek(adcIn, adcInStart, SEEK_SET);
+    }
+}
+
+int main(int argc, char **argv){
+    const char *adcInPath = NULL;
+    int timeSet = 0;
+    int n;
+
+    for(n = 1; n < argc; n++){
+        const char *value = (n + 1 < argc) ? argv[n + 1] : NULL;
+        if(strcmp(argv[n], "--verbose") == 0){
+            verbose = 1;
+            continue;
+        }
+        if(value == NULL){
+            usage();
+        }
+        if(strcmp(argv[n], "--time") == 0){
+            endTime = (uint64_t)(atof(value) * 1e6);
+            timeSet = 1;
+        }else if(strcmp(argv[n], "--comp") == 0){
+            compTrace = loadLines(value, sizeof(simSample), &compCount, parseTone);
+        }else if(strcmp(argv[n], "--snr") == 0){
+            // Tone power is amplitude^2 / 2
+            noiseSigma = ADC_AMPLITUDE / sqrt(2.0 * pow(10.0, atof(value) / 10.0));
+        }else if(strcmp(argv[n], "--echo") == 0){
+            double ms, gain;
+            if(echoCount == SIM_MAX_ECHOES || sscanf(value, "%lf:%lf", &ms, &gain) != 2 || ms < 0.0){
+                usage();
+            }
+            echoDelayUs[echoCount] = ms * 1e3;
+            echoGain[echoCount] = gain;
+            echoCount++;
+        }else if(strcmp(argv[n], "--usb-stall") == 0){
+            double from, to;
+            if(sscanf(value, "%lf:%lf", &from, &to) != 2 || from < 0.0 || to < from){
+                usage();
+            }
+            usbStallFrom = (uint64_t)(from * 1e3);
+            usbStallTo = (uint64_t)(to * 1e3);
+        }else if(strcmp(argv[n], "--doppler") == 0){
+            dopplerScale = 1.0 + atof(value) / SOUND_M_PER_S;
+        }else if(strcmp(argv[n], "--adc-in") == 0){
+            adcInPath = value;
+        }else if(strcmp(argv[n], "--adc-rate") == 0){
+            adcInRate = (uint32_t)strtoul(value, NULL, 0);
+        }else if(strcmp(argv[n], "--seed") == 0){
+            noiseSeed = (uint32)strtoul(value, NULL, 0);
+        }else if(strcmp(argv[n], "--clock-ppm") == 0){
+            clockScale = 1.0 + atof(value) / 1e6;
+        }else if(strcmp(argv[n], "--trace") == 0){
+            traceOut = openOutput(value);
+        }else if(strcmp(argv[n], "--uart-in") == 0){
+            uartIn = loadLines(value, sizeof(simSample), &uartInCount, parseByte);
+        }else if(strcmp(argv[n], "--uart-out") == 0){
+            uartOut = openOutput(value);
+        }else if(strcmp(argv[n], "--usb-in") == 0){
+            usbIn = loadLines(value, sizeof(simPacket), &usbInCount, parsePacket);
+        }else{
+            usage();
+        }
+        n++;
+    }
+    hostStartNs = cpuNs();
+    if(adcInPath != NULL){
+        openAdcIn(adcInPath);
+        if(!timeSet && adcInSamples != WAV_UNKNOWN_LENGTH){
+            endTime = (uint64_t)adcInSamples * 1000000u / adcInRate;
+        }
+    }
+    if(traceOut != NULL){
+        fprintf(traceOut, "0 0\n");
+    }
+    firmwareMain();
+    simFinish();
+    return 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,157 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Telemetry dump
+ * Function: The host end of the receiver's telemetry (USBFS_Rx/telemetry.h).
+ * Reads what came out of the receiver's UART, unframes it and prints one line
+ * per record. Bytes between frames are crab counts or rate commands and are
+ * printed as such, and so are the text frames of a profiling build (lines
+ * of profile.h statistics, starting with '#'). A frame that fails its CRC
+ * is counted and skipped.
+ *
+ * usage: logdump [--raw] IN
+ *  --raw   IN is the serial bytes as they came, not rx_sim --uart-out
+ *          lines of "t_ms byte"
+ *  IN      file, or - for stdin
+ * =============================================================================
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "project.h"
+#include "linkRate.h"
+#include "telemetry.h"
+#include "profile.h"
+
+static const char *typeNames[] = {"?", "copy", "result", "timeout"};
+
+static uint8 payload[PROFILE_LINE];    // a record and its CRC, or a line of text
+static unsigned int payloadCount;
+static int inFrame;
+static int escaped;
+static unsigned long records;
+static unsigned long badFrames;
+static uint16 nextSequence;
+
+static void usage(void){
+    fprintf(stderr, "usage: logdump [--raw] IN\n");
+    exit(1);
+}
+
+static void printRecord(const telemetryRecord *record){
+    if((records > 0u) && (record->sequence != nextSequence)){
+        printf("  (%u records lost)\n", (uint16)(record->sequence - nextSequence));
+    }
+    nextSequence = (uint16)(record->sequence + 1u);
+    records++;
+
+    printf("%5u %10.3f s %-7s rate %u", record->sequence, record->time / 1000.0,
+        typeNames[(record->type < 4u) ? record->type : 0u], record->rate);
+    if(record->type == TELEMETRY_RESULT){
+        printf(">%u", record->suggested);
+    }
+    printf(" x%u corrected %u margin %d", record->copies, record->corrected, record->margin);
+    if((record->flags & TELEMETRY_CRC_OK) != 0u){
+        printf(" T%u crabs %d", record->trapId, record->crabs);
+    }else{
+        printf(" crc bad");
+    }
+    if(record->type == TELEMETRY_COPY){
+        printf(" post-fix 0x%02X%s", record->postfix,
+            ((record->flags & TELEMETRY_POSTFIX_OK) != 0u) ? "" : " bad");
+    }
+    printf("%s rate field %d %d timing %+d\n",
+        ((record->flags & TELEMETRY_CONFIDENT) != 0u) ? " confident" : "",
+        record->rateSoft[0], record->rateSoft[1], record->timingError);
+}
+
+// One byte off the wire, SLIP unframed
+static void take(uint8 byte){
+    telemetryRecord record;
+
+    if(byte == TELEMETRY_END){
+        if(inFrame && (payloadCount > 0u)){
+            if(telemetryParse(payload, (uint8)payloadCount, &record)){
+                printRecord(&record);
+            }else if((payload[0] == '#') && (payloadCount < sizeof(payload))){
+                payload[payloadCount] = '\0';
+                printf("%s\n", (const char *)payload);
+            }else{
+                badFrames++;
+            }
+            inFrame = 0;
+        }else{
+            inFrame = 1;    // the END that opens a frame
+        }
+        payloadCount = 0u;
+        escaped = 0;
+        return;
+    }
+    if(!inFrame){
+        if((byte & LINK_RATE_COMMAND) != 0u){
+            printf("      rate command %u\n", byte & LINK_RATE_MASK);
+        }else{
+            printf("      crab count %u\n", byte);
+        }
+        return;
+    }
+    if(escaped){
+        byte = (byte == TELEMETRY_ESC_END) ? TELEMETRY_END :
+            (byte == TELEMETRY_ESC_ESC) ? TELEMETRY_ESC : byte;
+        escaped = 0;
+    }else if(byte == TELEMETRY_ESC){
+        escaped = 1;
+        return;
+    }
+    if(payloadCount < sizeof(payload)){
+        payload[payloadCount] = byte;
+        payloadCount++;
+    }else{
+        payloadCount = sizeof(payload) + 1u;    // too long, fails its parse
+    }
+}
+
+int main(int argc, char **argv){
+    const char *path = NULL;
+    int raw = 0;
+    FILE *in;
+    char line[256];
+    unsigned long long time;
+    unsigned int byte;
+    int c;
+    int n;
+
+    for(n = 1; n < argc; n++){
+        if(strcmp(argv[n], "--raw") == 0){
+            raw = 1;
+        }else if(path == NULL){
+            path = argv[n];
+        }else{
+            usage();
+        }
+    }
+    if(path == NULL){
+        usage();
+    }
+    in = (strcmp(path, "-") == 0) ? stdin : fopen(path, raw ? "rb" : "r");
+    if(in == NULL){
+        fprintf(stderr, "logdump: can't open %s\n", path);
+        return 1;
+    }
+
+    if(raw){
+        while((c = fgetc(in)) != EOF){
+            take((uint8)c);
+        }
+    }else{
+        while(fgets(line, sizeof(line), in) != NULL){
+            if(sscanf(line, "%llu %u", &time, &byte) == 2){
+                take((uint8)byte);
+            }
+        }
+    }
+    printf("%lu records, %lu bad frames\n", records, badFrames);
+    return 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,35 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Simulation stand-in for the PSoC Creator generated project.h
+ * Function: Provides the Cypress types and ISR macros the firmwares use, so
+ * they build on Linux against halSim.c. No component APIs are declared here,
+ * the firmwares reach the hardware only through hal.h.
+ * =============================================================================
+*/
+
+#ifndef PROJECT_H
+#define PROJECT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+
+typedef uint8_t     uint8;
+typedef uint16_t    uint16;
+typedef uint32_t    uint32;
+typedef int8_t      int8;
+typedef int16_t     int16;
+typedef int32_t     int32;
+typedef uint64_t    uint64;
+typedef char        char8;
+
+/* Bus clock, from cyfitter.h; the PSoC Creator default */
+#define BCLK__BUS_CLK__HZ       24000000u
+
+#define CY_ISR(FuncName)        void FuncName(void)
+#define CY_ISR_PROTO(FuncName)  void FuncName(void)
+
+#endif /* PROJECT_H */
+
+/* [] END OF FILE */
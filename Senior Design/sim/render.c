@@ -0,0 +1,125 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Waveform renderer
+ * Function: Turns a tone trace (tx_sim --trace, lines of "t_us freq_hz") into
+ * the sampled waveform at the transducer, as a 16-bit mono WAV or raw file
+ * that rx_sim --adc-in decodes. Reads the trace and writes the samples as it
+ * goes, so an hours-long transmission never has to fit in memory.
+ *
+ * usage: render [--rate HZ] [--level FRACTION] [--raw] TRACE OUT
+ *  --rate HZ          samples per second (default the receiver ADC's)
+ *  --level FRACTION   tone peak as a fraction of full scale (default 0.5,
+ *                     which rx_sim reads as its usual tone level)
+ *  --raw              no WAV header, just the little-endian samples
+ *  TRACE, OUT         files, or - for stdin and stdout
+ * Silence after the last tone change lasts TAIL_US.
+ * =============================================================================
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "hal.h"
+#include "mfsk.h"
+#include "wavFile.h"
+
+#define TAIL_US             1000000.0
+#define FULL_SCALE          32767.0
+
+static FILE *out;
+static uint32 rate = HAL_ADC_SAMPLE_RATE;
+static double level = 0.5;
+static uint64_t written;    // samples so far
+static double phase;        // of the tone, radians
+
+static void usage(void){
+    fprintf(stderr, "usage: render [--rate HZ] [--level FRACTION] [--raw] TRACE OUT\n");
+    exit(1);
+}
+
+// Writes the samples before time 'end' (us) with the tone at 'hz'
+static void renderUntil(double end, uint32 hz){
+    uint8 bytes[2];
+    int16 sample;
+
+    while(written * 1e6 / rate < end){
+        sample = 0;
+        if(hz > 0u){
+            sample = (int16)lround(level * FULL_SCALE * sin(phase));
+            phase = fmod(phase + 2.0 * M_PI * hz / rate, 2.0 * M_PI);
+        }
+        bytes[0] = (uint8)((uint16)sample & 0xFFu);
+        bytes[1] = (uint8)((uint16)sample >> 8);
+        if(fwrite(bytes, sizeof(bytes), 1, out) != 1){
+            fprintf(stderr, "render: write failed\n");
+            exit(1);
+        }
+        written++;
+    }
+}
+
+int main(int argc, char **argv){
+    const char *paths[2];
+    int pathCount = 0;
+    int raw = 0;
+    FILE *trace;
+    char line[256];
+    unsigned long long time;
+    unsigned int hz;
+    double last = 0.0;
+    uint32 tone = 0u;
+    int n;
+
+    for(n = 1; n < argc; n++){
+        if(strcmp(argv[n], "--raw") == 0){
+            raw = 1;
+        }else if(strcmp(argv[n], "--rate") == 0 && n + 1 < argc){
+            rate = (uint32)strtoul(argv[++n], NULL, 0);
+        }else if(strcmp(argv[n], "--level") == 0 && n + 1 < argc){
+            level = atof(argv[++n]);
+        }else if(pathCount < 2 && (argv[n][0] != '-' || argv[n][1] == '\0')){
+            paths[pathCount++] = argv[n];
+        }else{
+            usage();
+        }
+    }
+    if(pathCount != 2 || rate == 0u || level <= 0.0 || level > 1.0){
+        usage();
+    }
+    trace = (strcmp(paths[0], "-") == 0) ? stdin : fopen(paths[0], "r");
+    out = (strcmp(paths[1], "-") == 0) ? stdout : fopen(paths[1], "wb");
+    if(trace == NULL || out == NULL){
+        fprintf(stderr, "render: can't open %s\n", (trace == NULL) ? paths[0] : paths[1]);
+        return 1;
+    }
+    if(rate <= 2u * mfskFreq[MFSK_TONES - 1u]){
+        fprintf(stderr, "render: warning, %u Hz is too slow for the tones, they will alias\n", rate);
+    }
+    if(!raw && wavWriteHeader(out, rate, WAV_UNKNOWN_LENGTH) != 0){
+        fprintf(stderr, "render: write failed\n");
+        return 1;
+    }
+
+    while(fgets(line, sizeof(line), trace) != NULL){
+        if(line[0] == '#' || sscanf(line, "%llu %u", &time, &hz) != 2){
+            continue;
+        }
+        renderUntil((double)time, tone);
+        tone = hz;
+        last = (double)time;
+    }
+    renderUntil(last + TAIL_US, tone);
+
+    // Now the length is known, if it fits and the file can go back for it
+    if(!raw && written * 2u < WAV_UNKNOWN_LENGTH - WAV_HEADER_BYTES &&
+        fseek(out, 0L, SEEK_SET) == 0){
+        wavWriteHeader(out, rate, (uint32)written);
+    }
+    fclose(out);
+    fprintf(stderr, "render: %llu samples, %.3f s at %u Hz\n",
+        (unsigned long long)written, (double)written / rate, rate);
+    return 0;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,108 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * WAV files
+ * Function: RIFF header of a 16-bit mono PCM WAV file. Other chunks before
+ * the data (LIST and the like, as recorders add) are skipped on reading.
+ * =============================================================================
+*/
+
+#include <string.h>
+#include "wavFile.h"
+
+#define WAV_PCM             1u
+#define WAV_CHANNELS        1u
+#define WAV_BITS            16u
+#define WAV_FMT_BYTES       16u
+
+static void putLe(uint8_t *bytes, uint32_t value, int count){
+    int n;
+    for(n = 0; n < count; n++){
+        bytes[n] = (uint8_t)(value >> (8 * n));
+    }
+}
+
+static uint32_t getLe(const uint8_t *bytes, int count){
+    uint32_t value = 0u;
+    int n;
+    for(n = count - 1; n >= 0; n--){
+        value = (value << 8) | bytes[n];
+    }
+    return value;
+}
+
+/*
+ * function: int wavWriteHeader(FILE *file, uint32_t rate, uint32_t samples)
+ * parameters: file - at its start, rate - samples per second,
+ *             samples - that follow, WAV_UNKNOWN_LENGTH while streaming
+ * returns: 0, -1 if the write failed
+ * description: A stream's header can be written again with the real length
+ * once it is known, if the file can seek.
+ */
+int wavWriteHeader(FILE *file, uint32_t rate, uint32_t samples){
+    uint8_t header[WAV_HEADER_BYTES];
+    uint32_t data = (samples == WAV_UNKNOWN_LENGTH) ? samples : samples * (WAV_BITS / 8u);
+    uint32_t riff = (samples == WAV_UNKNOWN_LENGTH) ? samples : data + WAV_HEADER_BYTES - 8u;
+
+    memcpy(header, "RIFF", 4);
+    putLe(header + 4, riff, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    putLe(header + 16, WAV_FMT_BYTES, 4);
+    putLe(header + 20, WAV_PCM, 2);
+    putLe(header + 22, WAV_CHANNELS, 2);
+    putLe(header + 24, rate, 4);
+    putLe(header + 28, rate * WAV_CHANNELS * (WAV_BITS / 8u), 4);
+    putLe(header + 32, WAV_CHANNELS * (WAV_BITS / 8u), 2);
+    putLe(header + 34, WAV_BITS, 2);
+    memcpy(header + 36, "data", 4);
+    putLe(header + 40, data, 4);
+    return (fwrite(header, sizeof(header), 1, file) == 1) ? 0 : -1;
+}
+
+/*
+ * function: int wavReadHeader(FILE *file, uint32_t *rate, uint32_t *samples)
+ * parameters: file - at its start, rate - its sample rate,
+ *             samples - in the file, WAV_UNKNOWN_LENGTH if a stream left it open
+ * returns: 0 with the file at the first sample, -1 if it isn't a 16-bit
+ * mono PCM WAV file
+ */
+int wavReadHeader(FILE *file, uint32_t *rate, uint32_t *samples){
+    uint8_t chunk[8];
+    uint8_t format[WAV_FMT_BYTES];
+    uint32_t size;
+    int haveFormat = 0;
+
+    if(fread(chunk, 8, 1, file) != 1 || memcmp(chunk, "RIFF", 4) != 0 ||
+        fread(chunk, 4, 1, file) != 1 || memcmp(chunk, "WAVE", 4) != 0){
+        return -1;
+    }
+    while(fread(chunk, 8, 1, file) == 1){
+        size = getLe(chunk + 4, 4);
+        if(memcmp(chunk, "fmt ", 4) == 0 && size >= WAV_FMT_BYTES){
+            if(fread(format, WAV_FMT_BYTES, 1, file) != 1){
+                return -1;
+            }
+            if(getLe(format, 2) != WAV_PCM || getLe(format + 2, 2) != WAV_CHANNELS ||
+                getLe(format + 14, 2) != WAV_BITS){
+                return -1;
+            }
+            *rate = getLe(format + 4, 4);
+            haveFormat = 1;
+            size -= WAV_FMT_BYTES;
+        }else if(memcmp(chunk, "data", 4) == 0){
+            if(!haveFormat){
+                return -1;
+            }
+            *samples = (size == WAV_UNKNOWN_LENGTH) ? size : size / (WAV_BITS / 8u);
+            return 0;
+        }
+        // Chunks are padded to an even length
+        for(size += size & 1u; size > 0u; size--){
+            if(fgetc(file) == EOF){
+                return -1;
+            }
+        }
+    }
+    return -1;
+}
+
+/* [] END OF FILE */
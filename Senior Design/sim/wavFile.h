@@ -0,0 +1,24 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * WAV files
+ * Function: Reads and writes the header of 16-bit mono PCM WAV files, for
+ * render (tone trace to waveform) and rx_sim --adc-in (waveform to the
+ * receiver's ADC). The samples follow the header, little-endian.
+ * =============================================================================
+*/
+
+#ifndef WAV_FILE_H
+#define WAV_FILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define WAV_HEADER_BYTES    44u
+#define WAV_UNKNOWN_LENGTH  0xFFFFFFFFu // samples of a stream whose end isn't known yet
+
+int wavWriteHeader(FILE *file, uint32_t rate, uint32_t samples);
+int wavReadHeader(FILE *file, uint32_t *rate, uint32_t *samples);
+
+#endif /* WAV_FILE_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,104 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Count Parser
+ * Function: Keeps the characters of the entry being typed and only works
+ * out its numbers when a separator ends it.
+ * =============================================================================
+*/
+
+#include "countParser.h"
+
+#define KEY_BACKSPACE   0x08u
+#define KEY_DELETE      0x7Fu
+#define KEY_PAIR        ':'
+#define KEY_RATE        'r'
+#define KEY_RATE_UPPER  'R'
+
+static uint8 isSeparator(uint8 byte){
+    return (byte == '\r') || (byte == '\n') || (byte == ' ') || (byte == '\t') ||
+        (byte == ',') || (byte == ';');
+}
+
+// 1 to COUNT_PARSER_DIGITS digits and nothing else, into *number
+static uint8 parseNumber(const uint8 *chars, uint8 length, uint32 *number){
+    uint8 n;
+
+    *number = 0;
+    if((length == 0u) || (length > COUNT_PARSER_DIGITS)){
+        return 0;
+    }
+    for(n = 0; n < length; n++){
+        if((chars[n] < '0') || (chars[n] > '9')){
+            return 0;
+        }
+        *number = *number * 10u + (uint32)(chars[n] - '0');
+    }
+    return 1;
+}
+
+// Forget the entry being typed
+void countParserReset(countParser *parser){
+    parser->length = 0;
+    parser->overflow = 0;
+}
+
+/*
+ * function: uint8 countParserByte(countParser *parser, uint8 byte, countEntry *value)
+ * parameters: parser - from countParserReset, byte - next one typed,
+ *             value - the entry's numbers, for COUNT_VALUE
+ * returns: COUNT_NONE, COUNT_VALUE, COUNT_RATE or COUNT_ERROR
+ */
+uint8 countParserByte(countParser *parser, uint8 byte, countEntry *value){
+    uint8 colon = 0;
+    uint8 start = 0;
+    uint8 result = COUNT_VALUE;
+
+    if((byte == KEY_BACKSPACE) || (byte == KEY_DELETE)){
+        if(parser->overflow > 0u){
+            parser->overflow--;
+        }else if(parser->length > 0u){
+            parser->length--;
+        }
+        return COUNT_NONE;
+    }
+    if(isSeparator(byte) == 0u){
+        if(parser->length < COUNT_PARSER_CHARS){
+            parser->chars[parser->length++] = byte;
+        }else if(parser->overflow < 0xFFu){
+            parser->overflow++;
+        }
+        return COUNT_NONE;
+    }
+
+    if((parser->length == 0u) && (parser->overflow == 0u)){
+        return COUNT_NONE;
+    }
+    value->trap = 0;
+    value->paired = 0;
+    if((parser->length > 0u) && ((parser->chars[0] == KEY_RATE) || (parser->chars[0] == KEY_RATE_UPPER))){
+        // A rate command, the number after the r is the rate
+        result = COUNT_RATE;
+        start = 1u;
+    }else{
+        while((colon < parser->length) && (parser->chars[colon] != KEY_PAIR)){
+            colon++;
+        }
+        if(colon < parser->length){
+            value->paired = 1;
+            if(parseNumber(parser->chars, colon, &value->trap) == 0u){
+                result = COUNT_ERROR;
+            }
+            start = (uint8)(colon + 1u);
+        }
+    }
+    if(parseNumber(&parser->chars[start], (uint8)(parser->length - start), &value->count) == 0u){
+        result = COUNT_ERROR;
+    }
+    if(parser->overflow > 0u){
+        result = COUNT_ERROR;
+    }
+    countParserReset(parser);
+    return result;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,46 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * Count Parser
+ * Function: Turns what the operator types, or pastes, into numbers, one byte
+ * at a time, so a USB packet can hold any part of an entry or several
+ * entries. An entry is digits, a count, or a trap ID, a colon and a count
+ * ("3:25"), or r and a link rate ("r1"), ended by a separator: CR, LF,
+ * space, tab, comma or semicolon.
+ * Backspace and DEL take back the last character.
+ * Separators with no digits before them are skipped, so CR LF ends one
+ * entry, not two. Any other character spoils the entry it is in.
+ * =============================================================================
+*/
+
+#ifndef COUNT_PARSER_H
+#define COUNT_PARSER_H
+
+#include "project.h"
+
+#define COUNT_PARSER_DIGITS 5u  // longest number, more is an error
+#define COUNT_PARSER_CHARS  12u // characters kept of an entry, so backspace can take them back
+
+// countParserByte() results
+#define COUNT_NONE          0u  // entry not finished yet
+#define COUNT_VALUE         1u  // an entry ended, *value has its numbers
+#define COUNT_ERROR         2u  // an entry ended that was no number
+#define COUNT_RATE          3u  // an r entry ended, *value has the rate in count
+
+typedef struct{
+    uint32 count;
+    uint32 trap;    // the number before the colon
+    uint8 paired;   // there was one, else trap is 0
+}countEntry;
+
+typedef struct{
+    uint8 chars[COUNT_PARSER_CHARS];
+    uint8 length;   // characters of the entry kept
+    uint8 overflow; // and typed past those, the entry is too long either way
+}countParser;
+
+void countParserReset(countParser *parser);
+uint8 countParserByte(countParser *parser, uint8 byte, countEntry *value);
+
+#endif /* COUNT_PARSER_H */
+
+/* [] END OF FILE */
@@ -0,0 +1,116 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * User input HAL (PSoC 5LP)
+ * Function: Implements ../common/hal.h on top of the user_input components.
+ * Only the calls the user input module makes are implemented.
+ * =============================================================================
+*/
+
+#include "project.h"
+#include "hal.h"
+#include "dwtCycle.h"
+
+#define USBFS_DEVICE    (0u)
+
+void HAL_IntEnable(void){
+    CyGlobalIntEnable;
+}
+
+void HAL_IsrStart(halIrq irq, halIsr handler){
+    if(irq == HAL_IRQ_TX_DONE){
+        tx_done_StartEx(handler);
+    }
+}
+
+void HAL_TimerStart(halTimer timer){
+    if(timer == HAL_TIMER_DATA){
+        Data_Timer_Start();
+    }
+}
+
+void HAL_TimerStop(halTimer timer){
+    if(timer == HAL_TIMER_DATA){
+        Data_Timer_Stop();
+    }
+}
+
+void HAL_UartStart(void){
+    UART_Start();
+}
+
+void HAL_UartPutChar(uint8 byte){
+    UART_PutChar(byte);
+}
+
+// Polled for USBFS_Tx's reports, the UART component needs its RX half on
+uint8 HAL_UartRxStatus(void){
+    uint8 rxStatus = UART_RXSTATUS_REG;
+    uint8 status = 0u;
+
+    if((rxStatus & UART_RX_STS_FIFO_NOTEMPTY) != 0u){
+        status |= HAL_UART_RX_NOTEMPTY;
+    }
+    if((rxStatus & UART_RX_STS_BREAK) != 0u){
+        status |= HAL_UART_RX_BREAK;
+    }
+    if((rxStatus & UART_RX_STS_PAR_ERROR) != 0u){
+        status |= HAL_UART_RX_PAR_ERROR;
+    }
+    if((rxStatus & UART_RX_STS_STOP_ERROR) != 0u){
+        status |= HAL_UART_RX_STOP_ERROR;
+    }
+    if((rxStatus & UART_RX_STS_OVERRUN) != 0u){
+        status |= HAL_UART_RX_OVERRUN;
+    }
+    return status;
+}
+
+uint8 HAL_UartGetByte(void){
+    return (uint8)UART_GetByte();
+}
+
+void HAL_LcdStart(void){
+    LCD_Start();
+}
+
+void HAL_LcdPosition(uint8 row, uint8 column){
+    LCD_Position(row, column);
+}
+
+void HAL_LcdPrintString(const char8 *text){
+    LCD_PrintString(text);
+}
+
+void HAL_UsbStart(void){
+    USBUART_Start(USBFS_DEVICE, USBUART_5V_OPERATION);
+}
+
+uint8 HAL_UsbConfigChanged(void){
+    return USBUART_IsConfigurationChanged();
+}
+
+uint8 HAL_UsbConfigured(void){
+    return USBUART_GetConfiguration();
+}
+
+void HAL_UsbCdcInit(void){
+    USBUART_CDC_Init();
+}
+
+uint8 HAL_UsbTxReady(void){
+    return USBUART_CDCIsReady();
+}
+
+void HAL_UsbPutData(const uint8 *data, uint16 length){
+    USBUART_PutData(data, length);
+}
+
+uint8 HAL_UsbRxReady(void){
+    return USBUART_DataIsReady();
+}
+
+uint16 HAL_UsbGetAll(uint8 *buffer){
+    return USBUART_GetAll(buffer);
+}
+
+/* [] END OF FILE */
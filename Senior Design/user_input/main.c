@@ -8,6 +8,9 @@
 *   Receives data from the hyper terminal up to MAX_CRABS.
 *   FSK is then started using the input data and then prompts the user for
 *   more data. The LCD Display shows the number of crabs sent.
+*   Several counts can be typed at once; they wait in a queue and go to
+*   USBFS_Tx one at a time, as soon as it reports room for them. The link
+*   rate the receiver suggests on its LCD is typed in the same way (r1).
 *
 *  This code was taken from PSoC's USBFS_UART example code and edited to store
 *  a number for sending to another PSoC
@@ -39,8 +42,13 @@
 #include <project.h>
 #include "stdio.h"
 #include "stdlib.h"
-
-#define USBFS_DEVICE    (0u)
+#include "hal.h"
+#include "profile.h"
+#include "usbOut.h"
+#include "countParser.h"
+#include "eventQueue.h"
+#include "countLink.h"
+#include "linkRate.h"
 
 /* The buffer size is equal to the maximum packet size of the IN and OUT bulk
 * endpoints.
@@ -51,6 +59,8 @@
 #define DATA_SIZE           (7u)
 /* Change max crabs to correlate with data size 2^(n) - 1 */
 #define MAX_CRABS           (127)
+/* Trap IDs that can go with a count, 0 is this trap */
+#define MAX_TRAP            COUNT_LINK_MAX_TRAP
 /* Error used for user error */
 #define ERROR               (333u)
 
@@ -60,31 +70,51 @@
 #define FALSE 0x0
 #define DATA_LENGTH 4
 #define DECODE_VALUE 0x01
-#define WAITTIME 80
+#define WAITTIME (COUNT_LINK_TIMEOUT_MS / 1024u) // tx_done ticks for USBFS_Tx to answer a count
+#define WAIT_COUNT 0u // waiting entry types
+#define WAIT_RATE 1u
 #define PREFIX_BIT_LENGTH 6
 #define PREFIX_MESSAGE 0xFF
 
+/* What profile.h times, PROFILE_ON builds only */
+enum profileSlot{
+    PROFILE_TX_DONE,    // tx_done
+    PROFILE_USB_INPUT,  // main loop: GetCrabs
+    PROFILE_SLOT_COUNT
+};
+
 /*Function Prototypes*/
 int GetCrabs(void);
 int CalculateCrabs(void);
+void QueueCrabs(int);
+void QueueRate(void);
+void SendCrabs(void);
 void DisplayCrabs(int);
+#ifdef PROFILE_ON
+void profileLine(const char8 *line);
+#endif
 
 CY_ISR_PROTO(tx_done); // sleep timer interrupt from UART
 
 /*Global Variables*/
 int prompt = 1;
-int endFlag = 0; // flag for end of user input
-int oneDigit = 0; // flag for end of input with one character
-int twoDigit = 0; // flag for end of input with two characters
 int error = 0; // flag for input error
-int i = 2; // to iterate through data array
-int dataDone = TRUE; // check if data is done sending
-int sendReady = FALSE;
-uint16 count;
-uint16 countTx = 0;
+uint16 count = 0; // bytes in buffer
+uint16 packetNext = 0; // next byte of buffer to parse
+volatile uint16 countTx = 0; // tx_done ticks since a count went out
 char8 lineStr[LINE_STR_LENGTH];
+char8 message[USBUART_BUFFER_SIZE];
 uint8 buffer[USBUART_BUFFER_SIZE];
-uint8 data[3] = {0};
+countParser entry; // what is typed, until a separator ends it
+countEntry entered; // numbers of the entry that ended
+uint8 entryResult = COUNT_NONE; // COUNT_VALUE, or COUNT_ERROR for no number
+usbOut terminal; // prompts and echoes waiting for the host
+eventQueue waiting; // counts (and rates) not sent yet, flag = trap ID or 0 for this trap
+uint8 txRoom = COUNT_LINK_SPARE + 1u; // counts USBFS_Tx last said it has room for
+int txAnswer = FALSE; // a count or rate went out, USBFS_Tx has not answered it
+#ifdef PROFILE_ON
+const char8 *const profileNames[PROFILE_SLOT_COUNT] = {"tx_done", "GetCrabs"};
+#endif
 
 
 /*******************************************************************************
@@ -94,170 +124,113 @@ uint8 data[3] = {0};
 int main()
 {
     int crabs = 0;
-    int gettingData = TRUE;
 
-    CyGlobalIntEnable; /* Enable global interrupts. */
+    HAL_IntEnable(); /* Enable global interrupts. */
+#ifdef PROFILE_ON
+    profileInit(profileNames, PROFILE_SLOT_COUNT);
+#endif
     /*Block initializations*/
-    LCD_Start();
+    HAL_LcdStart();
 
     /* Start USBFS and UART  */
-    USBUART_Start(USBFS_DEVICE, USBUART_5V_OPERATION);
-    UART_Start();     
+    usbOutInit(&terminal);
+    countParserReset(&entry);
+    eventQueueInit(&waiting);
+    HAL_UsbStart();
+    HAL_UartStart();     
     
-    tx_done_StartEx(tx_done);
+    HAL_IsrStart(HAL_IRQ_TX_DONE, tx_done);
 
     /* Clear LCD line. */
-    LCD_Position(0u, 0u);
-    LCD_PrintString("                    ");
+    HAL_LcdPosition(0u, 0u);
+    HAL_LcdPrintString("                    ");
 
     /* Output string on LCD. */
-    LCD_Position(0u, 0u);
-    LCD_PrintString("Hello");
+    HAL_LcdPosition(0u, 0u);
+    HAL_LcdPrintString("Hello");
 
     for(;;)
     {
-        gettingData = 1;
-        /* Start UART interface and fill array with 3 parameters until valid */
-        while(gettingData){
-            while(0u == GetCrabs()){
-                if(sendReady == TRUE){
-                    while (0u == USBUART_CDCIsReady())
-                    {
-                    }
-                    USBUART_PutString("Data Ready");
-                    sendReady = FALSE;
-                    /* Wait until component is ready to send data to host. */
-                    while (0u == USBUART_CDCIsReady())
-                    {
-                    }
-                    USBUART_PutCRLF();
+        /* Every valid entry joins the queue, however many come at once */
+        if(0u != GetCrabs()){
+            if(entryResult == COUNT_RATE){
+                QueueRate();
+            }else{
+                crabs = CalculateCrabs();
+                if(crabs != ERROR){
+                    QueueCrabs(crabs);
                 }
             }
-            crabs = CalculateCrabs();
-            if(crabs != ERROR){
-                DisplayCrabs(crabs);
-                gettingData = 0;
-            }
         }
-        UART_PutChar(crabs); 
-        dataDone = FALSE;
-        while (0u == USBUART_CDCIsReady())
-        {
-        }
-        USBUART_PutString("Data Sent");
-        while (0u == USBUART_CDCIsReady())
-        {
+        /* and goes out when USBFS_Tx has room */
+        SendCrabs();
+#ifdef PROFILE_ON
+        /* The statistics go to the terminal now and then */
+        if((profileDue() != FALSE) && (0u != HAL_UsbConfigured())){
+            profileDump(profileLine);
         }
-        USBUART_PutCRLF();
-        Data_Timer_Start();
-            
+#endif
     } // end for(;;)
 } // end main
 
 
 /*******************************************************************************************
  * function: int GetCrabs()
- * parameters: hex_value - an 8 bit (1 byte) value specifying what data you want to send
- *             bT - the current bit time
- * returns: bitCase - a high or low signal to be sent to an output pin
- * description: This function starts UART interface and waits for a valid amount of crabs
- * entered by user
+ * parameters: none
+ * returns: 1 once an entry ended (entered, entryResult), 0 while none has
+ * description: Services the USB CDC interface and parses what the user types, every
+ * byte of every packet. A packet with several entries gives them one call at a time.
  *******************************************************************************************
  */
 int GetCrabs()
 {
-    uint16 crabs = 0;
+    uint8 result = COUNT_NONE;
+    PROFILE_ENTER(PROFILE_USB_INPUT);
     /* Host can send double SET_INTERFACE request. */
-    if (0u != USBUART_IsConfigurationChanged())
+    if (0u != HAL_UsbConfigChanged())
     {
         /* Initialize IN endpoints when device is configured. */
-        if (0u != USBUART_GetConfiguration())
+        if (0u != HAL_UsbConfigured())
         {
             /* Enumeration is done, enable OUT endpoint to receive data 
             * from host. */
-            USBUART_CDC_Init();
+            HAL_UsbCdcInit();
         }
     }
+    /* Whatever waits for the terminal goes as the endpoint frees up */
+    usbOutService(&terminal);
 
         /* Service USB CDC when device is configured. */
-        if (0u != USBUART_GetConfiguration())
+        if (0u != HAL_UsbConfigured())
         {
-            /* Wait until component is ready to send data to host. */
-            while (0u == USBUART_CDCIsReady())
-                {
-                }
-            if(prompt == TRUE){
-                USBUART_PutString("Please enter amount of crabs (up to 127). Terminates with carriage return or third character. Any non-integer will be interpreted as a 0.");
-            }
-            /* Wait until component is ready to send data to host. */
-            while (0u == USBUART_CDCIsReady())
-                {
-                }
             if(prompt == TRUE){
-                USBUART_PutCRLF();
+                usbOutPutLine(&terminal, "Please enter amount of crabs (up to 127), or trap:amount for another trap, or r and the link rate the receiver suggests (r0 to r2). End each with Enter, a space or a comma; several can go at once; backspace corrects.");
                 prompt = 0;
             }
                 
-            /* Check for input data from host. */
-            if (0u != USBUART_DataIsReady())
+            /* Check for input data from host once the last packet is parsed. */
+            if ((packetNext >= count) && (0u != HAL_UsbRxReady()))
             {
                 /* Read received data and re-enable OUT endpoint. */
-                count = USBUART_GetAll(buffer);
-    
-                if (strncmp (buffer,"0",1) == 0){
-                    //USBUART_PutString("True Zero");
-                }
-                if (strncmp (buffer,"\r",1) == 0){
-                    //USBUART_PutString("Carriage Return");
-
-                    if(i == 1){
-                        oneDigit = 1;
-                    }else if(i == 0){
-                        twoDigit = 1;
-                    }
-                    endFlag = 1; // set flag to add numbers
-                }else{
-                    // Convert string to int
-                    data[i] = (uint8)atoi(buffer);
-                }
-                
-                /* Make sure data array stays in bounds (size = 3) */
-                if(i == 0){
-                    i = 2;
-                    endFlag = 1; // 3 characters have been entered
-                }else{
-                    i--;
-                }
+                count = HAL_UsbGetAll(buffer);
+                packetNext = 0;
                 
                 if (0u != count)
                 {
-                    /* Wait until component is ready to send data to host. */
-                    while (0u == USBUART_CDCIsReady())
-                    {
-                    }
-
-                    /* Send data back to PC */
-                    USBUART_PutData(buffer, count);
-
-                    /* If the last sent packet is exactly the maximum packet 
-                    *  size, it is followed by a zero-length packet to assure
-                    *  that the end of the segment is properly identified by 
-                    *  the terminal.
-                    */
-                    if (USBUART_BUFFER_SIZE == count)
-                    {
-                        /* Wait until component is ready to send data to PC. */
-                        while (0u == USBUART_CDCIsReady())
-                        {
-                        }
-
-                        /* Send zero-length packet to PC. */
-                        USBUART_PutData(NULL, 0u);
-                    }
+                    /* Send data back to PC, usbOutService ends the transfer */
+                    usbOutPut(&terminal, buffer, count);
                 }
-            } // end (0u != USBUART_DataIsReady())
-        } // end (0u != USBUART_GetConfiguration())
-    if(endFlag == 1){
+            } // end (0u != HAL_UsbRxReady())
+            
+            /* Up to the end of the next entry, the rest waits for the next call */
+            while ((result == COUNT_NONE) && (packetNext < count))
+            {
+                result = countParserByte(&entry, buffer[packetNext++], &entered);
+            }
+        } // end (0u != HAL_UsbConfigured())
+    PROFILE_EXIT(PROFILE_USB_INPUT);
+    if(result != COUNT_NONE){
+        entryResult = result;
         return 1;
     }else{
         return 0;
@@ -267,83 +240,134 @@ int GetCrabs()
 /*******************************************************************************************
  * function: int CalculateCrabs()
  * parameters: none
- * returns: int crabs - amount of crabs from user input 
- * description: This function takes an array of size three and converts
- * to a single number
+ * returns: int crabs - amount of crabs from user input, or ERROR
+ * description: This function checks the entry GetCrabs parsed and tells the user
+ * what is wrong with it
  *******************************************************************************************
  */
 int CalculateCrabs()
 {
-    int crabs;
-    /* Wait until component is ready to send data to host. */
-    while (0u == USBUART_CDCIsReady())
-    {
-    }
-    USBUART_PutCRLF();
-    /* Shift data if carriage return was pressed */
-    if(oneDigit == 1){
-        //USBUART_PutString("one digit");
-        data[0] = data[2];
-        data[2] = 0;
-        oneDigit = 0;
-    }else if(twoDigit == 1){
-        //USBUART_PutString("two digits");
-        data[0] = data[1];
-        data[1] = data[2];
-        data[2] = 0;
-        twoDigit = 0;
-    }
-    /* Apply digit place to integer */
-    data[0] = data[0] * 1;
-    data[1] = data[1] * 10;
-    data[2] = data[2] * 100;
-    crabs = data[0] + data[1] + data[2];
-    if(dataDone == FALSE){
+    int crabs = 0;
+    usbOutPutLine(&terminal, "");
+    if(entryResult == COUNT_ERROR){
         error = TRUE;
-        /* Wait until component is ready to send data to host. */
-        while (0u == USBUART_CDCIsReady())
-        {
-        }
-        USBUART_PutString("Error. Not Ready for new data.");
-        /* Wait until component is ready to send data to host. */
-        while (0u == USBUART_CDCIsReady())
-        {
-        }
-        USBUART_PutCRLF();
-    }
-    if(crabs > MAX_CRABS){
-        crabs = 0;
+        usbOutPutLine(&terminal, "Error. Please enter digits only, or trap:amount");
+    }else if(entered.count > MAX_CRABS){
         error = TRUE;
-        /* Wait until component is ready to send data to host. */
-        while (0u == USBUART_CDCIsReady())
-        {
-        }
-        USBUART_PutString("Error. Please enter a number UP TO 127");
-        /* Wait until component is ready to send data to host. */
-        while (0u == USBUART_CDCIsReady())
-        {
-        }
-        USBUART_PutCRLF();
+        usbOutPutLine(&terminal, "Error. Please enter a number UP TO 127");
+    }else if((entered.paired != FALSE) && ((entered.trap == 0u) || (entered.trap > MAX_TRAP))){
+        error = TRUE;
+        usbOutPutLine(&terminal, "Error. Trap IDs are 1 to 127");
+    }else{
+        crabs = (int)entered.count;
     }
-    /* reset array */
-    data[0] = 0; 
-    data[1] = 0;
-    data[2] = 0;
-    i = 2; // reset indexing for array
-    endFlag = 0; // reset endFlag for gathering new data
                     
     if(error == 1){
         error = 0; // reset error checking
         return ERROR;
-    }
-    else if(dataDone == FALSE){
-        return ERROR;
     }else{
         //prompt = TRUE;
         return crabs;
     }
 } /* END OF CalculateCrabs() */
 
+/*******************************************************************************************
+ * function: void QueueCrabs()
+ * parameters: int crabs - a valid count from CalculateCrabs, its trap in entered
+ * returns: void
+ * description: Puts the count in the queue for SendCrabs and tells the user how
+ * many are waiting, or that the queue is full and the count was not taken
+ *******************************************************************************************
+ */
+void QueueCrabs(int crabs){
+    if(eventQueuePut(&waiting, WAIT_COUNT, (uint8)entered.trap, (int16)crabs) == FALSE){
+        sprintf(message, "Error. %u counts waiting, %d not taken", EVENT_QUEUE_SIZE - 1u, crabs);
+    }else if(entered.trap != 0u){
+        sprintf(message, "Queued %d for trap %lu, %u waiting", crabs, (unsigned long)entered.trap,
+            eventQueuePending(&waiting));
+    }else{
+        sprintf(message, "Queued %d, %u waiting", crabs, eventQueuePending(&waiting));
+    }
+    usbOutPutLine(&terminal, message);
+}
+
+/*******************************************************************************************
+ * function: void QueueRate()
+ * parameters: none
+ * returns: void
+ * description: Puts the rate GetCrabs parsed (entered.count) in the queue, behind the
+ * counts before it, so USBFS_Tx sends the counts after it at that rate
+ *******************************************************************************************
+ */
+void QueueRate(){
+    usbOutPutLine(&terminal, "");
+    if(entered.count >= LINK_RATES){
+        sprintf(message, "Error. Rates are r0 to r%u", LINK_RATES - 1u);
+        usbOutPutLine(&terminal, message);
+        return;
+    }
+    if(eventQueuePut(&waiting, WAIT_RATE, 0u, (int16)entered.count) == FALSE){
+        sprintf(message, "Error. %u counts waiting, rate not taken", EVENT_QUEUE_SIZE - 1u);
+    }else{
+        sprintf(message, "Queued rate %lu, %u waiting", (unsigned long)entered.count,
+            eventQueuePending(&waiting));
+    }
+    usbOutPutLine(&terminal, message);
+}
+
+/*******************************************************************************************
+ * function: void SendCrabs()
+ * parameters: none
+ * returns: void
+ * description: Reads USBFS_Tx's reports of how many more counts it has room for, and
+ * sends it the next waiting count when it has room, one at a time (countLink.h).
+ * Called every pass of the main loop.
+ *******************************************************************************************
+ */
+void SendCrabs(){
+    event next;
+    uint8 received;
+
+    while(0u != (HAL_UartRxStatus() & HAL_UART_RX_NOTEMPTY)){
+        received = HAL_UartGetByte();
+        if((received & COUNT_LINK_READY_MASK) == COUNT_LINK_READY){
+            txRoom = received & COUNT_LINK_ROOM_MASK;
+            txAnswer = FALSE;
+            HAL_TimerStop(HAL_TIMER_DATA);
+        }
+    }
+    /* No answer, a USBFS_Tx that does not report: one count per WAITTIME */
+    if((txAnswer == TRUE) && (countTx >= WAITTIME)){
+        txRoom = COUNT_LINK_SPARE + 1u;
+        txAnswer = FALSE;
+    }
+    if((txAnswer == TRUE) || (txRoom <= COUNT_LINK_SPARE) || (eventQueueGet(&waiting, &next) == FALSE)){
+        return;
+    }
+
+    if(next.type == WAIT_RATE){
+        /* Takes a place in USBFS_Tx's queue and is answered like a count */
+        HAL_UartPutChar((uint8)(LINK_RATE_COMMAND | next.value));
+        txAnswer = TRUE;
+        countTx = 0;
+        HAL_TimerStart(HAL_TIMER_DATA);
+        sprintf(message, "Rate Sent: %d, %u waiting", next.value, eventQueuePending(&waiting));
+        usbOutPutLine(&terminal, message);
+        return;
+    }
+    if(next.flag != 0u){
+        HAL_UartPutChar(COUNT_LINK_TRAP);
+        HAL_UartPutChar(next.flag);
+    }
+    HAL_UartPutChar((uint8)next.value);
+    txAnswer = TRUE;
+    countTx = 0;
+    HAL_TimerStart(HAL_TIMER_DATA);
+    DisplayCrabs(next.value);
+    sprintf(message, "Data Sent: %d, %u waiting", next.value, eventQueuePending(&waiting));
+    usbOutPutLine(&terminal, message);
+}
+
 /*******************************************************************************************
  * function: void DisplayCrabs()
  * parameters: int crabs
@@ -353,13 +377,13 @@ int CalculateCrabs()
  */
 void DisplayCrabs(int crabs){
     /* Clear LCD line. */
-    LCD_Position(0u, 0u);
-    LCD_PrintString("           ");
+    HAL_LcdPosition(0u, 0u);
+    HAL_LcdPrintString("           ");
     /* Reset LCD line position. */
-    LCD_Position(0u, 0u);
+    HAL_LcdPosition(0u, 0u);
     /* Store int crabs into a string to print to LCD */
     sprintf(lineStr,"Crabs: %d", crabs);
-    LCD_PrintString(lineStr);
+    HAL_LcdPrintString(lineStr);
 }
 
 /*******************************************************************************
@@ -377,17 +401,29 @@ void DisplayCrabs(int crabs){
 *
 *******************************************************************************/
 CY_ISR(tx_done){
+    PROFILE_ENTER(PROFILE_TX_DONE);
     countTx++; // every 1.024 seconds
     if(countTx >= WAITTIME){
-        dataDone = TRUE;
-        sendReady = TRUE;
-
-        countTx = 0;
-        Data_Timer_Stop();
+        /* SendCrabs stops waiting for the answer */
+        HAL_TimerStop(HAL_TIMER_DATA);
     }
+    PROFILE_EXIT(PROFILE_TX_DONE);
 
 } //end CY_ISR(tx_done)
 
 
 
+#ifdef PROFILE_ON
+/*******************************************************************************************
+ * function: void profileLine(const char8 *line)
+ * parameters: line - one line of the profile
+ * returns: void
+ * description: Queues the line for the terminal
+ *******************************************************************************************
+ */
+void profileLine(const char8 *line){
+    usbOutPutLine(&terminal, line);
+}
+#endif /* PROFILE_ON */
+
 /* [] END OF FILE */
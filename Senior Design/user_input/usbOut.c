@@ -0,0 +1,98 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * USB Output
+ * Function: Byte ring drained one packet at a time. head == tail is empty,
+ * so one byte always stays free.
+ * =============================================================================
+*/
+
+#include <string.h>
+#include "usbOut.h"
+#include "hal.h"
+
+#define USB_OUT_MASK    (USB_OUT_SIZE - 1u)
+
+// Empty the ring
+void usbOutInit(usbOut *out){
+    out->head = 0;
+    out->tail = 0;
+    out->dropped = 0;
+    out->endTransfer = 0;
+}
+
+// Bytes waiting to be sent
+uint16 usbOutPending(const usbOut *out){
+    return (uint16)((out->head - out->tail) & USB_OUT_MASK);
+}
+
+/*
+ * function: uint8 usbOutPut(usbOut *out, const uint8 *data, uint16 length)
+ * parameters: out - from usbOutInit, data/length - bytes to send
+ * returns: TRUE if queued, FALSE if they did not all fit and none were
+ * description: All or nothing, so a full ring never cuts a line short.
+ */
+uint8 usbOutPut(usbOut *out, const uint8 *data, uint16 length){
+    uint16 n;
+
+    if(length > USB_OUT_MASK - usbOutPending(out)){
+        out->dropped += length;
+        return 0;
+    }
+    for(n = 0; n < length; n++){
+        out->bytes[out->head] = data[n];
+        out->head = (uint16)((out->head + 1u) & USB_OUT_MASK);
+    }
+    return 1;
+}
+
+uint8 usbOutPutString(usbOut *out, const char8 *text){
+    return usbOutPut(out, (const uint8 *)text, (uint16)strlen(text));
+}
+
+// The text and a CR LF, or neither
+uint8 usbOutPutLine(usbOut *out, const char8 *text){
+    uint16 length = (uint16)strlen(text);
+
+    if(length + 2u > USB_OUT_MASK - usbOutPending(out)){
+        out->dropped += length + 2u;
+        return 0;
+    }
+    usbOutPut(out, (const uint8 *)text, length);
+    return usbOutPut(out, (const uint8 *)"\r\n", 2u);
+}
+
+/*
+ * function: void usbOutService(usbOut *out)
+ * parameters: out - from usbOutInit
+ * returns: void
+ * description: Call every pass of the main loop. If the terminal is there
+ * and the IN endpoint is free, sends the next packet: as many waiting
+ * bytes as fit, up to the end of the ring. A transfer that ends on a full
+ * packet is closed with a zero-length one, so the terminal sees its end.
+ */
+void usbOutService(usbOut *out){
+    uint16 length;
+
+    if((HAL_UsbConfigured() == 0u) || (HAL_UsbTxReady() == 0u)){
+        return;
+    }
+    length = usbOutPending(out);
+    if(length == 0u){
+        if(out->endTransfer != 0u){
+            HAL_UsbPutData(NULL, 0u);
+            out->endTransfer = 0;
+        }
+        return;
+    }
+    if(length > USB_OUT_PACKET){
+        length = USB_OUT_PACKET;
+    }
+    if(length > USB_OUT_SIZE - out->tail){
+        length = (uint16)(USB_OUT_SIZE - out->tail);
+    }
+    HAL_UsbPutData(&out->bytes[out->tail], length);
+    out->tail = (uint16)((out->tail + length) & USB_OUT_MASK);
+    out->endTransfer = (length == USB_OUT_PACKET);
+}
+
+/* [] END OF FILE */
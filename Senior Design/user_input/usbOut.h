@@ -0,0 +1,39 @@
+/* =============================================================================
+ * Smart Crab Trap
+ * USB Output
+ * Function: Ring of bytes waiting to go to the terminal over USB CDC. The
+ * prompts and echoes are put here and return at once; usbOutService sends
+ * the next packet whenever the IN endpoint is ready. A terminal that is slow,
+ * closed or asleep only fills the ring, and what does not fit is dropped,
+ * whole, rather than making the module wait.
+ *
+ * Main loop only.
+ * =============================================================================
+*/
+
+#ifndef USB_OUT_H
+#define USB_OUT_H
+
+#include "project.h"
+
+#define USB_OUT_SIZE        512u    // bytes, a power of two
+#define USB_OUT_PACKET      64u     // IN endpoint's max packet size
+
+typedef struct{
+    uint8 bytes[USB_OUT_SIZE];
+    uint16 head;        // next byte to write
+    uint16 tail;        // next byte to send
+    uint16 dropped;     // bytes that did not fit
+    uint8 endTransfer;  // the last packet was full, a zero-length one ends it
+}usbOut;
+
+void usbOutInit(usbOut *out);
+uint8 usbOutPut(usbOut *out, const uint8 *data, uint16 length);
+uint8 usbOutPutString(usbOut *out, const char8 *text);
+uint8 usbOutPutLine(usbOut *out, const char8 *text);
+uint16 usbOutPending(const usbOut *out);
+void usbOutService(usbOut *out);
+
+#endif /* USB_OUT_H */
+
+/* [] END OF FILE */